@@ -0,0 +1,38 @@
+#include <MjolnFS.h>
+
+MjolnFileSystem fs(AT24C32);
+
+void setup()
+{
+    Serial.begin(9600);
+    delay(5000);
+    fs.showLogs(false);
+    if (!fs.mount())
+        fs.format();
+    if (!fs.open("story"))
+        fs.writeFile("story", "Maupertuis set about generalising his earlier mathematical work, proposing the principle of least action as a metaphysical principle that underlies all the laws of mechanics.");
+
+    MjolnFile file = fs.open("story"); // Only the handle and a small chunk buffer live in RAM
+    if (!file)
+    {
+        Serial.println("Failed to open the file.");
+        return;
+    }
+
+    Serial.print("File size: ");
+    Serial.println(file.size());
+
+    uint8_t chunk[16];
+    uint16_t length;
+    while ((length = file.read(chunk, sizeof(chunk))) > 0)
+        Serial.write(chunk, length);
+    Serial.println();
+
+    file.seek(11); // Overwrite a word in place
+    file.write("DID", 3);
+    file.close();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,130 @@
+#ifndef AT24C_EMULATOR_H
+#define AT24C_EMULATOR_H
+
+#ifdef __cplusplus
+
+#include <vector>
+#include "Arduino.h"
+#include "Wire.h"
+#include "MjolnFS.h"
+
+#define AT24C_DEFAULT_WRITE_CYCLE_US 5000 // Datasheet maximum tWR of the AT24C family
+
+/**
+ * @brief Counters kept by a simulated AT24C device.
+ */
+struct AT24CStats
+{
+    uint32_t pagePrograms;     // Internal write cycles started (one per write transfer carrying data)
+    uint32_t bytesProgrammed;  // Data bytes latched into the array
+    uint32_t bytesRead;        // Data bytes clocked out
+    uint32_t busyNacks;        // Address bytes NACKed because a write cycle was in progress
+    uint64_t writeCycleMicros; // Simulated time the array spent in write cycles
+};
+
+/**
+ * @brief Behavioural model of an AT24C series I2C EEPROM.
+ *
+ * Models the geometry of every AT24CXType (capacity, page size, 8-bit addressing with block
+ * select bits in the device address, 16-bit addressing), page wrap-around on writes,
+ * sequential reads rolling over at the end of the array, and the tWR write cycle during
+ * which the device NACKs its address.
+ */
+class AT24CEmulator : public I2CDevice
+{
+public:
+    /**
+     * @brief Constructs a blank (0xFF filled) device.
+     * @param type EEPROM model to emulate.
+     * @param baseAddress 7-bit I2C address selected by the A2..A0 pins.
+     * @param writeCycleUs Duration of the internal write cycle in microseconds.
+     */
+    AT24CEmulator(AT24CXType type, uint8_t baseAddress = MJOLN_STORAGE_DEVICE_ADDRESS, uint32_t writeCycleUs = AT24C_DEFAULT_WRITE_CYCLE_US);
+
+    bool ownsAddress(uint8_t address) const override;
+    bool onAddress(uint8_t address, bool read) override;
+    void onWrite(uint8_t address, const uint8_t *data, size_t length) override;
+    void onRead(uint8_t address, uint8_t *buffer, size_t length) override;
+
+    AT24CXType type() const { return _type; }
+    uint32_t size() const { return _memory.size(); }
+    uint16_t pageSize() const { return _pageSize; }
+    uint8_t addressBytes() const { return _addressBytes; }
+
+    /**
+     * @brief Sets the duration of subsequent write cycles.
+     */
+    void setWriteCycleMicros(uint32_t us) { _writeCycleUs = us; }
+
+    /**
+     * @brief Checks whether an internal write cycle is still running.
+     */
+    bool isBusy() const { return hostMicros() < _busyUntil; }
+
+    /**
+     * @brief Direct access to the memory array, bypassing the bus.
+     */
+    uint8_t *memory() { return _memory.data(); }
+
+    /**
+     * @brief Number of write cycles each page has been through.
+     */
+    const std::vector<uint32_t> &pageWear() const { return _pageWear; }
+
+    /**
+     * @brief Highest write cycle count of any single page.
+     */
+    uint32_t maxPageWear() const;
+
+    const AT24CStats &stats() const { return _stats; }
+    void resetStats();
+
+    /**
+     * @brief Fills the array with 0xFF, as shipped from the factory.
+     */
+    void erase();
+
+    /**
+     * @brief Loads the array from a raw image file.
+     * @return False if the file could not be read or has the wrong size.
+     */
+    bool loadImage(const char *path);
+
+    /**
+     * @brief Saves the array to a raw image file.
+     */
+    bool saveImage(const char *path) const;
+
+    /**
+     * @brief Returns the page size of an EEPROM model.
+     */
+    static uint16_t pageSizeOf(AT24CXType type);
+
+private:
+    uint32_t blockBits(uint8_t address) const;
+
+    AT24CXType _type;
+    uint8_t _baseAddress;
+    uint32_t _writeCycleUs;
+    uint16_t _pageSize;
+    uint8_t _addressBytes;
+    uint32_t _pointer = 0;
+    uint64_t _busyUntil = 0;
+    std::vector<uint8_t> _memory;
+    std::vector<uint32_t> _pageWear;
+    AT24CStats _stats = {};
+};
+
+/**
+ * @brief Parses an EEPROM model name such as "AT24C256".
+ * @return True if the name is a known model.
+ */
+bool parseAT24CXType(const char *name, AT24CXType &type);
+
+/**
+ * @brief Returns the name of an EEPROM model.
+ */
+const char *at24cxTypeName(AT24CXType type);
+
+#endif // __cplusplus
+#endif // AT24C_EMULATOR_H
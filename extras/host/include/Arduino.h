@@ -0,0 +1,165 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#ifdef __cplusplus
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+/**
+ * @brief Minimal Arduino core shim for building MjolnFS on a Linux host.
+ * @note Only the subset of the Arduino API used by the library and its examples is provided.
+ * @note Time is simulated: delay() and bus traffic advance a virtual clock instead of sleeping.
+ */
+
+#define HEX 16
+#define DEC 10
+
+typedef uint8_t byte;
+
+template <typename T>
+inline T min(T a, T b) { return a < b ? a : b; }
+
+template <typename T>
+inline T max(T a, T b) { return a > b ? a : b; }
+
+/**
+ * @brief Returns the simulated time in milliseconds since start.
+ */
+unsigned long millis();
+
+/**
+ * @brief Returns the simulated time in microseconds since start.
+ */
+unsigned long micros();
+
+/**
+ * @brief Advances the simulated clock by the given number of milliseconds.
+ */
+void delay(unsigned long ms);
+
+/**
+ * @brief Advances the simulated clock by the given number of microseconds.
+ */
+void delayMicroseconds(unsigned int us);
+
+/**
+ * @brief No-op on the host, present for source compatibility.
+ */
+void yield();
+
+/**
+ * @brief Advances the simulated clock without going through delay().
+ * @param us Number of microseconds to add.
+ * @note Used by the bus model to account for transfer time.
+ */
+void hostAdvanceMicros(uint64_t us);
+
+/**
+ * @brief Returns the full-width simulated clock in microseconds.
+ */
+uint64_t hostMicros();
+
+/**
+ * @brief Returns the total simulated time spent inside delay() in microseconds.
+ */
+uint64_t hostDelayMicros();
+
+/**
+ * @brief Arduino String replacement backed by std::string.
+ */
+class String
+{
+public:
+    String(const char *str = "");
+    String(const std::string &str);
+    String(char c);
+    String(int value, unsigned char base = DEC);
+    String(unsigned int value, unsigned char base = DEC);
+    String(long value, unsigned char base = DEC);
+    String(unsigned long value, unsigned char base = DEC);
+    String(double value, unsigned char decimals = 2);
+
+    const char *c_str() const { return _str.c_str(); }
+    unsigned int length() const { return _str.length(); }
+    bool isEmpty() const { return _str.empty(); }
+
+    bool concat(const String &str);
+    bool concat(const char *str);
+    bool concat(char c);
+    String &operator+=(const String &str);
+    String &operator+=(const char *str);
+    String &operator+=(char c);
+
+    bool equals(const String &str) const { return _str == str._str; }
+    bool equals(const char *str) const { return _str == str; }
+    bool operator==(const String &str) const { return equals(str); }
+    bool operator==(const char *str) const { return equals(str); }
+    bool operator!=(const String &str) const { return !equals(str); }
+    bool startsWith(const String &prefix) const;
+
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String &str, unsigned int from = 0) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+    void trim();
+    long toInt() const { return atol(_str.c_str()); }
+
+    char operator[](unsigned int index) const { return index < _str.length() ? _str[index] : 0; }
+
+private:
+    std::string _str;
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+
+/**
+ * @brief Serial port replacement writing to stdout and reading from stdin.
+ */
+class HostSerial
+{
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    int available();
+    int read();
+    size_t write(uint8_t c) { return print((char)c); }
+    size_t write(const uint8_t *buffer, size_t length) { return fwrite(buffer, 1, length, stdout); }
+    size_t print(const String &str);
+    size_t print(const char *str);
+    size_t print(char c);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int decimals = 2);
+    size_t println();
+    template <typename T>
+    size_t println(const T &value)
+    {
+        size_t n = print(value);
+        return n + println();
+    }
+    template <typename T>
+    size_t println(const T &value, int format)
+    {
+        size_t n = print(value, format);
+        return n + println();
+    }
+    operator bool() const { return true; }
+
+private:
+    int _peeked = -1;
+};
+
+extern HostSerial Serial;
+
+#endif // __cplusplus
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,131 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#ifdef __cplusplus
+
+#include "Arduino.h"
+
+#ifndef WIRE_HOST_BUFFER_LENGTH
+#define WIRE_HOST_BUFFER_LENGTH 32 // Transmit/receive buffer size, as on AVR; bytes past it are dropped
+#endif
+
+#define BUFFER_LENGTH WIRE_HOST_BUFFER_LENGTH // Name the AVR core gives its buffer size
+
+#define WIRE_HOST_MAX_DEVICES 8 // Number of devices that can be attached to the simulated bus
+
+/**
+ * @brief A device that can be attached to the simulated I2C bus.
+ */
+class I2CDevice
+{
+public:
+    virtual ~I2CDevice() {}
+
+    /**
+     * @brief Checks whether the device answers on the given 7-bit address.
+     */
+    virtual bool ownsAddress(uint8_t address) const = 0;
+
+    /**
+     * @brief Called when the device is addressed. Returning false NACKs the address byte.
+     * @param address The 7-bit address the master used.
+     * @param read True for a read transfer, false for a write transfer.
+     */
+    virtual bool onAddress(uint8_t address, bool read) = 0;
+
+    /**
+     * @brief Called at the stop condition of an acknowledged write transfer.
+     * @param address The 7-bit address the master used.
+     * @param data Bytes clocked in after the address byte.
+     * @param length Number of bytes in data.
+     */
+    virtual void onWrite(uint8_t address, const uint8_t *data, size_t length) = 0;
+
+    /**
+     * @brief Called for an acknowledged read transfer.
+     * @param address The 7-bit address the master used.
+     * @param buffer Destination for the bytes clocked out by the device.
+     * @param length Number of bytes requested.
+     */
+    virtual void onRead(uint8_t address, uint8_t *buffer, size_t length) = 0;
+};
+
+/**
+ * @brief Counters kept by the simulated I2C bus.
+ */
+struct I2CBusStats
+{
+    uint32_t transactions;  // Addressed transfers (writes and reads)
+    uint32_t writeTransfers; // Addressed write transfers, including address-only probes
+    uint32_t readTransfers; // Addressed read transfers
+    uint32_t addressNacks;  // Transfers whose address byte was not acknowledged
+    uint64_t bytesOnBus;    // Every byte clocked on SDA, address bytes included
+    uint64_t busMicros;     // Simulated time spent clocking bytes
+};
+
+/**
+ * @brief Simulated TwoWire master with the Arduino Wire API.
+ * @note Transfer time is derived from the configured clock and added to the simulated clock.
+ */
+class TwoWire
+{
+public:
+    void begin() { _begun = true; }
+    void setClock(uint32_t frequency) { _frequency = frequency ? frequency : 100000; }
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t length);
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    uint8_t requestFrom(int address, int quantity);
+    int available();
+    int read();
+    int peek();
+
+    /**
+     * @brief Attaches a simulated device to the bus.
+     * @return False if the bus is full.
+     */
+    bool attach(I2CDevice *device);
+
+    /**
+     * @brief Detaches every device from the bus.
+     */
+    void detachAll();
+
+    /**
+     * @brief Returns the bus counters.
+     */
+    const I2CBusStats &stats() const { return _stats; }
+
+    /**
+     * @brief Clears the bus counters.
+     */
+    void resetStats() { memset(&_stats, 0, sizeof(_stats)); }
+
+private:
+    I2CDevice *findDevice(uint8_t address);
+    void clockBytes(size_t count);
+
+    I2CDevice *_devices[WIRE_HOST_MAX_DEVICES] = {};
+    uint8_t _deviceCount = 0;
+    uint32_t _frequency = 100000;
+    bool _begun = false;
+
+    uint8_t _txAddress = 0;
+    uint8_t _txBuffer[WIRE_HOST_BUFFER_LENGTH];
+    size_t _txLength = 0;
+    bool _transmitting = false;
+
+    uint8_t _rxBuffer[WIRE_HOST_BUFFER_LENGTH];
+    size_t _rxLength = 0;
+    size_t _rxIndex = 0;
+
+    I2CBusStats _stats = {};
+};
+
+extern TwoWire Wire;
+
+#endif // __cplusplus
+#endif // HOST_WIRE_H
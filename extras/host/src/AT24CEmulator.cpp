@@ -0,0 +1,180 @@
+#include "AT24CEmulator.h"
+
+static const struct
+{
+    AT24CXType type;
+    const char *name;
+} at24cxNames[] = {
+    {AT24C04, "AT24C04"},
+    {AT24C08, "AT24C08"},
+    {AT24C16, "AT24C16"},
+    {AT24C32, "AT24C32"},
+    {AT24C64, "AT24C64"},
+    {AT24C128, "AT24C128"},
+    {AT24C256, "AT24C256"},
+    {AT24C512, "AT24C512"},
+};
+
+AT24CEmulator::AT24CEmulator(AT24CXType type, uint8_t baseAddress, uint32_t writeCycleUs)
+    : _type(type), _baseAddress(baseAddress), _writeCycleUs(writeCycleUs), _pageSize(pageSizeOf(type)),
+      _addressBytes(type <= AT24C16 ? 1 : 2), _memory((size_t)1 << (uint8_t)type, 0xFF),
+      _pageWear(((size_t)1 << (uint8_t)type) / pageSizeOf(type), 0)
+{
+}
+
+uint16_t AT24CEmulator::pageSizeOf(AT24CXType type)
+{
+    switch (type)
+    {
+    case AT24C04:
+    case AT24C08:
+    case AT24C16:
+        return 16;
+    case AT24C32:
+    case AT24C64:
+        return 32;
+    case AT24C128:
+    case AT24C256:
+        return 64;
+    case AT24C512:
+        return 128;
+    default:
+        return 16;
+    }
+}
+
+bool AT24CEmulator::ownsAddress(uint8_t address) const
+{
+    if (_addressBytes == 2)
+        return address == _baseAddress;
+
+    // 8-bit parts take the high address bits from the device address, so they answer on several addresses.
+    uint8_t blocks = _memory.size() >> 8;
+    uint8_t mask = (uint8_t)~(blocks - 1);
+    return (address & mask) == (_baseAddress & mask);
+}
+
+bool AT24CEmulator::onAddress(uint8_t address, bool read)
+{
+    (void)address;
+    (void)read;
+    if (isBusy())
+    {
+        _stats.busyNacks++;
+        return false;
+    }
+    return true;
+}
+
+uint32_t AT24CEmulator::blockBits(uint8_t address) const
+{
+    if (_addressBytes == 2)
+        return 0;
+    uint8_t blocks = _memory.size() >> 8;
+    return (uint32_t)(address & (blocks - 1)) << 8;
+}
+
+void AT24CEmulator::onWrite(uint8_t address, const uint8_t *data, size_t length)
+{
+    if (length < _addressBytes)
+        return;
+
+    uint32_t wordAddress = _addressBytes == 2 ? ((uint32_t)data[0] << 8) | data[1] : data[0];
+    _pointer = (blockBits(address) | wordAddress) & (_memory.size() - 1);
+
+    if (length == _addressBytes)
+        return;
+
+    // Bytes past the end of a page wrap to its start, overwriting what was latched there.
+    uint32_t pageBase = _pointer & ~(uint32_t)(_pageSize - 1);
+    uint32_t offset = _pointer - pageBase;
+    for (size_t i = _addressBytes; i < length; i++)
+    {
+        _memory[pageBase + offset] = data[i];
+        offset = (offset + 1) % _pageSize;
+        _stats.bytesProgrammed++;
+    }
+    _pointer = pageBase + offset;
+
+    _pageWear[pageBase / _pageSize]++;
+    _stats.pagePrograms++;
+    _stats.writeCycleMicros += _writeCycleUs;
+    _busyUntil = hostMicros() + _writeCycleUs;
+}
+
+void AT24CEmulator::onRead(uint8_t address, uint8_t *buffer, size_t length)
+{
+    (void)address;
+    for (size_t i = 0; i < length; i++)
+    {
+        buffer[i] = _memory[_pointer];
+        _pointer = (_pointer + 1) & (_memory.size() - 1);
+    }
+    _stats.bytesRead += length;
+}
+
+uint32_t AT24CEmulator::maxPageWear() const
+{
+    uint32_t maxWear = 0;
+    for (size_t i = 0; i < _pageWear.size(); i++)
+        maxWear = max(maxWear, _pageWear[i]);
+    return maxWear;
+}
+
+void AT24CEmulator::resetStats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+    for (size_t i = 0; i < _pageWear.size(); i++)
+        _pageWear[i] = 0;
+}
+
+void AT24CEmulator::erase()
+{
+    for (size_t i = 0; i < _memory.size(); i++)
+        _memory[i] = 0xFF;
+}
+
+bool AT24CEmulator::loadImage(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    std::vector<uint8_t> image(_memory.size());
+    size_t read = fread(image.data(), 1, image.size(), file);
+    bool extra = fgetc(file) != EOF;
+    fclose(file);
+    if (read != image.size() || extra)
+        return false;
+    _memory = image;
+    return true;
+}
+
+bool AT24CEmulator::saveImage(const char *path) const
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    size_t written = fwrite(_memory.data(), 1, _memory.size(), file);
+    return fclose(file) == 0 && written == _memory.size();
+}
+
+bool parseAT24CXType(const char *name, AT24CXType &type)
+{
+    for (size_t i = 0; i < sizeof(at24cxNames) / sizeof(at24cxNames[0]); i++)
+    {
+        if (strcmp(name, at24cxNames[i].name) == 0)
+        {
+            type = at24cxNames[i].type;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *at24cxTypeName(AT24CXType type)
+{
+    for (size_t i = 0; i < sizeof(at24cxNames) / sizeof(at24cxNames[0]); i++)
+        if (at24cxNames[i].type == type)
+            return at24cxNames[i].name;
+    return "unknown";
+}
@@ -0,0 +1,269 @@
+#include "Arduino.h"
+
+HostSerial Serial;
+
+static uint64_t simulatedMicros = 0;
+static uint64_t delayedMicros = 0;
+
+unsigned long millis()
+{
+    return (unsigned long)(simulatedMicros / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)simulatedMicros;
+}
+
+void delay(unsigned long ms)
+{
+    simulatedMicros += (uint64_t)ms * 1000;
+    delayedMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    simulatedMicros += us;
+    delayedMicros += us;
+}
+
+void yield()
+{
+}
+
+void hostAdvanceMicros(uint64_t us)
+{
+    simulatedMicros += us;
+}
+
+uint64_t hostMicros()
+{
+    return simulatedMicros;
+}
+
+uint64_t hostDelayMicros()
+{
+    return delayedMicros;
+}
+
+static std::string formatInteger(unsigned long value, unsigned char base, bool negative)
+{
+    if (base < 2 || base > 16)
+        base = DEC;
+
+    char digits[sizeof(unsigned long) * 8 + 2];
+    int pos = sizeof(digits) - 1;
+    digits[pos] = '\0';
+    do
+    {
+        digits[--pos] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value > 0);
+
+    if (negative)
+        digits[--pos] = '-';
+    return std::string(&digits[pos]);
+}
+
+String::String(const char *str) : _str(str ? str : "") {}
+
+String::String(const std::string &str) : _str(str) {}
+
+String::String(char c) : _str(1, c) {}
+
+String::String(int value, unsigned char base)
+    : _str(base == DEC ? formatInteger(value < 0 ? -(long)value : value, base, value < 0) : formatInteger((unsigned int)value, base, false)) {}
+
+String::String(unsigned int value, unsigned char base) : _str(formatInteger(value, base, false)) {}
+
+String::String(long value, unsigned char base)
+    : _str(base == DEC ? formatInteger(value < 0 ? -value : value, base, value < 0) : formatInteger((unsigned long)value, base, false)) {}
+
+String::String(unsigned long value, unsigned char base) : _str(formatInteger(value, base, false)) {}
+
+String::String(double value, unsigned char decimals)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    _str = buffer;
+}
+
+bool String::concat(const String &str)
+{
+    _str += str._str;
+    return true;
+}
+
+bool String::concat(const char *str)
+{
+    if (!str)
+        return false;
+    _str += str;
+    return true;
+}
+
+bool String::concat(char c)
+{
+    _str += c;
+    return true;
+}
+
+String &String::operator+=(const String &str)
+{
+    concat(str);
+    return *this;
+}
+
+String &String::operator+=(const char *str)
+{
+    concat(str);
+    return *this;
+}
+
+String &String::operator+=(char c)
+{
+    concat(c);
+    return *this;
+}
+
+bool String::startsWith(const String &prefix) const
+{
+    return _str.compare(0, prefix._str.length(), prefix._str) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    size_t pos = _str.find(c, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String &str, unsigned int from) const
+{
+    size_t pos = _str.find(str._str, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int from) const
+{
+    return substring(from, _str.length());
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if (from > to)
+    {
+        unsigned int temp = from;
+        from = to;
+        to = temp;
+    }
+    if (from >= _str.length())
+        return String();
+    if (to > _str.length())
+        to = _str.length();
+    return String(_str.substr(from, to - from));
+}
+
+void String::trim()
+{
+    size_t start = _str.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos)
+    {
+        _str.clear();
+        return;
+    }
+    size_t end = _str.find_last_not_of(" \t\r\n");
+    _str = _str.substr(start, end - start + 1);
+}
+
+String operator+(const String &lhs, const String &rhs)
+{
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+String operator+(const String &lhs, const char *rhs)
+{
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+String operator+(const char *lhs, const String &rhs)
+{
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+String operator+(const String &lhs, char rhs)
+{
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+int HostSerial::available()
+{
+    if (_peeked < 0)
+        _peeked = getchar();
+
+    // A sketch polling for input after stdin is exhausted would spin forever, so the host run ends here.
+    if (_peeked == EOF)
+        exit(0);
+    return 1;
+}
+
+int HostSerial::read()
+{
+    if (!available())
+        return -1;
+    int c = _peeked;
+    _peeked = -1;
+    return c;
+}
+
+size_t HostSerial::print(const String &str)
+{
+    return fwrite(str.c_str(), 1, str.length(), stdout);
+}
+
+size_t HostSerial::print(const char *str)
+{
+    return fputs(str, stdout) < 0 ? 0 : strlen(str);
+}
+
+size_t HostSerial::print(char c)
+{
+    return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HostSerial::print(int value, int base)
+{
+    return print(String(value, (unsigned char)base));
+}
+
+size_t HostSerial::print(unsigned int value, int base)
+{
+    return print(String(value, (unsigned char)base));
+}
+
+size_t HostSerial::print(long value, int base)
+{
+    return print(String(value, (unsigned char)base));
+}
+
+size_t HostSerial::print(unsigned long value, int base)
+{
+    return print(String(value, (unsigned char)base));
+}
+
+size_t HostSerial::print(double value, int decimals)
+{
+    return print(String(value, (unsigned char)decimals));
+}
+
+size_t HostSerial::println()
+{
+    return print("\n");
+}
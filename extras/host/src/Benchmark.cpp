@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "Wire.h"
+#include "AT24CEmulator.h"
+
+// Scripted workloads run against every emulated EEPROM model. Each operation is measured on its own, in
+// simulated time, so the results are the same on every machine and can be compared release to release.
+
+static const AT24CXType models[] = {AT24C04, AT24C08, AT24C16, AT24C32, AT24C64, AT24C128, AT24C256, AT24C512};
+static const uint32_t fileSizes[] = {16, 64, 256, 1024, 4096};
+
+struct OpSample
+{
+    uint64_t micros;       // Simulated time the call took
+    uint32_t transactions; // Addressed I2C transfers, NACKed polls included
+    uint64_t busBytes;     // Bytes clocked on SDA, address bytes included
+    uint32_t pagePrograms; // Internal write cycles started
+};
+
+struct OpSeries
+{
+    std::string workload;
+    std::string op;
+    uint32_t fileBytes;
+    uint32_t failures;
+    std::vector<OpSample> samples;
+};
+
+class Benchmark
+{
+public:
+    Benchmark(AT24CXType type, uint32_t writeCycleUs) : _chip(type, MJOLN_STORAGE_DEVICE_ADDRESS, writeCycleUs), _fs(type)
+    {
+        Wire.detachAll();
+        Wire.attach(&_chip);
+        _fs.showLogs(false);
+        _buffer.resize(_chip.size() + 1);
+    }
+
+    void run()
+    {
+        formatMount();
+        fileSize();
+        configChurn();
+        appendLog();
+        manySmallFiles();
+    }
+
+    AT24CEmulator &chip() { return _chip; }
+    const std::vector<OpSeries> &series() const { return _series; }
+
+private:
+    template <typename Op>
+    bool measure(const char *workload, const char *op, uint32_t fileBytes, Op call)
+    {
+        OpSeries &series = find(workload, op, fileBytes);
+        I2CBusStats bus = Wire.stats();
+        AT24CStats chip = _chip.stats();
+        uint64_t start = hostMicros();
+        bool ok = call();
+        if (!ok)
+        {
+            series.failures++;
+            return false;
+        }
+
+        OpSample sample;
+        sample.micros = hostMicros() - start;
+        sample.transactions = Wire.stats().transactions - bus.transactions;
+        sample.busBytes = Wire.stats().bytesOnBus - bus.bytesOnBus;
+        sample.pagePrograms = _chip.stats().pagePrograms - chip.pagePrograms;
+        series.samples.push_back(sample);
+        return true;
+    }
+
+    OpSeries &find(const char *workload, const char *op, uint32_t fileBytes)
+    {
+        for (size_t i = 0; i < _series.size(); i++)
+            if (_series[i].workload == workload && _series[i].op == op && _series[i].fileBytes == fileBytes)
+                return _series[i];
+        OpSeries series = {workload, op, fileBytes, 0};
+        _series.push_back(series);
+        return _series.back();
+    }
+
+    bool freshVolume()
+    {
+        return _fs.format() && _fs.mount();
+    }
+
+    // Deterministic contents, so every run programs the same bytes.
+    std::string payload(uint32_t length, uint32_t seed)
+    {
+        std::string data(length, ' ');
+        uint32_t state = seed * 2654435761u + 1;
+        for (uint32_t i = 0; i < length; i++)
+        {
+            state = state * 1103515245u + 12345;
+            data[i] = 'a' + (state >> 16) % 26;
+        }
+        return data;
+    }
+
+    bool readBack(const char *name, uint32_t length)
+    {
+        return _fs.readFile(name, &_buffer[0]) == length;
+    }
+
+    void formatMount()
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            measure("format_mount", "format", 0, [&]() { return _fs.format(); });
+            measure("format_mount", "mount", 0, [&]() { return _fs.mount(); });
+        }
+    }
+
+    void fileSize()
+    {
+        for (size_t s = 0; s < sizeof(fileSizes) / sizeof(fileSizes[0]); s++)
+        {
+            uint32_t length = fileSizes[s];
+            if (length > _chip.size() / 2 || !freshVolume())
+                continue;
+            for (uint32_t round = 0; round < 5; round++)
+            {
+                std::string first = payload(length, round);
+                std::string second = payload(length, round + 100);
+                if (!measure("file_size", "writeFile", length, [&]() { return _fs.writeFile("blob", first.c_str()); }))
+                    break;
+                measure("file_size", "readFile", length, [&]() { return readBack("blob", length); });
+                measure("file_size", "updateFile", length, [&]() { return _fs.updateFile("blob", second.c_str()); });
+                measure("file_size", "deleteFile", length, [&]() { return _fs.deleteFile("blob"); });
+            }
+        }
+    }
+
+    // A handful of small settings files, read often and rewritten in place, every tenth round with a new length.
+    void configChurn()
+    {
+        const uint32_t files = 4;
+        uint32_t lengths[files];
+        if (!freshVolume())
+            return;
+
+        char name[MJOLN_FILE_NAME_MAX_LENGTH];
+        for (uint32_t f = 0; f < files; f++)
+        {
+            snprintf(name, sizeof(name), "cfg%u", f);
+            lengths[f] = 48;
+            std::string data = payload(lengths[f], f);
+            if (!measure("config_churn", "writeFile", lengths[f], [&]() { return _fs.writeFile(name, data.c_str()); }))
+                return;
+        }
+        for (uint32_t round = 1; round <= 50; round++)
+        {
+            for (uint32_t f = 0; f < files; f++)
+            {
+                snprintf(name, sizeof(name), "cfg%u", f);
+                measure("config_churn", "readFile", lengths[f], [&]() { return readBack(name, lengths[f]); });
+                if (round % 10 == 0)
+                {
+                    measure("config_churn", "deleteFile", lengths[f], [&]() { return _fs.deleteFile(name); });
+                    lengths[f] = lengths[f] == 48 ? 56 : 48;
+                    std::string data = payload(lengths[f], round * files + f);
+                    measure("config_churn", "writeFile", lengths[f], [&]() { return _fs.writeFile(name, data.c_str()); });
+                    continue;
+                }
+                std::string data = payload(lengths[f], round * files + f);
+                measure("config_churn", "updateFile", lengths[f], [&]() { return _fs.updateFile(name, data.c_str()); });
+            }
+        }
+    }
+
+    // One log growing by short records until it fills a quarter of the chip, then read back whole.
+    void appendLog()
+    {
+        const uint32_t record = 24;
+        if (!freshVolume())
+            return;
+
+        std::string first = payload(record, 0);
+        if (!measure("append_log", "writeFile", record, [&]() { return _fs.writeFile("log", first.c_str()); }))
+            return;
+        uint32_t length = record;
+        uint32_t records = std::min<uint32_t>(400, _chip.size() / 4 / record);
+        for (uint32_t i = 1; i < records; i++)
+        {
+            std::string next = payload(record, i);
+            if (!measure("append_log", "appendFile", record, [&]() { return _fs.appendFile("log", next.c_str()); }))
+                break;
+            length += record;
+        }
+        measure("append_log", "readFile", length, [&]() { return readBack("log", length); });
+        measure("append_log", "mount", 0, [&]() { return _fs.mount(); });
+    }
+
+    // As many small files as the FAT holds, up to a limit, then each read and deleted.
+    void manySmallFiles()
+    {
+        const uint32_t length = 16;
+        if (!freshVolume())
+            return;
+
+        char name[MJOLN_FILE_NAME_MAX_LENGTH];
+        uint32_t created = 0;
+        for (; created < 256; created++)
+        {
+            snprintf(name, sizeof(name), "f%u", created);
+            std::string data = payload(length, created);
+            if (!measure("many_small", "writeFile", length, [&]() { return _fs.writeFile(name, data.c_str()); }))
+                break;
+        }
+        measure("many_small", "mount", 0, [&]() { return _fs.mount(); });
+        for (uint32_t i = 0; i < created; i++)
+        {
+            snprintf(name, sizeof(name), "f%u", i);
+            measure("many_small", "readFile", length, [&]() { return readBack(name, length); });
+        }
+        for (uint32_t i = 0; i < created; i++)
+        {
+            snprintf(name, sizeof(name), "f%u", i);
+            measure("many_small", "deleteFile", length, [&]() { return _fs.deleteFile(name); });
+        }
+    }
+
+    AT24CEmulator _chip;
+    MjolnFileSystem _fs;
+    std::vector<char> _buffer;
+    std::vector<OpSeries> _series;
+};
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, uint32_t percent)
+{
+    // Nearest rank, so every reported value is one that was measured.
+    size_t rank = (sorted.size() * percent + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void printSeries(FILE *out, AT24CEmulator &chip, const OpSeries &series, bool first)
+{
+    uint64_t micros = 0, busBytes = 0, transactions = 0, programs = 0;
+    std::vector<uint64_t> latencies;
+    for (size_t i = 0; i < series.samples.size(); i++)
+    {
+        const OpSample &sample = series.samples[i];
+        micros += sample.micros;
+        busBytes += sample.busBytes;
+        transactions += sample.transactions;
+        programs += sample.pagePrograms;
+        latencies.push_back(sample.micros);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double ops = series.samples.size();
+
+    fprintf(out, "%s    {\"chip\": \"%s\", \"size\": %u, \"page\": %u, \"workload\": \"%s\", \"op\": \"%s\", \"file_bytes\": %u,\n",
+            first ? "" : ",\n", at24cxTypeName(chip.type()), chip.size(), chip.pageSize(), series.workload.c_str(), series.op.c_str(), series.fileBytes);
+    fprintf(out, "     \"ops\": %u, \"failures\": %u", (unsigned)series.samples.size(), series.failures);
+    if (series.samples.empty())
+    {
+        fprintf(out, "}");
+        return;
+    }
+    fprintf(out, ", \"ops_per_sec\": %.1f, \"i2c_transactions_per_op\": %.2f, \"bus_bytes_per_op\": %.1f, \"page_programs_per_op\": %.2f,\n",
+            micros ? ops * 1e6 / micros : 0.0, transactions / ops, busBytes / ops, programs / ops);
+    fprintf(out, "     \"latency_us\": {\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu}}",
+            (unsigned long long)percentile(latencies, 50), (unsigned long long)percentile(latencies, 90),
+            (unsigned long long)percentile(latencies, 99), (unsigned long long)latencies.back());
+}
+
+static void printSummary(AT24CEmulator &chip, const OpSeries &series)
+{
+    if (series.samples.empty())
+    {
+        fprintf(stderr, "%-9s %-13s %-10s %6u %8s  all %u failed\n", at24cxTypeName(chip.type()), series.workload.c_str(), series.op.c_str(),
+                series.fileBytes, "", series.failures);
+        return;
+    }
+    uint64_t micros = 0, programs = 0;
+    for (size_t i = 0; i < series.samples.size(); i++)
+    {
+        micros += series.samples[i].micros;
+        programs += series.samples[i].pagePrograms;
+    }
+    double ops = series.samples.size();
+    fprintf(stderr, "%-9s %-13s %-10s %6u %8.1f ops/s %7.2f programs/op%s\n", at24cxTypeName(chip.type()), series.workload.c_str(),
+            series.op.c_str(), series.fileBytes, micros ? ops * 1e6 / micros : 0.0, programs / ops, series.failures ? "  (some failed)" : "");
+}
+
+static void printUsage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--chip AT24Cxx] [--twr us] [--clock hz] [--out file]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<AT24CXType> chips;
+    uint32_t writeCycleUs = AT24C_DEFAULT_WRITE_CYCLE_US;
+    uint32_t clock = 100000;
+    const char *outPath = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--chip") == 0)
+        {
+            AT24CXType type;
+            if (!parseAT24CXType(argv[++i], type))
+            {
+                fprintf(stderr, "Unknown chip %s\n", argv[i]);
+                return 2;
+            }
+            chips.push_back(type);
+        }
+        else if (strcmp(argv[i], "--twr") == 0)
+            writeCycleUs = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--clock") == 0)
+            clock = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--out") == 0)
+            outPath = argv[++i];
+        else
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (chips.empty())
+        chips.assign(models, models + sizeof(models) / sizeof(models[0]));
+
+    FILE *out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "Failed to open %s\n", outPath);
+        return 1;
+    }
+
+    Wire.setClock(clock);
+    fprintf(out, "{\"format_version\": %u, \"write_cycle_us\": %u, \"clock_hz\": %u, \"time\": \"simulated\",\n \"results\": [\n",
+            MJOLN_FILE_SYSTEM_VERSION, writeCycleUs, clock);
+    bool first = true;
+    for (size_t c = 0; c < chips.size(); c++)
+    {
+        Benchmark bench(chips[c], writeCycleUs);
+        bench.run();
+        for (size_t i = 0; i < bench.series().size(); i++)
+        {
+            printSeries(out, bench.chip(), bench.series()[i], first);
+            printSummary(bench.chip(), bench.series()[i]);
+            first = false;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
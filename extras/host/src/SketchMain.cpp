@@ -0,0 +1,85 @@
+#include "Arduino.h"
+#include "Wire.h"
+#include "AT24CEmulator.h"
+
+void setup();
+void loop();
+
+static AT24CEmulator *device = NULL;
+static const char *imagePath = NULL;
+
+static void printUsage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--chip AT24Cxx] [--twr us] [--clock hz] [--image file] [--loops n]\n", program);
+}
+
+static void report()
+{
+    if (!device)
+        return;
+
+    if (imagePath && !device->saveImage(imagePath))
+        fprintf(stderr, "Failed to save image to %s\n", imagePath);
+
+    const I2CBusStats &bus = Wire.stats();
+    const AT24CStats &chip = device->stats();
+    fflush(stdout);
+    fprintf(stderr, "\n[host] chip=%s size=%u page=%u\n", at24cxTypeName(device->type()), device->size(), device->pageSize());
+    fprintf(stderr, "[host] i2c transactions=%u (write=%u read=%u nack=%u) bytes=%llu bus_us=%llu\n",
+            bus.transactions, bus.writeTransfers, bus.readTransfers, bus.addressNacks,
+            (unsigned long long)bus.bytesOnBus, (unsigned long long)bus.busMicros);
+    fprintf(stderr, "[host] page_programs=%u bytes_programmed=%u busy_nacks=%u max_page_wear=%u\n",
+            chip.pagePrograms, chip.bytesProgrammed, chip.busyNacks, device->maxPageWear());
+    fprintf(stderr, "[host] elapsed_us=%llu delay_us=%llu\n", (unsigned long long)hostMicros(), (unsigned long long)hostDelayMicros());
+}
+
+int main(int argc, char **argv)
+{
+    AT24CXType type = AT24C32;
+    uint32_t writeCycleUs = AT24C_DEFAULT_WRITE_CYCLE_US;
+    uint32_t clock = 100000;
+    long loops = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--chip") == 0)
+        {
+            if (!parseAT24CXType(argv[++i], type))
+            {
+                fprintf(stderr, "Unknown chip %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--twr") == 0)
+            writeCycleUs = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--clock") == 0)
+            clock = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--image") == 0)
+            imagePath = argv[++i];
+        else if (strcmp(argv[i], "--loops") == 0)
+            loops = strtol(argv[++i], NULL, 10);
+        else
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    static AT24CEmulator chip(type, MJOLN_STORAGE_DEVICE_ADDRESS, writeCycleUs);
+    device = &chip;
+    if (imagePath)
+        chip.loadImage(imagePath);
+    Wire.setClock(clock);
+    Wire.attach(&chip);
+    atexit(report);
+
+    setup();
+    for (long i = 0; i < loops; i++)
+        loop();
+    return 0;
+}
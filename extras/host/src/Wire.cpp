@@ -0,0 +1,130 @@
+#include "Wire.h"
+
+TwoWire Wire;
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+    _txAddress = address;
+    _txLength = 0;
+    _transmitting = true;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+    if (!_transmitting || _txLength >= WIRE_HOST_BUFFER_LENGTH)
+        return 0;
+    _txBuffer[_txLength++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t length)
+{
+    size_t written = 0;
+    while (written < length && write(data[written]))
+        written++;
+    return written;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+    (void)sendStop;
+    if (!_transmitting)
+        return 4;
+    _transmitting = false;
+
+    _stats.transactions++;
+    _stats.writeTransfers++;
+
+    I2CDevice *device = findDevice(_txAddress);
+    if (!device || !device->onAddress(_txAddress, false))
+    {
+        _stats.addressNacks++;
+        clockBytes(1);
+        return 2;
+    }
+
+    clockBytes(1 + _txLength);
+    device->onWrite(_txAddress, _txBuffer, _txLength);
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
+{
+    return requestFrom((int)address, (int)quantity);
+}
+
+uint8_t TwoWire::requestFrom(int address, int quantity)
+{
+    _rxLength = 0;
+    _rxIndex = 0;
+    if (quantity <= 0)
+        return 0;
+    if (quantity > WIRE_HOST_BUFFER_LENGTH)
+        quantity = WIRE_HOST_BUFFER_LENGTH;
+
+    _stats.transactions++;
+    _stats.readTransfers++;
+
+    I2CDevice *device = findDevice((uint8_t)address);
+    if (!device || !device->onAddress((uint8_t)address, true))
+    {
+        _stats.addressNacks++;
+        clockBytes(1);
+        return 0;
+    }
+
+    clockBytes(1 + quantity);
+    device->onRead((uint8_t)address, _rxBuffer, quantity);
+    _rxLength = quantity;
+    return (uint8_t)quantity;
+}
+
+int TwoWire::available()
+{
+    return (int)(_rxLength - _rxIndex);
+}
+
+int TwoWire::read()
+{
+    if (_rxIndex >= _rxLength)
+        return -1;
+    return _rxBuffer[_rxIndex++];
+}
+
+int TwoWire::peek()
+{
+    if (_rxIndex >= _rxLength)
+        return -1;
+    return _rxBuffer[_rxIndex];
+}
+
+bool TwoWire::attach(I2CDevice *device)
+{
+    if (!device || _deviceCount >= WIRE_HOST_MAX_DEVICES)
+        return false;
+    _devices[_deviceCount++] = device;
+    return true;
+}
+
+void TwoWire::detachAll()
+{
+    _deviceCount = 0;
+}
+
+I2CDevice *TwoWire::findDevice(uint8_t address)
+{
+    for (uint8_t i = 0; i < _deviceCount; i++)
+        if (_devices[i]->ownsAddress(address))
+            return _devices[i];
+    return NULL;
+}
+
+void TwoWire::clockBytes(size_t count)
+{
+    // Each byte is 8 data bits plus ACK; start and stop conditions add roughly one bit time each.
+    uint64_t bits = count * 9 + 2;
+    uint64_t us = (bits * 1000000ULL + _frequency - 1) / _frequency;
+    _stats.bytesOnBus += count;
+    _stats.busMicros += us;
+    hostAdvanceMicros(us);
+}
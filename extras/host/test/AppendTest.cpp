@@ -0,0 +1,62 @@
+#include "HostTest.h"
+
+// Appends records to three logs in turn until the volume refuses one, then checks how much of the chip the
+// logs got to use and that every log reads back whole, before and after a remount.
+
+static const char *logs[] = {"log0", "log1", "log2"};
+static const uint8_t logCount = sizeof(logs) / sizeof(logs[0]);
+
+static void fillLogs(AT24CXType type, uint32_t recordBytes, uint8_t minPercent)
+{
+    AT24CEmulator chip(type);
+    hostAttach(chip);
+    MjolnFileSystem fs(type);
+    fs.showLogs(false);
+    HOST_CHECK(fs.format() && fs.mount());
+
+    std::string contents[logCount];
+    uint32_t appended = 0;
+    for (uint32_t n = 0;; n++)
+    {
+        std::string record = hostPayload(recordBytes, n);
+        if (!fs.appendFile(logs[n % logCount], record.c_str()))
+            break;
+        contents[n % logCount] += record;
+        appended += recordBytes;
+    }
+
+    // The boot sector, the superblocks and the FAT take their share, but the logs must get most of the chip,
+    // unless the FAT runs out first: an extent is only chained once the last one spans the merge pages.
+    uint32_t size = chip.size();
+    uint32_t chained = (uint32_t)(MJOLN_FILE_SYSTEM_MAX_FILES - logCount) * MJOLN_FILE_SYSTEM_APPEND_MERGE_PAGES * chip.pageSize();
+    fprintf(stderr, "AppendTest: %u-byte records filled %lu of %lu bytes\n", recordBytes, (unsigned long)appended, (unsigned long)size);
+    HOST_CHECK(appended >= min(size * minPercent / 100, chained));
+
+    for (uint8_t i = 0; i < logCount; i++)
+    {
+        std::string read;
+        HOST_CHECK(hostReadFile(fs, logs[i], read) && read == contents[i]);
+    }
+
+    MjolnFileSystem remounted(type);
+    remounted.showLogs(false);
+    HOST_CHECK(remounted.mount());
+    for (uint8_t i = 0; i < logCount; i++)
+    {
+        std::string read;
+        HOST_CHECK(hostReadFile(remounted, logs[i], read) && read == contents[i]);
+    }
+    while (remounted.fsckStep())
+        ;
+    FS_FsckReport report = remounted.getFsckReport();
+    HOST_CHECK(report.complete && report.dropped == 0 && report.brokenChains == 0 && report.orphanLinks == 0 &&
+               report.overlaps == 0 && !report.countersFixed);
+}
+
+int main()
+{
+    fillLogs(AT24C32, 24, 60);
+    fillLogs(AT24C256, 24, 80);
+    fillLogs(AT24C256, 100, 80);
+    return hostTestResult("AppendTest");
+}
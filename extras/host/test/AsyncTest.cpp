@@ -0,0 +1,98 @@
+#include <vector>
+#include "HostTest.h"
+
+// Queues writes with asynchronous writes enabled and drains them with poll() alone, checking that no call
+// takes more than one I2C transaction, that every ticket is reported once and in order, and that the
+// volume holds the files afterwards.
+
+static std::vector<uint32_t> reported;
+static bool allSucceeded = true;
+
+static void onComplete(uint32_t ticket, bool success)
+{
+    reported.push_back(ticket);
+    allSucceeded &= success;
+}
+
+// Polls until the queue is drained; returns false if a call did more than one transaction.
+static bool drain(MjolnFileSystem &fs)
+{
+    bool bounded = true;
+    for (uint32_t calls = 0; calls < 100000; calls++)
+    {
+        fs.resetStats();
+        bool pending = fs.poll();
+        bounded &= fs.getStats().i2cTransactions <= 1;
+        if (!pending)
+            return bounded;
+        delay(1);
+    }
+    return false;
+}
+
+static void run(AT24CXType type, uint8_t chipCount)
+{
+    std::vector<AT24CEmulator *> chips;
+    Wire.detachAll();
+    for (uint8_t i = 0; i < chipCount; i++)
+    {
+        chips.push_back(new AT24CEmulator(type, MJOLN_STORAGE_DEVICE_ADDRESS + i));
+        Wire.attach(chips.back());
+    }
+
+    std::vector<std::string> names, contents;
+    {
+        MjolnFileSystem fs(type, chipCount);
+        fs.showLogs(false);
+        HOST_CHECK(fs.format() && fs.mount());
+        HOST_CHECK(fs.enableAsyncWrites());
+        reported.clear();
+        allSucceeded = true;
+        fs.onWriteComplete(onComplete);
+
+        uint32_t tickets = 0;
+        for (uint32_t n = 0; n < 12; n++)
+        {
+            // Files of a few pages, so pages larger than the Wire buffer are sent in several transmissions.
+            char name[MJOLN_FILE_NAME_MAX_LENGTH];
+            snprintf(name, sizeof(name), "f%u", n);
+            names.push_back(name);
+            contents.push_back(hostPayload(40 + n * 23, n));
+            HOST_CHECK(fs.writeFile(name, contents.back().c_str()));
+            tickets = fs.lastTicket();
+            if (n % 3 == 2)
+                HOST_CHECK(drain(fs));
+        }
+        HOST_CHECK(drain(fs));
+
+        HOST_CHECK(allSucceeded && reported.size() == tickets);
+        for (uint32_t i = 0; i < reported.size(); i++)
+            HOST_CHECK(reported[i] == i + 1);
+        for (uint32_t i = 0; i < names.size(); i++)
+        {
+            std::string read;
+            HOST_CHECK(hostReadFile(fs, names[i].c_str(), read) && read == contents[i]);
+        }
+    }
+
+    MjolnFileSystem remounted(type, chipCount);
+    remounted.showLogs(false);
+    HOST_CHECK(remounted.mount());
+    for (uint32_t i = 0; i < names.size(); i++)
+    {
+        std::string read;
+        HOST_CHECK(hostReadFile(remounted, names[i].c_str(), read) && read == contents[i]);
+    }
+
+    Wire.detachAll();
+    for (uint8_t i = 0; i < chipCount; i++)
+        delete chips[i];
+}
+
+int main()
+{
+    run(AT24C32, 1);
+    run(AT24C256, 1);
+    run(AT24C256, 2);
+    return hostTestResult("AsyncTest");
+}
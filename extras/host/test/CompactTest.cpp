@@ -0,0 +1,130 @@
+#include <map>
+#include "HostTest.h"
+
+// Fragments a volume with deletes and appends, compacts it and checks every file, the space it won back and
+// that fsck finds nothing to repair after a remount. A write between two steps must cancel the move in
+// progress and leave the running instance and the EEPROM agreeing on the files.
+
+typedef std::map<std::string, std::string> Files;
+
+static bool holds(MjolnFileSystem &fs, const Files &files)
+{
+    for (Files::const_iterator it = files.begin(); it != files.end(); ++it)
+    {
+        std::string contents;
+        if (!hostReadFile(fs, it->first.c_str(), contents) || contents != it->second)
+            return false;
+    }
+    return true;
+}
+
+static bool clean(MjolnFileSystem &fs)
+{
+    while (fs.fsckStep())
+        ;
+    FS_FsckReport report = fs.getFsckReport();
+    return report.complete && report.repaired == 0 && report.dropped == 0 && report.brokenChains == 0 &&
+           report.orphanLinks == 0 && report.overlaps == 0 && !report.countersFixed;
+}
+
+// Runs compact() in slices of the time budget until it reports the layout compact.
+static bool compacted(MjolnFileSystem &fs)
+{
+    for (uint32_t calls = 0; calls < 1000; calls++)
+        if (!fs.compact(50))
+            return true;
+    return false;
+}
+
+// Finds the largest file that still fits, by writing and deleting it again.
+static uint32_t largestFile(MjolnFileSystem &fs, uint32_t limit)
+{
+    uint32_t low = 0, high = limit;
+    while (low < high)
+    {
+        uint32_t mid = (low + high + 1) / 2;
+        if (fs.writeFile("big", hostPayload(mid, mid).c_str()))
+        {
+            HOST_CHECK(fs.deleteFile("big"));
+            low = mid;
+        }
+        else
+            high = mid - 1;
+    }
+    return low;
+}
+
+static void writeFile(MjolnFileSystem &fs, Files &files, const char *name, uint32_t length, uint32_t seed)
+{
+    files[name] = hostPayload(length, seed);
+    HOST_CHECK(fs.writeFile(name, files[name].c_str()));
+}
+
+int main()
+{
+    AT24CEmulator chip(AT24C32);
+    hostAttach(chip);
+    Files files;
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(fs.format() && fs.mount());
+
+        // Every other file is deleted, and the survivors grow by appends that land above the holes.
+        for (uint32_t n = 0; n < 10; n++)
+        {
+            char name[MJOLN_FILE_NAME_MAX_LENGTH];
+            snprintf(name, sizeof(name), "f%u", n);
+            writeFile(fs, files, name, 120 + n * 37, n);
+        }
+        for (uint32_t n = 0; n < 10; n += 2)
+        {
+            char name[MJOLN_FILE_NAME_MAX_LENGTH];
+            snprintf(name, sizeof(name), "f%u", n);
+            HOST_CHECK(fs.deleteFile(name));
+            files.erase(name);
+        }
+        for (uint32_t round = 0; round < 3; round++)
+            for (uint32_t n = 1; n < 10; n += 4)
+            {
+                char name[MJOLN_FILE_NAME_MAX_LENGTH];
+                snprintf(name, sizeof(name), "f%u", n);
+                std::string record = hostPayload(90, 100 + round * 10 + n);
+                HOST_CHECK(fs.appendFile(name, record.c_str()));
+                files[name] += record;
+            }
+        HOST_CHECK(holds(fs, files));
+
+        uint32_t fragmented = largestFile(fs, chip.size());
+        HOST_CHECK(compacted(fs));
+        HOST_CHECK(!fs.compactStep());
+        uint32_t largest = largestFile(fs, chip.size());
+        fprintf(stderr, "CompactTest: largest file %lu bytes before compaction, %lu after\n", (unsigned long)fragmented, (unsigned long)largest);
+        HOST_CHECK(largest > fragmented);
+        HOST_CHECK(holds(fs, files));
+    }
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(fs.mount() && holds(fs, files) && clean(fs) && holds(fs, files));
+
+        // A hole at the bottom makes the next move, of f5, a long one; updating f5 after its first step
+        // cancels it, where finishing it would bring back the old contents.
+        HOST_CHECK(fs.deleteFile("f1"));
+        files.erase("f1");
+        HOST_CHECK(fs.compactStep());
+        files["f5"] = hostPayload(500, 200);
+        HOST_CHECK(fs.updateFile("f5", files["f5"].c_str()));
+        HOST_CHECK(holds(fs, files));
+
+        MjolnFileSystem remounted(AT24C32);
+        remounted.showLogs(false);
+        HOST_CHECK(remounted.mount() && holds(remounted, files) && clean(remounted));
+
+        HOST_CHECK(compacted(fs) && holds(fs, files));
+    }
+    MjolnFileSystem remounted(AT24C32);
+    remounted.showLogs(false);
+    HOST_CHECK(remounted.mount() && holds(remounted, files) && clean(remounted));
+    return hostTestResult("CompactTest");
+}
@@ -0,0 +1,286 @@
+#include <map>
+#include <vector>
+#include "HostTest.h"
+
+// Cuts the power after every page program of a scripted workload in turn, remounts the volume and checks that
+// it holds the files as they were either before or after the operation that was interrupted, and that fsck
+// finds nothing to repair beyond the FAT copy the interrupted update was writing. A stalled program instead
+// fails the operation while the instance keeps running, which must then agree with the EEPROM.
+
+typedef std::map<std::string, std::string> Files;
+
+enum CutMode
+{
+    CUT_DROP,
+    CUT_TEAR,
+    CUT_STALL
+};
+
+/**
+ * @brief EEPROM that loses power, or stalls, during its Nth page program.
+ * @note A dropped program leaves the page as it was; a torn one programs only the first half of its bytes.
+ * Nothing is programmed after the cut, but the bus keeps answering, so the file system runs on unaware.
+ * A stalled program completes, but its write cycle outlasts the driver's timeout once; the chip then
+ * works normally again.
+ */
+class CrashingEEPROM : public AT24CEmulator
+{
+public:
+    CrashingEEPROM(AT24CXType type) : AT24CEmulator(type) {}
+
+    void arm(uint32_t crashAt, CutMode mode)
+    {
+        _programs = 0;
+        _crashAt = crashAt;
+        _mode = mode;
+    }
+
+    uint32_t programs() const { return _programs; }
+    bool cut() const { return _crashAt != 0 && _programs >= _crashAt; }
+
+    void onWrite(uint8_t address, const uint8_t *data, size_t length) override
+    {
+        // A transfer of only the word address sets the read pointer and programs nothing.
+        if (length <= addressBytes())
+        {
+            AT24CEmulator::onWrite(address, data, length);
+            return;
+        }
+        _programs++;
+        if (_crashAt == 0 || _programs < _crashAt || (_mode == CUT_STALL && _programs > _crashAt))
+            AT24CEmulator::onWrite(address, data, length);
+        else if (_programs == _crashAt && _mode == CUT_TEAR)
+            AT24CEmulator::onWrite(address, data, addressBytes() + (length - addressBytes()) / 2);
+        else if (_programs == _crashAt && _mode == CUT_STALL)
+        {
+            setWriteCycleMicros(MJOLN_WRITE_CYCLE_TIMEOUT_US * 3 / 2);
+            AT24CEmulator::onWrite(address, data, length);
+            setWriteCycleMicros(AT24C_DEFAULT_WRITE_CYCLE_US);
+        }
+    }
+
+private:
+    uint32_t _programs = 0;
+    uint32_t _crashAt = 0;
+    CutMode _mode = CUT_DROP;
+};
+
+struct Config
+{
+    const char *name;
+    bool cache;
+    bool wearLeveling;
+    CutMode mode;
+};
+
+static const Config configs[] = {
+    {"drop", false, false, CUT_DROP},
+    {"tear", false, false, CUT_TEAR},
+    {"tear, write cache", true, false, CUT_TEAR},
+    {"tear, wear leveling", false, true, CUT_TEAR},
+    {"stall", false, false, CUT_STALL},
+    {"stall, write cache", true, false, CUT_STALL},
+};
+
+static const char *names[] = {"a", "b", "c", "d"};
+
+// The workload; each step is one operation and returns false if the file system refused it.
+static bool step(MjolnFileSystem &fs, int n, Files &files)
+{
+    std::string data;
+    switch (n)
+    {
+    case 0:
+        data = hostPayload(130, 1);
+        files["a"] = data;
+        return fs.writeFile("a", data.c_str());
+    case 1:
+        data = hostPayload(60, 2);
+        files["b"] = data;
+        return fs.writeFile("b", data.c_str());
+    case 2:
+        data = hostPayload(40, 3);
+        files["c"] = data;
+        return fs.writeFile("c", data.c_str());
+    case 3:
+        data = hostPayload(70, 4);
+        files["a"] = data;
+        return fs.updateFile("a", data.c_str());
+    case 4:
+        data = hostPayload(60, 5);
+        files["b"] = data;
+        return fs.updateFile("b", data.c_str());
+    case 5:
+        data = hostPayload(24, 6);
+        files["c"] += data;
+        return fs.appendFile("c", data.c_str());
+    case 6:
+        files.erase("b");
+        return fs.deleteFile("b");
+    case 7:
+        data = hostPayload(90, 7);
+        files["d"] = data;
+        return fs.writeFile("d", data.c_str());
+    case 8:
+        data = hostPayload(24, 8);
+        files["c"] += data;
+        return fs.appendFile("c", data.c_str());
+    case 9:
+        data = hostPayload(150, 9);
+        files["a"] = data;
+        return fs.updateFile("a", data.c_str());
+    case 10:
+        data = hostPayload(90, 10);
+        files["d"] = data;
+        return fs.updateFile("d", data.c_str());
+    default:
+        return false;
+    }
+}
+
+static const int stepCount = 11;
+
+static bool startVolume(CrashingEEPROM &chip, MjolnFileSystem &fs, const Config &config)
+{
+    chip.erase();
+    chip.arm(0, CUT_DROP);
+    fs.showLogs(false);
+    fs.enableWearLeveling(config.wearLeveling);
+    if (!fs.format() || !fs.mount())
+        return false;
+    if (config.cache)
+        fs.enableWriteCache();
+    return true;
+}
+
+static bool holds(MjolnFileSystem &fs, const Files &files)
+{
+    for (uint8_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        std::string contents;
+        bool exists = hostReadFile(fs, names[i], contents);
+        Files::const_iterator expected = files.find(names[i]);
+        if (exists != (expected != files.end()) || (exists && contents != expected->second))
+            return false;
+    }
+    return true;
+}
+
+// The files must be whole and fsck must find nothing to repair, counters included.
+static bool checked(MjolnFileSystem &fs, const Files &before, const Files &after)
+{
+    if (!holds(fs, before) && !holds(fs, after))
+        return false;
+    while (fs.fsckStep())
+        ;
+    FS_FsckReport report = fs.getFsckReport();
+    return report.complete && report.dropped == 0 && report.brokenChains == 0 && report.orphanLinks == 0 &&
+           report.overlaps == 0 && !report.countersFixed && (holds(fs, before) || holds(fs, after));
+}
+
+// Stalls the program at the cut, then checks the running instance, that it still takes a new file and that
+// a remount sees the same volume.
+static bool stallAt(CrashingEEPROM &chip, const Config &config, uint32_t cut, const std::vector<Files> &states, int interrupted)
+{
+    MjolnFileSystem fs(AT24C32);
+    startVolume(chip, fs, config);
+    chip.arm(cut, config.mode);
+    Files files;
+    for (int n = 0; n <= interrupted; n++)
+    {
+        bool done = step(fs, n, files);
+        done = fs.flush() && done;
+        if (n < interrupted && !done)
+            return false;
+    }
+    // A stall of the step's last program only shows on the next access; the checks start after it ended.
+    delay(MJOLN_WRITE_CYCLE_TIMEOUT_US * 3 / 2 / 1000);
+    if (!checked(fs, states[interrupted], states[interrupted + 1]))
+        return false;
+
+    std::string extra = hostPayload(50, 11);
+    if (!fs.writeFile("e", extra.c_str()) || !fs.flush())
+        return false;
+    Files before = states[interrupted];
+    Files after = states[interrupted + 1];
+    before["e"] = extra;
+    after["e"] = extra;
+
+    MjolnFileSystem remounted(AT24C32);
+    remounted.showLogs(false);
+    std::string contents;
+    return remounted.mount() && hostReadFile(remounted, "e", contents) && contents == extra &&
+           (holds(remounted, states[interrupted]) == holds(fs, states[interrupted])) && checked(remounted, before, after);
+}
+
+static void runConfig(const Config &config)
+{
+    CrashingEEPROM chip(AT24C32);
+    hostAttach(chip);
+
+    // A run without a cut records the files and the page programs done after every step.
+    std::vector<Files> states(1);
+    std::vector<uint32_t> programsAfter;
+    {
+        MjolnFileSystem fs(AT24C32);
+        HOST_CHECK(startVolume(chip, fs, config));
+        uint32_t formatted = chip.programs();
+        for (int n = 0; n < stepCount; n++)
+        {
+            Files files = states.back();
+            HOST_CHECK(step(fs, n, files));
+            HOST_CHECK(fs.flush());
+            states.push_back(files);
+            programsAfter.push_back(chip.programs() - formatted);
+        }
+    }
+
+    int failures = 0;
+    for (uint32_t cut = 1; cut <= programsAfter.back(); cut++)
+    {
+        int interrupted = 0;
+        while (programsAfter[interrupted] < cut)
+            interrupted++;
+
+        if (config.mode == CUT_STALL)
+        {
+            if (!stallAt(chip, config, cut, states, interrupted))
+            {
+                fprintf(stderr, "%s: stall at page program %u, during step %d: inconsistent\n", config.name, cut, interrupted);
+                failures++;
+            }
+            continue;
+        }
+
+        {
+            MjolnFileSystem fs(AT24C32);
+            startVolume(chip, fs, config);
+            chip.arm(cut, config.mode);
+            Files files;
+            for (int n = 0; n < stepCount; n++)
+            {
+                step(fs, n, files);
+                fs.flush();
+            }
+        }
+
+        chip.arm(0, CUT_DROP);
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        bool mounted = fs.mount();
+        if (!mounted || !checked(fs, states[interrupted], states[interrupted + 1]))
+        {
+            fprintf(stderr, "%s: cut at page program %u, during step %d: mounted=%d, inconsistent\n", config.name, cut, interrupted, mounted);
+            failures++;
+        }
+    }
+    HOST_CHECK(failures == 0);
+    fprintf(stderr, "%s: %u cuts, %d inconsistent\n", config.name, programsAfter.back(), failures);
+}
+
+int main()
+{
+    for (uint8_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+        runConfig(configs[i]);
+    return hostTestResult("CrashTest");
+}
@@ -0,0 +1,63 @@
+#include "HostTest.h"
+
+// Checks that a write which grew the FAT and then failed gives the chunk back, so the data area the next
+// commit records is as large as on a volume where the write was never tried.
+
+static const uint16_t entriesPerChunk = 4; // Three 32-byte pages of 24-byte entries on an AT24C32
+
+// Finds the largest file that still fits, by writing and deleting it again.
+static uint32_t largestFile(MjolnFileSystem &fs, uint32_t limit)
+{
+    uint32_t low = 0, high = limit;
+    while (low < high)
+    {
+        uint32_t mid = (low + high + 1) / 2;
+        if (fs.writeFile("big", hostPayload(mid, mid).c_str()))
+        {
+            HOST_CHECK(fs.deleteFile("big"));
+            low = mid;
+        }
+        else
+            high = mid - 1;
+    }
+    return low;
+}
+
+// Fills the first FAT chunk, optionally tries a file too large for the chip, and frees one entry again.
+static uint32_t run(bool failedWrite)
+{
+    AT24CEmulator chip(AT24C32);
+    hostAttach(chip);
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(fs.format() && fs.mount());
+        for (uint16_t n = 0; n < entriesPerChunk; n++)
+        {
+            char name[MJOLN_FILE_NAME_MAX_LENGTH];
+            snprintf(name, sizeof(name), "f%u", n);
+            HOST_CHECK(fs.writeFile(name, hostPayload(16, n).c_str()));
+        }
+        // The FAT has to grow for this file before its data is found not to fit.
+        if (failedWrite)
+            HOST_CHECK(!fs.writeFile("huge", hostPayload(chip.size(), 9).c_str()));
+        HOST_CHECK(fs.deleteFile("f0"));
+    }
+
+    MjolnFileSystem remounted(AT24C32);
+    remounted.showLogs(false);
+    HOST_CHECK(remounted.mount());
+    uint32_t largest = largestFile(remounted, chip.size());
+    std::string contents;
+    HOST_CHECK(hostReadFile(remounted, "f1", contents) && contents == hostPayload(16, 1));
+    return largest;
+}
+
+int main()
+{
+    uint32_t untouched = run(false);
+    uint32_t afterFailure = run(true);
+    fprintf(stderr, "FatTest: largest file %lu bytes, %lu after a failed write\n", (unsigned long)untouched, (unsigned long)afterFailure);
+    HOST_CHECK(untouched > 0 && afterFailure == untouched);
+    return hostTestResult("FatTest");
+}
@@ -0,0 +1,151 @@
+#include <string.h>
+#include <unistd.h>
+#include "HostTest.h"
+
+// Checks that a quick format() programs no more than the boot sector and one superblock, and that the files of
+// the generation before it are gone: its superblocks fail their CRC, so none of its files is opened or
+// listed, not even once new entries take the FAT chunk that held them. Then checks that cleanFormat()
+// programs only the pages that are not blank yet.
+
+static const char *oldNames[] = {"a", "b", "c", "d", "e", "f"};
+static const uint8_t oldCount = sizeof(oldNames) / sizeof(oldNames[0]);
+
+static uint32_t lastProgress = 0;
+
+static void onProgress(uint32_t done, uint32_t total)
+{
+    (void)total;
+    lastProgress = done;
+}
+
+static uint32_t pagesDiffering(AT24CEmulator &chip, const std::string &image)
+{
+    uint32_t pages = 0;
+    for (uint32_t addr = 0; addr < chip.size(); addr += chip.pageSize())
+        pages += memcmp(chip.memory() + addr, image.data() + addr, chip.pageSize()) != 0;
+    return pages;
+}
+
+static uint32_t pagesInUse(AT24CEmulator &chip)
+{
+    uint32_t pages = 0;
+    for (uint32_t addr = 0; addr < chip.size(); addr += chip.pageSize())
+        for (uint16_t i = 0; i < chip.pageSize(); i++)
+            if (chip.memory()[addr + i] != 0xFF)
+            {
+                pages++;
+                break;
+            }
+    return pages;
+}
+
+// Captures what listFiles() prints.
+static std::string listing(MjolnFileSystem &fs)
+{
+    fflush(stdout);
+    int saved = dup(fileno(stdout));
+    FILE *capture = tmpfile();
+    dup2(fileno(capture), fileno(stdout));
+    fs.listFiles();
+    fflush(stdout);
+    dup2(saved, fileno(stdout));
+    close(saved);
+
+    std::string text;
+    rewind(capture);
+    for (int c = fgetc(capture); c != EOF; c = fgetc(capture))
+        text += (char)c;
+    fclose(capture);
+    return text;
+}
+
+static bool listed(const std::string &text, const char *name)
+{
+    std::string word = std::string(" ") + name;
+    for (size_t at = text.find(word); at != std::string::npos; at = text.find(word, at + 1))
+    {
+        size_t end = at + word.size();
+        if (end == text.size() || text[end] == ' ' || text[end] == '\n')
+            return true;
+    }
+    return false;
+}
+
+static bool noneOld(MjolnFileSystem &fs)
+{
+    std::string text = listing(fs);
+    for (uint8_t i = 0; i < oldCount; i++)
+        if (fs.open(oldNames[i]) || listed(text, oldNames[i]))
+            return false;
+    return true;
+}
+
+int main()
+{
+    AT24CEmulator chip(AT24C32);
+    hostAttach(chip);
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(fs.format() && fs.mount());
+        for (uint8_t i = 0; i < oldCount; i++)
+            HOST_CHECK(fs.writeFile(oldNames[i], hostPayload(100, i).c_str()));
+        std::string text = listing(fs);
+        for (uint8_t i = 0; i < oldCount; i++)
+            HOST_CHECK(listed(text, oldNames[i]));
+    }
+
+    std::string image((const char *)chip.memory(), chip.size());
+    chip.resetStats();
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(fs.format());
+    }
+    fprintf(stderr, "FormatTest: format() programmed %lu bytes\n", (unsigned long)chip.stats().bytesProgrammed);
+    HOST_CHECK(chip.stats().bytesProgrammed <= MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE + MJOLN_FILE_SYSTEM_SUPERBLOCK_SIZE);
+    HOST_CHECK(pagesDiffering(chip, image) <= 2);
+
+    std::string fresh = hostPayload(60, 100);
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(fs.mount() && fs.getBytesUsed() == 0 && noneOld(fs));
+        // The new entry goes into the first FAT chunk, next to the old entries still stored there.
+        HOST_CHECK(fs.writeFile("n", fresh.c_str()));
+        HOST_CHECK(noneOld(fs));
+    }
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        std::string contents;
+        HOST_CHECK(fs.mount() && noneOld(fs) && hostReadFile(fs, "n", contents) && contents == fresh);
+        HOST_CHECK(listed(listing(fs), "n") && fs.getBytesUsed() == fresh.size());
+        while (fs.fsckStep())
+            ;
+        FS_FsckReport report = fs.getFsckReport();
+        HOST_CHECK(report.complete && report.repaired == 0 && report.dropped == 0 && report.orphanLinks == 0 && !report.countersFixed);
+    }
+
+    uint32_t inUse = pagesInUse(chip);
+    chip.resetStats();
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(fs.cleanFormat(onProgress));
+    }
+    fprintf(stderr, "FormatTest: cleanFormat() programmed %lu bytes, %lu pages were in use\n", (unsigned long)chip.stats().bytesProgrammed,
+            (unsigned long)inUse);
+    HOST_CHECK(inUse > 0 && chip.stats().bytesProgrammed == inUse * chip.pageSize() && pagesInUse(chip) == 0);
+    HOST_CHECK(lastProgress == chip.size());
+
+    chip.resetStats();
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(!fs.mount() && fs.cleanFormat());
+        HOST_CHECK(chip.stats().bytesProgrammed == 0);
+        HOST_CHECK(fs.format() && fs.mount() && fs.getBytesUsed() == 0 && noneOld(fs));
+    }
+    return hostTestResult("FormatTest");
+}
@@ -0,0 +1,199 @@
+#include <map>
+#include <string.h>
+#include "HostTest.h"
+
+// Damages FAT entries in the emulator's memory, runs fsck() and checks what it reports, the FAT it leaves and
+// the files that are still there: a copy restored from its twin, an entry dropped, a looping and a broken
+// link chain cut, orphaned links freed and the bytes in use corrected. A second check must then be clean.
+
+typedef std::map<std::string, std::string> Files;
+
+static const uint16_t entriesPerChunk = 4; // Three 32-byte pages of 24-byte entries on an AT24C32
+static const uint16_t chunkCopyBytes = 3 * 32;
+static const uint16_t entryCount = 8; // Two chunks, enough for the workload
+
+// Where an entry lies, as MjolnFileSystem::fatEntryAddress() places it on an AT24C32.
+static uint32_t entryAddress(AT24CEmulator &chip, uint16_t index, uint8_t copy)
+{
+    uint16_t chunk = (index - 1) / entriesPerChunk;
+    uint32_t chunkStart = chip.size() - (uint32_t)(chunk + 1) * MJOLN_FILE_SYSTEM_FAT_COUNT * chunkCopyBytes;
+    return chunkStart + copy * chunkCopyBytes + ((index - 1) % entriesPerChunk) * MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE;
+}
+
+// Reads an entry whose copies must agree.
+static FS_FATEntry readEntry(AT24CEmulator &chip, uint16_t index)
+{
+    const uint8_t *first = chip.memory() + entryAddress(chip, index, 0);
+    const uint8_t *second = chip.memory() + entryAddress(chip, index, 1);
+    HOST_CHECK(fatEntryIntact(first) && memcmp(first, second, MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE) == 0);
+    return toFATEntry(first);
+}
+
+// Writes an entry that is intact but wrong into both copies.
+static void forgeEntry(AT24CEmulator &chip, uint16_t index, const FS_FATEntry &entry)
+{
+    for (uint8_t copy = 0; copy < MJOLN_FILE_SYSTEM_FAT_COUNT; copy++)
+        fatToBytes(entry, chip.memory() + entryAddress(chip, index, copy));
+}
+
+// Flips a bit of the start address, so the copy fails its CRC.
+static void damageCopy(AT24CEmulator &chip, uint16_t index, uint8_t copy)
+{
+    chip.memory()[entryAddress(chip, index, copy)] ^= 0x01;
+}
+
+static uint16_t findEntry(AT24CEmulator &chip, const char *name, uint8_t status, uint16_t after = 0)
+{
+    for (uint16_t i = after + 1; i <= entryCount; i++)
+    {
+        const uint8_t *bytes = chip.memory() + entryAddress(chip, i, 0);
+        FS_FATEntry entry = toFATEntry(bytes);
+        if (fatEntryIntact(bytes) && entry.status == status && strcmp(entry.filename, name) == 0)
+            return i;
+    }
+    return MJOLN_FILE_NOT_FOUND;
+}
+
+static bool holds(MjolnFileSystem &fs, const Files &files)
+{
+    static const char *names[] = {"a", "b", "log", "p1", "p2", "z"};
+    for (uint8_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        std::string contents;
+        bool exists = hostReadFile(fs, names[i], contents);
+        Files::const_iterator expected = files.find(names[i]);
+        if (exists != (expected != files.end()) || (exists && contents != expected->second))
+            return false;
+    }
+    return true;
+}
+
+// A log of three extents, each too long to move on the next append, kept apart by the small files between them.
+static void build(AT24CEmulator &chip, Files &files)
+{
+    chip.erase();
+    MjolnFileSystem fs(AT24C32);
+    fs.showLogs(false);
+    HOST_CHECK(fs.format() && fs.mount());
+    files.clear();
+    files["a"] = hostPayload(50, 1);
+    files["b"] = hostPayload(60, 2);
+    files["log"] = hostPayload(150, 3);
+    files["p1"] = hostPayload(20, 4);
+    files["p2"] = hostPayload(20, 5);
+    files["z"] = hostPayload(20, 6);
+    std::string second = hostPayload(150, 7), third = hostPayload(150, 8);
+    HOST_CHECK(fs.writeFile("a", files["a"].c_str()) && fs.writeFile("b", files["b"].c_str()));
+    HOST_CHECK(fs.writeFile("log", files["log"].c_str()) && fs.writeFile("p1", files["p1"].c_str()));
+    HOST_CHECK(fs.appendFile("log", second.c_str()) && fs.writeFile("p2", files["p2"].c_str()));
+    HOST_CHECK(fs.appendFile("log", third.c_str()));
+    files["log"] += second + third;
+    // Only the entry of the last update is missing from the older copy.
+    HOST_CHECK(fs.writeFile("z", files["z"].c_str()));
+}
+
+// Runs fsck() on a fresh mount, then updates z so every other entry is the same in both copies again.
+static FS_FsckReport repair(const Files &files)
+{
+    MjolnFileSystem fs(AT24C32);
+    fs.showLogs(false);
+    HOST_CHECK(fs.mount());
+    for (uint32_t calls = 0; fs.fsck(100) && calls < 1000; calls++)
+        ;
+    FS_FsckReport report = fs.getFsckReport();
+    HOST_CHECK(report.complete && !fs.needsFsck() && holds(fs, files));
+    HOST_CHECK(fs.updateFile("z", files.find("z")->second.c_str()));
+
+    MjolnFileSystem remounted(AT24C32);
+    remounted.showLogs(false);
+    HOST_CHECK(remounted.mount() && !remounted.needsFsck() && holds(remounted, files));
+    while (remounted.fsckStep())
+        ;
+    FS_FsckReport again = remounted.getFsckReport();
+    HOST_CHECK(again.complete && again.repaired == 0 && again.dropped == 0 && again.brokenChains == 0 &&
+               again.orphanLinks == 0 && again.overlaps == 0 && !again.countersFixed);
+    return report;
+}
+
+static void report(const char *name, const FS_FsckReport &r)
+{
+    fprintf(stderr, "FsckTest: %s: %u repaired, %u dropped, %u chains cut, %u orphans freed, counters %s\n", name, r.repaired,
+            r.dropped, r.brokenChains, r.orphanLinks, r.countersFixed ? "fixed" : "right");
+}
+
+int main()
+{
+    AT24CEmulator chip(AT24C32);
+    hostAttach(chip);
+    Files files;
+
+    // Either copy of an entry is rewritten from the other.
+    for (uint8_t copy = 0; copy < MJOLN_FILE_SYSTEM_FAT_COUNT; copy++)
+    {
+        build(chip, files);
+        uint16_t a = findEntry(chip, "a", MJOLN_FILE_SYSTEM_FAT_AVAILABLE);
+        HOST_CHECK(a != MJOLN_FILE_NOT_FOUND);
+        damageCopy(chip, a, copy);
+        FS_FsckReport r = repair(files);
+        report(copy ? "second copy of a damaged" : "first copy of a damaged", r);
+        HOST_CHECK(r.repaired == 1 && r.dropped == 0 && r.brokenChains == 0 && r.orphanLinks == 0 && !r.countersFixed);
+        HOST_CHECK(readEntry(chip, a).status == MJOLN_FILE_SYSTEM_FAT_AVAILABLE);
+    }
+
+    // An entry damaged in both copies is dropped, and its bytes are no longer counted.
+    build(chip, files);
+    uint16_t b = findEntry(chip, "b", MJOLN_FILE_SYSTEM_FAT_AVAILABLE);
+    HOST_CHECK(b != MJOLN_FILE_NOT_FOUND);
+    damageCopy(chip, b, 0);
+    damageCopy(chip, b, 1);
+    files.erase("b");
+    FS_FsckReport r = repair(files);
+    report("both copies of b damaged", r);
+    HOST_CHECK(r.dropped == 1 && r.repaired == 0 && r.brokenChains == 0 && r.orphanLinks == 0 && r.countersFixed);
+    HOST_CHECK(readEntry(chip, b).status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE);
+
+    // A chain that loops back is cut where it does; the file keeps every extent.
+    build(chip, files);
+    uint16_t head = findEntry(chip, "log", MJOLN_FILE_SYSTEM_FAT_AVAILABLE);
+    uint16_t second = readEntry(chip, head).link;
+    uint16_t third = readEntry(chip, second).link;
+    HOST_CHECK(second != MJOLN_FILE_NOT_FOUND && third != MJOLN_FILE_NOT_FOUND);
+    FS_FATEntry entry = readEntry(chip, third);
+    entry.link = second;
+    forgeEntry(chip, third, entry);
+    r = repair(files);
+    report("chain of log loops", r);
+    HOST_CHECK(r.brokenChains == 1 && r.repaired == 0 && r.dropped == 0 && r.orphanLinks == 0 && !r.countersFixed);
+    HOST_CHECK(readEntry(chip, third).link == MJOLN_FILE_NOT_FOUND);
+
+    // A chain leading into another file is cut there, and the extent behind the cut becomes an orphan.
+    build(chip, files);
+    head = findEntry(chip, "log", MJOLN_FILE_SYSTEM_FAT_AVAILABLE);
+    second = readEntry(chip, head).link;
+    third = readEntry(chip, second).link;
+    entry = readEntry(chip, second);
+    entry.link = findEntry(chip, "a", MJOLN_FILE_SYSTEM_FAT_AVAILABLE);
+    forgeEntry(chip, second, entry);
+    files["log"].resize(300);
+    r = repair(files);
+    report("chain of log leads into a", r);
+    HOST_CHECK(r.brokenChains == 1 && r.orphanLinks == 1 && r.repaired == 0 && r.dropped == 0 && r.countersFixed);
+    HOST_CHECK(readEntry(chip, second).link == MJOLN_FILE_NOT_FOUND);
+    HOST_CHECK(readEntry(chip, third).status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE);
+
+    // Links no file reaches any more are freed.
+    build(chip, files);
+    head = findEntry(chip, "log", MJOLN_FILE_SYSTEM_FAT_AVAILABLE);
+    second = readEntry(chip, head).link;
+    third = readEntry(chip, second).link;
+    entry = readEntry(chip, head);
+    entry.link = MJOLN_FILE_NOT_FOUND;
+    forgeEntry(chip, head, entry);
+    files["log"].resize(150);
+    r = repair(files);
+    report("head of log lost its chain", r);
+    HOST_CHECK(r.orphanLinks == 2 && r.brokenChains == 0 && r.repaired == 0 && r.dropped == 0 && r.countersFixed);
+    HOST_CHECK(readEntry(chip, second).status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE &&
+               readEntry(chip, third).status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE);
+    return hostTestResult("FsckTest");
+}
@@ -0,0 +1,118 @@
+#include <vector>
+#include "HostTest.h"
+
+// Runs the same workload through MjolnFS<Model, Chips>, whose device layer uses the geometry as constants,
+// and through MjolnFileSystem, which reads it from members. Both must make the same I2C transfers, and
+// each must read the volume the other one wrote.
+
+static const char *names[] = {"a", "b", "c", "log"};
+static const uint8_t nameCount = sizeof(names) / sizeof(names[0]);
+
+struct Bus
+{
+    std::vector<AT24CEmulator *> chips;
+
+    Bus(AT24CXType type, uint8_t count)
+    {
+        Wire.detachAll();
+        for (uint8_t i = 0; i < count; i++)
+        {
+            chips.push_back(new AT24CEmulator(type, MJOLN_STORAGE_DEVICE_ADDRESS + i * chipAddressCount(type)));
+            Wire.attach(chips.back());
+        }
+    }
+
+    ~Bus()
+    {
+        Wire.detachAll();
+        for (size_t i = 0; i < chips.size(); i++)
+            delete chips[i];
+    }
+};
+
+// Writes, appends, updates and deletes, both blocking and through the write queue; returns the transfers made.
+static uint32_t workload(MjolnFileSystem &fs, std::vector<std::string> &files)
+{
+    fs.showLogs(false);
+    fs.resetStats();
+    HOST_CHECK(fs.format() && fs.mount());
+    files.assign(nameCount, "");
+
+    files[0] = hostPayload(300, 1);
+    files[1] = hostPayload(45, 2);
+    files[3] = hostPayload(20, 3);
+    HOST_CHECK(fs.writeFile("a", files[0].c_str()) && fs.writeFile("b", files[1].c_str()) && fs.writeFile("log", files[3].c_str()));
+    for (uint32_t n = 0; n < 6; n++)
+    {
+        std::string record = hostPayload(37, 10 + n);
+        HOST_CHECK(fs.appendFile("log", record.c_str()));
+        files[3] += record;
+    }
+    files[0] = hostPayload(280, 4);
+    HOST_CHECK(fs.updateFile("a", files[0].c_str()));
+    HOST_CHECK(fs.deleteFile("b"));
+    files[1].clear();
+
+    HOST_CHECK(fs.enableAsyncWrites());
+    files[2] = hostPayload(150, 5);
+    HOST_CHECK(fs.writeFile("c", files[2].c_str()));
+    std::string record = hostPayload(37, 20);
+    HOST_CHECK(fs.appendFile("log", record.c_str()));
+    files[3] += record;
+    while (fs.poll())
+        delay(1);
+    fs.disableAsyncWrites();
+    return fs.getStats().i2cTransactions;
+}
+
+static bool holds(MjolnFileSystem &fs, const std::vector<std::string> &files)
+{
+    for (uint8_t i = 0; i < nameCount; i++)
+    {
+        std::string contents;
+        bool exists = hostReadFile(fs, names[i], contents);
+        if (exists != !files[i].empty() || (exists && contents != files[i]))
+            return false;
+    }
+    return true;
+}
+
+template <AT24CXType Model, uint8_t Chips>
+static void compare()
+{
+    std::vector<std::string> fixedFiles, runtimeFiles;
+    uint32_t fixedTransfers, runtimeTransfers;
+    {
+        Bus bus(Model, Chips);
+        MjolnFS<Model, Chips> fixed;
+        fixedTransfers = workload(fixed, fixedFiles);
+        HOST_CHECK(holds(fixed, fixedFiles));
+
+        MjolnFileSystem runtime(Model, Chips);
+        runtime.showLogs(false);
+        HOST_CHECK(runtime.mount() && holds(runtime, fixedFiles));
+    }
+    {
+        Bus bus(Model, Chips);
+        MjolnFileSystem runtime(Model, Chips);
+        runtimeTransfers = workload(runtime, runtimeFiles);
+
+        MjolnFS<Model, Chips> fixed;
+        fixed.showLogs(false);
+        HOST_CHECK(fixed.mount() && holds(fixed, runtimeFiles));
+    }
+    fprintf(stderr, "GeometryTest: AT24C%02u x%u: %lu transfers fixed, %lu at run time\n", (unsigned)(chipSize(Model) / 128), Chips,
+            (unsigned long)fixedTransfers, (unsigned long)runtimeTransfers);
+    HOST_CHECK(fixedTransfers == runtimeTransfers);
+}
+
+int main()
+{
+    compare<AT24C16, 1>();
+    compare<AT24C04, 4>();
+    compare<AT24C32, 1>();
+    compare<AT24C32, 2>();
+    compare<AT24C256, 1>();
+    compare<AT24C512, 3>();
+    return hostTestResult("GeometryTest");
+}
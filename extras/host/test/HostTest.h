@@ -0,0 +1,73 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#ifdef __cplusplus
+
+#include <stdio.h>
+#include <string>
+#include "Arduino.h"
+#include "Wire.h"
+#include "AT24CEmulator.h"
+
+// Failed checks of the running test program; every test is a program of its own.
+static int hostTestFailures = 0;
+
+// Reports a failed check with its location and keeps going, so one run shows every broken case.
+#define HOST_CHECK(condition)                                                         \
+    do                                                                                \
+    {                                                                                 \
+        if (!(condition))                                                             \
+        {                                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            hostTestFailures++;                                                       \
+        }                                                                             \
+    } while (0)
+
+/**
+ * @brief Attaches a blank EEPROM as the only device on the simulated bus.
+ */
+inline void hostAttach(AT24CEmulator &chip)
+{
+    Wire.detachAll();
+    Wire.attach(&chip);
+}
+
+/**
+ * @brief Reads a whole file into a string.
+ * @return false if the file does not exist.
+ */
+inline bool hostReadFile(MjolnFileSystem &fs, const char *name, std::string &contents)
+{
+    MjolnFile file = fs.open(name);
+    if (!file)
+        return false;
+    contents.assign(file.size(), '\0');
+    return file.size() == 0 || file.read(&contents[0], file.size()) == file.size();
+}
+
+/**
+ * @brief Deterministic printable contents, so every run programs the same bytes.
+ */
+inline std::string hostPayload(uint32_t length, uint32_t seed)
+{
+    std::string data(length, ' ');
+    uint32_t state = seed * 2654435761u + 1;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        state = state * 1103515245u + 12345;
+        data[i] = 'a' + (state >> 16) % 26;
+    }
+    return data;
+}
+
+/**
+ * @brief Prints the summary line and returns the exit code of the test program.
+ */
+inline int hostTestResult(const char *name)
+{
+    fprintf(stderr, "%s: %s (%d failed checks)\n", name, hostTestFailures ? "FAILED" : "passed", hostTestFailures);
+    return hostTestFailures ? 1 : 0;
+}
+
+#endif // __cplusplus
+#endif // HOST_TEST_H
@@ -0,0 +1,76 @@
+#include "HostTest.h"
+
+// Fills the FAT with as many files as a volume can hold and checks that every lookup is answered by the
+// filename index, so neither a hit nor a miss scans the FAT.
+
+static void fileName(char *name, uint16_t n)
+{
+    snprintf(name, MJOLN_FILE_NAME_MAX_LENGTH, "f%u", n);
+}
+
+// Reads every file still expected; each lookup should cost the one FAT read that confirms the hash match.
+static void checkLookups(MjolnFileSystem &fs, uint16_t files, uint16_t deletedBelow)
+{
+    fs.resetStats();
+    uint32_t lookups = 0;
+    for (uint16_t n = deletedBelow; n < files; n++)
+    {
+        char name[MJOLN_FILE_NAME_MAX_LENGTH];
+        fileName(name, n);
+        std::string contents;
+        HOST_CHECK(hostReadFile(fs, name, contents) && contents == hostPayload(16, n));
+        lookups++;
+    }
+    FS_Stats stats = fs.getStats();
+    HOST_CHECK(stats.lookupHits == lookups && stats.lookupMisses == 0);
+
+    // Each open also walks the chain once; no more than that may be read.
+    HOST_CHECK(stats.fatReads <= 2 * lookups);
+
+    // A name that does not exist is settled by the index alone, not by reading every entry.
+    fs.resetStats();
+    std::string contents;
+    HOST_CHECK(!hostReadFile(fs, "missing", contents));
+    HOST_CHECK(fs.getStats().lookupMisses == 1 && fs.getStats().fatReads < 4);
+}
+
+int main()
+{
+    AT24CEmulator chip(AT24C256);
+    hostAttach(chip);
+    MjolnFileSystem fs(AT24C256);
+    fs.showLogs(false);
+    HOST_CHECK(fs.format() && fs.mount());
+
+    const uint16_t files = MJOLN_FILE_SYSTEM_MAX_FILES;
+    for (uint16_t n = 0; n < files; n++)
+    {
+        char name[MJOLN_FILE_NAME_MAX_LENGTH];
+        fileName(name, n);
+        HOST_CHECK(fs.writeFile(name, hostPayload(16, n).c_str()));
+    }
+    // The FAT is full, so one more file is refused.
+    HOST_CHECK(!fs.writeFile("extra", "x"));
+    checkLookups(fs, files, 0);
+
+    MjolnFileSystem remounted(AT24C256);
+    remounted.showLogs(false);
+    HOST_CHECK(remounted.mount());
+    checkLookups(remounted, files, 0);
+
+    // Deleted files leave tombstones behind; the files written into their entries are still found.
+    for (uint16_t n = 0; n < files / 2; n++)
+    {
+        char name[MJOLN_FILE_NAME_MAX_LENGTH];
+        fileName(name, n);
+        HOST_CHECK(remounted.deleteFile(name));
+    }
+    for (uint16_t n = files; n < files + files / 2; n++)
+    {
+        char name[MJOLN_FILE_NAME_MAX_LENGTH];
+        fileName(name, n);
+        HOST_CHECK(remounted.writeFile(name, hostPayload(16, n).c_str()));
+    }
+    checkLookups(remounted, files + files / 2, files / 2);
+    return hostTestResult("IndexTest");
+}
@@ -0,0 +1,119 @@
+#include <vector>
+#include "HostTest.h"
+
+// Writes compressed files through the public API and reads them back with readFile() and a handle, both
+// before and after a remount, for the inputs the packer handles differently.
+
+/**
+ * @brief Bytes in 1..255 with no repeats the packer could find, so every block is stored raw.
+ */
+static std::string incompressible(uint32_t length, uint32_t seed)
+{
+    std::string data(length, ' ');
+    uint32_t state = seed * 2654435761u + 1;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        state = state * 1103515245u + 12345;
+        data[i] = (char)(1 + (state >> 16) % 255);
+    }
+    return data;
+}
+
+// Bytes a file of this length takes when no block shrinks.
+static uint32_t rawBlocks(uint32_t length)
+{
+    return length + (length + MJOLN_COMPRESS_BLOCK_BYTES - 1) / MJOLN_COMPRESS_BLOCK_BYTES * MJOLN_COMPRESS_BLOCK_HEADER;
+}
+
+static bool readsBack(MjolnFileSystem &fs, const char *name, const std::string &expected)
+{
+    std::vector<char> buffer(expected.size() + 1, '\0');
+    if (fs.readFile(name, buffer.data()) != expected.size() || std::string(buffer.data(), expected.size()) != expected)
+        return false;
+    std::string contents;
+    return hostReadFile(fs, name, contents) && contents == expected;
+}
+
+enum Packing
+{
+    PACKS_EMPTY,
+    PACKS_SMALL,
+    PACKS_RAW,
+    PACKS_ANY
+};
+
+struct Case
+{
+    const char *name;
+    std::string data;
+    Packing packing;
+};
+
+int main()
+{
+    AT24CEmulator chip(AT24C256);
+    hostAttach(chip);
+    MjolnFileSystem fs(AT24C256);
+    fs.showLogs(false);
+    HOST_CHECK(fs.format() && fs.mount());
+
+    std::vector<Case> cases;
+    cases.push_back({"empty", "", PACKS_EMPTY});
+    cases.push_back({"one", "x", PACKS_RAW});
+    cases.push_back({"same", std::string(300, 'z'), PACKS_SMALL});
+    cases.push_back({"sameblocks", std::string(3 * MJOLN_COMPRESS_BLOCK_BYTES + 17, 'q'), PACKS_SMALL});
+    cases.push_back({"random", incompressible(300, 1), PACKS_RAW});
+    cases.push_back({"randomblocks", incompressible(2 * MJOLN_COMPRESS_BLOCK_BYTES + 5, 2), PACKS_RAW});
+    cases.push_back({"text", hostPayload(40, 3) + hostPayload(40, 3) + hostPayload(700, 4) + hostPayload(40, 3), PACKS_ANY});
+
+    for (size_t i = 0; i < cases.size(); i++)
+    {
+        uint32_t before = fs.getBytesUsed();
+        HOST_CHECK(fs.writeFile(cases[i].name, cases[i].data.c_str(), true));
+        uint32_t stored = fs.getBytesUsed() - before;
+        HOST_CHECK(readsBack(fs, cases[i].name, cases[i].data));
+
+        // Incompressible blocks are kept raw behind their header instead of growing.
+        if (cases[i].packing == PACKS_EMPTY)
+            HOST_CHECK(stored == 0);
+        else if (cases[i].packing == PACKS_SMALL)
+            HOST_CHECK(stored < cases[i].data.size() / 8);
+        else if (cases[i].packing == PACKS_RAW)
+            HOST_CHECK(stored == rawBlocks(cases[i].data.size()));
+        else
+            HOST_CHECK(stored <= rawBlocks(cases[i].data.size()));
+    }
+
+    // Appends are packed on their own and decode as one file with the blocks before them.
+    std::string log = hostPayload(100, 5);
+    HOST_CHECK(fs.writeFile("log", log.c_str(), true));
+    const std::string pieces[] = {incompressible(130, 6), std::string(600, 'a'), "", hostPayload(24, 7), incompressible(520, 8)};
+    for (size_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++)
+    {
+        HOST_CHECK(fs.appendFile("log", pieces[i].c_str()));
+        log += pieces[i];
+        HOST_CHECK(readsBack(fs, "log", log));
+    }
+
+    // Appending to a missing file creates it compressed.
+    HOST_CHECK(fs.appendFile("created", std::string(200, 'c').c_str(), true));
+    HOST_CHECK(readsBack(fs, "created", std::string(200, 'c')));
+
+    std::string updated = incompressible(90, 9) + std::string(400, 'u');
+    HOST_CHECK(fs.updateFile("same", updated.c_str()));
+    HOST_CHECK(readsBack(fs, "same", updated));
+
+    MjolnFileSystem remounted(AT24C256);
+    remounted.showLogs(false);
+    HOST_CHECK(remounted.mount());
+    for (size_t i = 0; i < cases.size(); i++)
+        HOST_CHECK(readsBack(remounted, cases[i].name, strcmp(cases[i].name, "same") == 0 ? updated : cases[i].data));
+    HOST_CHECK(readsBack(remounted, "log", log));
+    HOST_CHECK(readsBack(remounted, "created", std::string(200, 'c')));
+
+    while (remounted.fsckStep())
+        ;
+    FS_FsckReport report = remounted.getFsckReport();
+    HOST_CHECK(report.complete && report.dropped == 0 && report.brokenChains == 0 && !report.countersFixed);
+    return hostTestResult("LzTest");
+}
@@ -0,0 +1,59 @@
+#include <string.h>
+#include "HostTest.h"
+
+// Fails the EEPROM read of a file's data and checks that readFile() reports only the bytes it read,
+// rather than the file's length over a buffer that was never filled.
+
+// Refuses to be read from one address, as a chip that drops off the bus mid-transfer would.
+class FailingChip : public AT24CEmulator
+{
+public:
+    uint32_t failAt = UINT32_MAX;
+
+    FailingChip() : AT24CEmulator(AT24C32) {}
+
+    void onWrite(uint8_t address, const uint8_t *data, size_t length) override
+    {
+        if (length >= 2)
+            _pointer = ((uint32_t)data[0] << 8) | data[1];
+        AT24CEmulator::onWrite(address, data, length);
+    }
+
+    bool onAddress(uint8_t address, bool read) override
+    {
+        if (read && _pointer == failAt)
+            return false;
+        return AT24CEmulator::onAddress(address, read);
+    }
+
+private:
+    uint32_t _pointer = 0;
+};
+
+int main()
+{
+    FailingChip chip;
+    hostAttach(chip);
+    MjolnFileSystem fs(AT24C32);
+    fs.showLogs(false);
+    HOST_CHECK(fs.format() && fs.mount());
+
+    std::string payload = hostPayload(300, 1);
+    HOST_CHECK(fs.writeFile("a", payload.c_str()));
+    std::string image((const char *)chip.memory(), chip.size());
+    size_t data = image.find(payload);
+    HOST_CHECK(data != std::string::npos);
+
+    char buffer[301];
+    memset(buffer, 'x', sizeof(buffer));
+    HOST_CHECK(fs.readFile("a", buffer) == payload.size() && payload == buffer);
+
+    chip.failAt = data;
+    memset(buffer, 'x', sizeof(buffer));
+    uint32_t length = fs.readFile("a", buffer);
+    HOST_CHECK(length < payload.size() && buffer[length] == '\0');
+
+    chip.failAt = UINT32_MAX;
+    HOST_CHECK(fs.readFile("a", buffer) == payload.size() && payload == buffer);
+    return hostTestResult("ReadTest");
+}
@@ -0,0 +1,90 @@
+#include <string.h>
+#include <vector>
+#include "HostTest.h"
+
+// Writes records of a record file whose records straddle page boundaries and checks each round trip, that
+// the neighbours of a written record keep their bytes, that indices past the end and whole-file writes are
+// refused, and that the records survive a remount and a compaction that moves the file.
+
+static const uint16_t recordSize = 12; // Not a divisor of the 32-byte page, so records cross pages
+static const uint16_t recordCount = 20;
+
+typedef std::vector<std::string> Records;
+
+static std::string recordFor(uint32_t seed)
+{
+    return hostPayload(recordSize, seed);
+}
+
+static bool holds(MjolnFileSystem &fs, const Records &records)
+{
+    if (fs.getRecordCount("rec") != recordCount)
+        return false;
+    for (uint16_t i = 0; i < recordCount; i++)
+    {
+        char buffer[recordSize];
+        if (!fs.readRecord("rec", i, buffer) || std::string(buffer, recordSize) != records[i])
+            return false;
+    }
+    return true;
+}
+
+static bool write(MjolnFileSystem &fs, Records &records, uint16_t index, uint32_t seed)
+{
+    records[index] = recordFor(seed);
+    return fs.writeRecord("rec", index, records[index].data());
+}
+
+int main()
+{
+    AT24CEmulator chip(AT24C32);
+    hostAttach(chip);
+    Records records(recordCount, std::string(recordSize, '\xFF'));
+    std::string pad = hostPayload(200, 1);
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(fs.format() && fs.mount());
+
+        // The file below the records is deleted later, leaving a hole for compaction to move them into.
+        HOST_CHECK(fs.writeFile("pad", pad.c_str()));
+        HOST_CHECK(fs.createRecordFile("rec", recordSize, recordCount));
+        HOST_CHECK(!fs.createRecordFile("rec", recordSize, recordCount) && !fs.createRecordFile("none", 0, recordCount));
+        HOST_CHECK(fs.getRecordCount("rec") == recordCount && fs.getRecordCount("pad") == 0);
+        HOST_CHECK(holds(fs, records));
+
+        HOST_CHECK(write(fs, records, 3, 3));
+        char buffer[recordSize];
+        HOST_CHECK(fs.readRecord("rec", 3, buffer) && std::string(buffer, recordSize) == records[3]);
+
+        // Rewriting a record between two written ones leaves both as they were.
+        HOST_CHECK(write(fs, records, 2, 2) && write(fs, records, 4, 4));
+        HOST_CHECK(write(fs, records, 3, 33));
+        HOST_CHECK(holds(fs, records));
+        HOST_CHECK(write(fs, records, 0, 10) && write(fs, records, recordCount - 1, 19));
+        HOST_CHECK(holds(fs, records));
+
+        HOST_CHECK(!fs.readRecord("rec", recordCount, buffer) && !fs.writeRecord("rec", recordCount, buffer));
+        HOST_CHECK(!fs.readRecord("pad", 0, buffer) && !fs.writeRecord("pad", 0, buffer));
+        HOST_CHECK(!fs.readRecord("missing", 0, buffer));
+
+        HOST_CHECK(!fs.updateFile("rec", "replaced") && !fs.appendFile("rec", "appended"));
+        HOST_CHECK(holds(fs, records));
+    }
+    {
+        MjolnFileSystem fs(AT24C32);
+        fs.showLogs(false);
+        HOST_CHECK(fs.mount() && holds(fs, records));
+
+        HOST_CHECK(fs.deleteFile("pad"));
+        uint32_t steps = 0;
+        while (fs.compactStep())
+            steps++;
+        HOST_CHECK(steps > 0 && holds(fs, records));
+        HOST_CHECK(write(fs, records, 7, 7) && holds(fs, records));
+    }
+    MjolnFileSystem remounted(AT24C32);
+    remounted.showLogs(false);
+    HOST_CHECK(remounted.mount() && holds(remounted, records));
+    return hostTestResult("RecordTest");
+}
@@ -0,0 +1,188 @@
+#include "MjolnFS.h"
+
+bool MjolnFileSystem::compact(uint32_t budgetMs)
+{
+    uint32_t start = millis();
+    while (compactStep())
+    {
+        if (millis() - start >= budgetMs)
+            return true;
+        yield();
+    }
+    return false;
+}
+
+bool MjolnFileSystem::compactStep()
+{
+    if (!isFileSystemInitialized())
+        return false;
+    discardFATChanges();
+
+    if (_compaction.fatIndex == MJOLN_FILE_NOT_FOUND && !startCompactionJob())
+        return false;
+
+    // A merge copies the chain extent by extent; zero-length extents are stepped over.
+    for (uint16_t hops = 0; _compaction.srcRemaining == 0 && _compaction.copied < _compaction.length; hops++)
+    {
+        uint16_t next = readFATEntry(_compaction.srcIndex).link;
+        FS_FATEntry entry = readFATEntry(next);
+        if (next == MJOLN_FILE_NOT_FOUND || entry.status != MJOLN_FILE_SYSTEM_FAT_LINK || hops > _fatEntryCount)
+        {
+            MJOLN_LOG_WARN("Broken link chain.\n");
+            abortCompaction();
+            return false;
+        }
+        _compaction.srcIndex = next;
+        _compaction.srcAddr = entry.startAddr[0] | (entry.startAddr[1] << 8) | (entry.startAddr[2] << 16);
+        _compaction.srcRemaining = entry.size[0] | (entry.size[1] << 8) | (entry.size[2] << 16);
+    }
+
+    uint8_t buffer[MJOLN_COMPACT_STEP_BYTES];
+    uint16_t chunk = min(_compaction.srcRemaining, (uint32_t)sizeof(buffer));
+    if (chunk > 0)
+    {
+        if (!storageRead(_compaction.srcAddr, buffer, chunk) || !storageWrite(_compaction.destAddr + _compaction.copied, buffer, chunk))
+        {
+            MJOLN_LOG_ERROR("Failed to move file data.\n");
+            abortCompaction();
+            return false;
+        }
+        _compaction.srcAddr += chunk;
+        _compaction.srcRemaining -= chunk;
+        _compaction.copied += chunk;
+    }
+
+    if (_compaction.copied == _compaction.length)
+        return commitCompactionJob();
+    return true;
+}
+
+bool MjolnFileSystem::startCompactionJob()
+{
+    // Collapsing link chains comes first: it turns fragmented reads back into one sequential read.
+    for (uint16_t i = 1; i <= _fatEntryCount; i++)
+    {
+        FS_FATEntry entry = readFATEntry(i);
+        if (entry.status != MJOLN_FILE_SYSTEM_FAT_AVAILABLE || entry.link == MJOLN_FILE_NOT_FOUND)
+            continue;
+
+        MjolnFile file = open(entry.filename);
+        if (!file || file._headIndex != i)
+            continue;
+
+        // Compressed files are moved as stored; their blocks stay valid wherever they are.
+        uint32_t destAddr = _allocator.allocate(file._storedSize);
+        if (destAddr == MJOLN_ALLOCATION_FAILED)
+            continue;
+
+        _compaction.fatIndex = i;
+        _compaction.merge = true;
+        _compaction.destAddr = destAddr;
+        _compaction.length = file._storedSize;
+        _compaction.copied = 0;
+        _compaction.srcIndex = i;
+        _compaction.srcAddr = entry.startAddr[0] | (entry.startAddr[1] << 8) | (entry.startAddr[2] << 16);
+        _compaction.srcRemaining = entry.size[0] | (entry.size[1] << 8) | (entry.size[2] << 16);
+        return true;
+    }
+
+    // Otherwise the extent right above the lowest hole moves down into it, which carries the hole
+    // upwards until it merges with the free space at the top.
+    uint8_t bestHole = _allocator.holeCount();
+    uint16_t bestIndex = MJOLN_FILE_NOT_FOUND;
+    FS_FATEntry best;
+    for (uint16_t i = 1; i <= _fatEntryCount; i++)
+    {
+        FS_FATEntry entry = readFATEntry(i);
+        uint32_t size = entry.size[0] | (entry.size[1] << 8) | (entry.size[2] << 16);
+        if (entry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE || size == 0)
+            continue;
+
+        // An extent that fits neither the hole nor the space at the top cannot move yet; a higher one may.
+        uint32_t startAddr = entry.startAddr[0] | (entry.startAddr[1] << 8) | (entry.startAddr[2] << 16);
+        for (uint8_t h = 0; h < bestHole; h++)
+        {
+            FS_FreeExtent hole = _allocator.hole(h);
+            if (hole.startAddr + hole.length == startAddr && (size <= hole.length || _allocator.top() + size <= dataEnd()))
+            {
+                bestHole = h;
+                bestIndex = i;
+                best = entry;
+                break;
+            }
+        }
+    }
+    if (bestIndex == MJOLN_FILE_NOT_FOUND)
+        return false;
+
+    FS_FreeExtent hole = _allocator.hole(bestHole);
+    uint32_t size = best.size[0] | (best.size[1] << 8) | (best.size[2] << 16);
+    uint32_t destAddr = hole.startAddr;
+    if (size <= hole.length)
+        _allocator.reserve(destAddr, size);
+    else
+    {
+        // Copying onto itself is not crash safe, so an extent larger than the hole below it is moved to
+        // the top instead. The hole then absorbs the extent's old place and the extent later slides down.
+        destAddr = _allocator.top();
+        if (!_allocator.extend(destAddr, size))
+            return false;
+    }
+
+    _compaction.fatIndex = bestIndex;
+    _compaction.merge = false;
+    _compaction.destAddr = destAddr;
+    _compaction.length = size;
+    _compaction.copied = 0;
+    _compaction.srcIndex = bestIndex;
+    _compaction.srcAddr = best.startAddr[0] | (best.startAddr[1] << 8) | (best.startAddr[2] << 16);
+    _compaction.srcRemaining = size;
+    return true;
+}
+
+bool MjolnFileSystem::commitCompactionJob()
+{
+    uint16_t index = _compaction.fatIndex;
+    FS_FATEntry entry = readFATEntry(index);
+    uint32_t oldStart = entry.startAddr[0] | (entry.startAddr[1] << 8) | (entry.startAddr[2] << 16);
+    uint32_t oldSize = entry.size[0] | (entry.size[1] << 8) | (entry.size[2] << 16);
+    uint16_t links = _compaction.merge ? entry.link : MJOLN_FILE_NOT_FOUND;
+
+    // The superblock that switches the entry to the copy, together with the chain it absorbed, is the commit
+    // point; until then the old data is what is read, and its space is only released afterwards.
+    entry.startAddr[0] = _compaction.destAddr & 0xFF;
+    entry.startAddr[1] = (_compaction.destAddr >> 8) & 0xFF;
+    entry.startAddr[2] = (_compaction.destAddr >> 16) & 0xFF;
+    if (_compaction.merge)
+    {
+        entry.size[0] = _compaction.length & 0xFF;
+        entry.size[1] = (_compaction.length >> 8) & 0xFF;
+        entry.size[2] = (_compaction.length >> 16) & 0xFF;
+        entry.link = MJOLN_FILE_NOT_FOUND;
+    }
+
+    uint32_t linkBytes = 0;
+    syncDataTop();
+    if (!updateFATEntry(index, entry) || !deleteLinks(links, linkBytes) || !writeSuperblock())
+    {
+        MJOLN_LOG_ERROR("Failed to commit the move.\n");
+        abortCompaction();
+        reloadMetadata();
+        return false;
+    }
+    _compaction.fatIndex = MJOLN_FILE_NOT_FOUND;
+    releaseExtents(oldStart, oldSize, links, false);
+    if (_compaction.merge)
+        forgetTail(index);
+    syncDataTop();
+    return true;
+}
+
+void MjolnFileSystem::abortCompaction()
+{
+    if (_compaction.fatIndex == MJOLN_FILE_NOT_FOUND)
+        return;
+
+    _allocator.release(_compaction.destAddr, _compaction.length);
+    _compaction.fatIndex = MJOLN_FILE_NOT_FOUND;
+}
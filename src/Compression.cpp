@@ -0,0 +1,63 @@
+#include "MjolnFS.h"
+
+uint32_t MjolnFileSystem::packedLength(const uint8_t *data, uint32_t length)
+{
+    uint32_t stored = 0;
+    for (uint32_t done = 0; done < length;)
+    {
+        uint16_t raw = min(length - done, (uint32_t)MJOLN_COMPRESS_BLOCK_BYTES);
+        stored += MJOLN_COMPRESS_BLOCK_HEADER + min(lzPack(data + done, raw, NULL, NULL), raw);
+        done += raw;
+    }
+    return stored;
+}
+
+bool MjolnFileSystem::writePacked(uint32_t addr, const uint8_t *data, uint32_t length)
+{
+    // Each block is measured before it is packed, so its header can go out ahead of it.
+    FS_PackWriter writer;
+    writer.fs = this;
+    writer.addr = addr;
+    writer.fill = 0;
+    for (uint32_t done = 0; done < length;)
+    {
+        uint16_t raw = min(length - done, (uint32_t)MJOLN_COMPRESS_BLOCK_BYTES);
+        uint16_t packed = min(lzPack(data + done, raw, NULL, NULL), raw);
+        uint8_t header[MJOLN_COMPRESS_BLOCK_HEADER] = {(uint8_t)(raw & 0xFF), (uint8_t)(raw >> 8), (uint8_t)(packed & 0xFF), (uint8_t)(packed >> 8)};
+        if (!packSink(&writer, header, sizeof(header)))
+            return false;
+        if (packed == raw ? !packSink(&writer, data + done, raw) : lzPack(data + done, raw, packSink, &writer) == 0)
+            return false;
+        done += raw;
+    }
+    return writer.fill == 0 || storageWrite(writer.addr, writer.stage, writer.fill);
+}
+
+bool MjolnFileSystem::writeData(uint32_t addr, const uint8_t *data, uint32_t length, bool packed)
+{
+    return packed ? writePacked(addr, data, length) : storageWrite(addr, data, length);
+}
+
+bool MjolnFileSystem::packSink(void *context, const uint8_t *data, uint16_t length)
+{
+    FS_PackWriter *writer = (FS_PackWriter *)context;
+    uint16_t pageSize = writer->fs->getPageSize();
+    while (length > 0)
+    {
+        uint16_t room = min((uint16_t)(sizeof(writer->stage) - writer->fill), (uint16_t)(pageSize - (writer->addr + writer->fill) % pageSize));
+        uint16_t chunk = min(length, room);
+        memcpy(writer->stage + writer->fill, data, chunk);
+        writer->fill += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if (chunk == room)
+        {
+            if (!writer->fs->storageWrite(writer->addr, writer->stage, writer->fill))
+                return false;
+            writer->addr += writer->fill;
+            writer->fill = 0;
+        }
+    }
+    return true;
+}
@@ -1,46 +1,81 @@
 #include "FS_BootSector.h"
+#include "FS_Crc.h"
+#include "FS_Layout.h"
 
-FS_BootSector toBootSector(uint8_t *buffer)
+// The on-disk layout of the boot sector; each field starts where the previous one ends.
+static constexpr FS_Field bootSignature = {0, MJOLN_FILE_SYSTEM_SIGNATURE_SIZE};
+static constexpr FS_Field bootVersion = fieldAfter(bootSignature, 1);
+static constexpr FS_Field bootLastDataAddr = fieldAfter(bootVersion, 3);
+static constexpr FS_Field bootPageSize = fieldAfter(bootLastDataAddr, 1);
+static constexpr FS_Field bootFileCount = fieldAfter(bootPageSize, MJOLN_FILE_SYSTEM_FILE_COUNT_LENGTH);
+static constexpr FS_Field bootDeleted = fieldAfter(bootFileCount, 1);
+static constexpr FS_Field bootBytesInUse = fieldAfter(bootDeleted, 4);
+static constexpr FS_Field bootSuperblockSlots = fieldAfter(bootBytesInUse, 1);
+static constexpr FS_Field bootFlags = fieldAfter(bootSuperblockSlots, 1);
+static constexpr FS_Field bootGeneration = fieldAfter(bootFlags, 2);
+static constexpr FS_Field bootChipCount = fieldAfter(bootGeneration, 1);
+static constexpr FS_Field bootFatLimit = fieldAfter(bootChipCount, 2);
+static constexpr FS_Field bootCrc = fieldAfter(bootFatLimit, 2);
+
+static_assert(bootVersion.offset == 8 && bootBytesInUse.offset == 16 && bootGeneration.offset == 22 && bootCrc.offset == 27,
+              "Boot sector fields moved; existing volumes could no longer be read");
+static_assert(fieldEnd(bootCrc) <= MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE, "The boot sector layout must fit MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE");
+
+FS_BootSector toBootSector(const uint8_t *buffer)
 {
     FS_BootSector bootSector;
 
-    memcpy(bootSector.signature, buffer, MJOLN_FILE_SYSTEM_SIGNATURE_SIZE);
-    bootSector.version = buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE];
-    memcpy(bootSector.lastDataAddr, &buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 1], 3);
-    bootSector.pageSize = buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 4];
-    memcpy(bootSector.fileCount, &buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 5], MJOLN_FILE_SYSTEM_FILE_COUNT_LENGTH);
+    memcpy(bootSector.signature, buffer + bootSignature.offset, bootSignature.length);
     bootSector.signature[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE - 1] = '\0';
-    memcpy(&bootSector.deleted, &buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 7], 1);
-    memcpy(&bootSector.bytesInUse, &buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 8], 4);
+    bootSector.version = getField(buffer, bootVersion);
+    memcpy(bootSector.lastDataAddr, buffer + bootLastDataAddr.offset, bootLastDataAddr.length);
+    bootSector.pageSize = getField(buffer, bootPageSize);
+    memcpy(bootSector.fileCount, buffer + bootFileCount.offset, bootFileCount.length);
+    bootSector.deleted = getField(buffer, bootDeleted);
+    bootSector.bytesInUse = getField(buffer, bootBytesInUse);
+    bootSector.superblockSlots = getField(buffer, bootSuperblockSlots);
+    bootSector.flags = getField(buffer, bootFlags);
+    bootSector.generation = getField(buffer, bootGeneration);
+    bootSector.chipCount = getField(buffer, bootChipCount);
+    bootSector.fatLimit = getField(buffer, bootFatLimit);
+    bootSector.crc = getField(buffer, bootCrc);
 
     return bootSector;
 }
 
-uint8_t *bootSectorToBytes(const FS_BootSector *bootSector)
+void bootSectorToBytes(const FS_BootSector &bootSector, uint8_t *buffer)
 {
-    uint8_t *buffer = (uint8_t *)malloc(sizeof(FS_BootSector));
-
-    if (!buffer)
-        return NULL;
-
-    memcpy(buffer, bootSector->signature, MJOLN_FILE_SYSTEM_SIGNATURE_SIZE);
-    buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE] = bootSector->version;
-    memcpy(&buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 1], bootSector->lastDataAddr, 3);
-    buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 4] = bootSector->pageSize;
-    memcpy(&buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 5], bootSector->fileCount, MJOLN_FILE_SYSTEM_FILE_COUNT_LENGTH);
-    memcpy(&buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 7], &bootSector->deleted, 1);
-    memcpy(&buffer[MJOLN_FILE_SYSTEM_SIGNATURE_SIZE + 8], &bootSector->bytesInUse, 4);
+    memset(buffer, 0, MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE);
 
-    return buffer;
+    memcpy(buffer + bootSignature.offset, bootSector.signature, bootSignature.length);
+    putField(buffer, bootVersion, bootSector.version);
+    memcpy(buffer + bootLastDataAddr.offset, bootSector.lastDataAddr, bootLastDataAddr.length);
+    putField(buffer, bootPageSize, bootSector.pageSize);
+    memcpy(buffer + bootFileCount.offset, bootSector.fileCount, bootFileCount.length);
+    putField(buffer, bootDeleted, bootSector.deleted);
+    putField(buffer, bootBytesInUse, bootSector.bytesInUse);
+    putField(buffer, bootSuperblockSlots, bootSector.superblockSlots);
+    putField(buffer, bootFlags, bootSector.flags);
+    putField(buffer, bootGeneration, bootSector.generation);
+    putField(buffer, bootChipCount, bootSector.chipCount);
+    putField(buffer, bootFatLimit, bootSector.fatLimit);
+    putField(buffer, bootCrc, crc16(buffer, bootCrc.offset));
 }
 
-bool verifyBootSector(FS_BootSector *bootSector)
+bool verifyBootSector(const FS_BootSector &bootSector)
 {
-    if (memcmp(bootSector->signature, MJOLN_SIGNATURE, MJOLN_FILE_SYSTEM_SIGNATURE_SIZE) != 0)
+    if (memcmp(bootSector.signature, MJOLN_SIGNATURE, MJOLN_FILE_SYSTEM_SIGNATURE_SIZE) != 0)
         return false;
 
-    if (bootSector->version != MJOLN_FILE_SYSTEM_VERSION)
+    if (bootSector.version != MJOLN_FILE_SYSTEM_VERSION)
         return false;
 
-    return true;
-}
\ No newline at end of file
+    if (bootSector.superblockSlots == 0 || bootSector.pageSize == 0 || bootSector.chipCount == 0 ||
+        bootSector.fatLimit == 0 || bootSector.fatLimit > MJOLN_FILE_SYSTEM_MAX_FILES)
+        return false;
+
+    // The fields are encoded again, so the CRC is checked over exactly the bytes that were stored.
+    uint8_t buffer[MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE];
+    bootSectorToBytes(bootSector, buffer);
+    return getField(buffer, bootCrc) == bootSector.crc;
+}
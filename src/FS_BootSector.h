@@ -6,10 +6,16 @@
 
 #ifdef __cplusplus
 
+#define MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE 29 // Bytes the boot sector takes on the EEPROM, its CRC included
+
 /**
  * @brief Mjoln EEPROM File System Boot Sector
  * @note This structure represents the boot sector of the Mjoln EEPROM File System.
  * @note It contains information about the file system version, signature, page size, and file count.
+ * @note Only the format writes it. The fields that change afterwards are kept up to date in the superblock
+ * ring (see FS_Superblock) and copied over the values read from here when mounting.
+ * @note A new generation makes every superblock of the previous format fail its checksum, so a format only
+ * has to write the boot sector and one superblock; the old FAT and data are left behind unreferenced.
  */
 struct FS_BootSector
 {
@@ -20,31 +26,36 @@ struct FS_BootSector
     uint8_t fileCount[MJOLN_FILE_SYSTEM_FILE_COUNT_LENGTH]; // Number of files in the file system
     uint8_t deleted;                                        // Deleted count
     uint32_t bytesInUse;                                    // Total bytes used from available storage space
+    uint8_t superblockSlots;                                // Number of superblock slots following the boot sector
+    uint8_t flags;                                          // Options chosen at format, MJOLN_FLAG_*
+    uint16_t generation;                                    // Changed by every format, seeds the superblock checksum
+    uint8_t chipCount;                                      // EEPROMs the volume is striped over
+    uint16_t fatLimit;                                      // FAT entries per copy the FAT may grow to
+    uint16_t crc;                                           // CRC-16 of the fields above as stored on the EEPROM
 };
 
 /**
  * @brief Converts a byte buffer to a FS_BootSector structure.
- * @param buffer Pointer to the byte buffer.
+ * @param buffer Pointer to MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE bytes.
  * @return FS_BootSector structure.
- * @note The buffer must be at least sizeof(FS_BootSector) bytes long.
  */
-FS_BootSector toBootSector(uint8_t *buffer);
+FS_BootSector toBootSector(const uint8_t *buffer);
 
 /**
- * @brief Converts a FS_BootSector structure to a byte buffer.
- * @param bootSector Pointer to the FS_BootSector structure.
- * @return Pointer to the byte buffer.
- * @note The caller is responsible for freeing the allocated memory.
+ * @brief Converts a FS_BootSector structure to bytes.
+ * @param bootSector The boot sector to convert.
+ * @param buffer Pointer to MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE bytes.
+ * @note The CRC is computed over the other bytes and stored after them; the crc field is not used.
  */
-uint8_t *bootSectorToBytes(const FS_BootSector *bootSector);
+void bootSectorToBytes(const FS_BootSector &bootSector, uint8_t *buffer);
 
 /**
  * @brief Verifies the boot sector.
- * @param bootSector Pointer to the FS_BootSector structure.
+ * @param bootSector The boot sector read from the EEPROM.
  * @return true if the boot sector is valid, false otherwise.
- * @note This function checks the signature and version of the boot sector.
+ * @note This function checks the signature, version, CRC and geometry fields of the boot sector.
  */
-bool verifyBootSector(FS_BootSector *bootSector);
+bool verifyBootSector(const FS_BootSector &bootSector);
 
 #endif // __cplusplus
 #endif // FS_BOOTSECTOR_H
@@ -0,0 +1,122 @@
+#ifndef FS_CHIPGEOMETRY_H
+#define FS_CHIPGEOMETRY_H
+
+#include <Arduino.h>
+#include "MjolnConst.h"
+
+#ifdef __cplusplus
+
+/**
+ * @brief Supported EEPROM models.
+ * @note The value of each model is the base-2 logarithm of its size in bytes.
+ */
+enum AT24CXType
+{
+    AT24C04 = 0x09,
+    AT24C08 = 0x0A,
+    AT24C16 = 0x0B,
+    AT24C32 = 0x0C,
+    AT24C64 = 0x0D,
+    AT24C128 = 0x0E,
+    AT24C256 = 0x0F,
+    AT24C512 = 0x10,
+};
+
+enum AT24CX_ADDR_SIZE
+{
+    AT24CX_8Bit = 0x00, // 8-bit address size, the bits above come from the device address
+    AT24CX_16Bit = 0x01 // 16-bit address size
+};
+
+/**
+ * @brief Returns the size of one chip of a model in bytes.
+ */
+constexpr uint32_t chipSize(AT24CXType type)
+{
+    return (uint32_t)1 << (uint8_t)type;
+}
+
+/**
+ * @brief Returns the page size of a model, or 0 for a value that is not a supported model.
+ */
+constexpr uint8_t chipPageSize(AT24CXType type)
+{
+    return type < AT24C04 || type > AT24C512 ? 0 : type <= AT24C16 ? 16 : type <= AT24C64 ? 32 : type <= AT24C256 ? 64 : 128;
+}
+
+/**
+ * @brief Returns how a model takes the memory address.
+ */
+constexpr AT24CX_ADDR_SIZE chipAddressSize(AT24CXType type)
+{
+    return type <= AT24C16 ? AT24CX_8Bit : AT24CX_16Bit;
+}
+
+/**
+ * @brief Returns the number of I2C addresses one chip of a model answers on.
+ * @note 8-bit parts take one address per 256-byte block.
+ */
+constexpr uint8_t chipAddressCount(AT24CXType type)
+{
+    return chipAddressSize(type) == AT24CX_8Bit ? chipSize(type) >> 8 : 1;
+}
+
+/**
+ * @brief The geometry of a model as compile-time constants.
+ * @note Used by MjolnFS<Model>; the functions above give the same values for a model only known at run time.
+ */
+template <AT24CXType Model>
+struct FS_ChipTraits
+{
+    static_assert(chipPageSize(Model) != 0, "Unsupported EEPROM model");
+
+    static constexpr uint32_t size = chipSize(Model);
+    static constexpr uint8_t pageSize = chipPageSize(Model);
+    static constexpr AT24CX_ADDR_SIZE addressSize = chipAddressSize(Model);
+    static constexpr uint8_t addressCount = chipAddressCount(Model);
+};
+
+template <AT24CXType Model>
+constexpr uint32_t FS_ChipTraits<Model>::size;
+template <AT24CXType Model>
+constexpr uint8_t FS_ChipTraits<Model>::pageSize;
+template <AT24CXType Model>
+constexpr AT24CX_ADDR_SIZE FS_ChipTraits<Model>::addressSize;
+template <AT24CXType Model>
+constexpr uint8_t FS_ChipTraits<Model>::addressCount;
+
+/**
+ * @brief The geometry of a volume as values known at run time.
+ * @note The transfer templates in FileSystemManager.h and the device layer of MjolnFileSystem take either
+ * this or FS_FixedGeometry, which answers the same questions with constants.
+ */
+struct FS_Geometry
+{
+    uint8_t pageBytes;           // Page size in bytes
+    AT24CX_ADDR_SIZE addressing; // How the chips take the memory address
+    uint8_t chipCount;           // Chips the volume is striped over
+    uint8_t chipAddresses;       // I2C addresses one chip answers on
+
+    uint8_t pageSize() const { return pageBytes; }
+    AT24CX_ADDR_SIZE addressSize() const { return addressing; }
+    uint8_t chips() const { return chipCount; }
+    uint8_t addressesPerChip() const { return chipAddresses; }
+};
+
+/**
+ * @brief The geometry of a volume of Chips chips of one model, as compile-time constants.
+ * @note Used by MjolnFS<Model, Chips>: page and stripe arithmetic folds to shifts and masks, a single chip
+ * drops the striping, and the chunk loops run a fixed number of times.
+ */
+template <AT24CXType Model, uint8_t Chips = 1>
+struct FS_FixedGeometry
+{
+    static constexpr uint8_t pageSize() { return FS_ChipTraits<Model>::pageSize; }
+    static constexpr AT24CX_ADDR_SIZE addressSize() { return FS_ChipTraits<Model>::addressSize; }
+    static constexpr uint8_t chips() { return Chips; }
+    static constexpr uint8_t addressesPerChip() { return FS_ChipTraits<Model>::addressCount; }
+};
+
+#endif // __cplusplus
+#endif // FS_CHIPGEOMETRY_H
+       // This file defines the geometry of the EEPROM models supported by the Mjoln EEPROM File System.
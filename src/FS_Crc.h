@@ -0,0 +1,22 @@
+#ifndef FS_CRC_H
+#define FS_CRC_H
+
+#include <Arduino.h>
+
+#ifdef __cplusplus
+
+#define MJOLN_CRC16_INIT 0xFFFF // Initial value of a CRC-16/CCITT computation
+
+/**
+ * @brief Computes a CRC-16/CCITT (polynomial 0x1021) over a byte buffer.
+ * @param data Pointer to the bytes.
+ * @param length Number of bytes.
+ * @param crc Value to continue from, so a CRC can be computed over several buffers.
+ * @return The updated CRC.
+ * @note Bitwise, without a lookup table, to keep flash and RAM use small.
+ */
+uint16_t crc16(const uint8_t *data, uint16_t length, uint16_t crc = MJOLN_CRC16_INIT);
+
+#endif // __cplusplus
+#endif // FS_CRC_H
+       // This file defines the checksum used by the metadata of the Mjoln EEPROM File System.
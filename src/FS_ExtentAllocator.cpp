@@ -0,0 +1,265 @@
+#include "FS_ExtentAllocator.h"
+
+FS_ExtentAllocator::FS_ExtentAllocator()
+    : _holeCount(0), _dataStart(0), _dataEnd(0), _top(0), _cursor(0), _pageSize(1), _policy(FS_ALLOCATE_BEST_FIT)
+{
+}
+
+void FS_ExtentAllocator::begin(uint32_t dataStart, uint32_t dataEnd, uint32_t top, uint16_t pageSize)
+{
+    _dataStart = dataStart;
+    _dataEnd = dataEnd;
+    _top = max(top, dataStart);
+    _cursor = dataStart;
+    _pageSize = pageSize > 0 ? pageSize : 1;
+    _holeCount = 0;
+    if (_top > _dataStart)
+        insertHole(0, _dataStart, _top - _dataStart);
+}
+
+void FS_ExtentAllocator::reserve(uint32_t addr, uint32_t length)
+{
+    if (length == 0)
+        return;
+
+    // Data above the recorded top means the top was not saved after it was written, so the top moves up.
+    if (addr + length > _top)
+    {
+        if (addr > _top)
+            release(_top, addr - _top);
+        _top = addr + length;
+    }
+
+    for (uint8_t i = 0; i < _holeCount; i++)
+    {
+        uint32_t start = _holes[i].startAddr;
+        uint32_t end = start + _holes[i].length;
+        if (addr >= end || addr + length <= start)
+            continue;
+
+        uint32_t from = max(addr, start);
+        uint32_t to = min(addr + length, end);
+        if (from == start && to == end)
+            removeHole(i--);
+        else if (from == start)
+        {
+            _holes[i].startAddr = to;
+            _holes[i].length = end - to;
+        }
+        else
+        {
+            _holes[i].length = from - start;
+            if (to < end)
+                insertHole(i + 1, to, end - to);
+        }
+    }
+}
+
+uint32_t FS_ExtentAllocator::placeIn(uint32_t start, uint32_t end, uint32_t length) const
+{
+    uint32_t addr = start;
+    // Data that does not fit in what is left of its first page starts on the next page instead,
+    // so it spans as few pages, and page programs, as possible.
+    if (_policy == FS_ALLOCATE_PAGE_ALIGNED && _pageSize - (start % _pageSize) < length && start % _pageSize != 0)
+        addr = start + _pageSize - (start % _pageSize);
+
+    if (addr + length > end || addr + length < addr)
+        return MJOLN_ALLOCATION_FAILED;
+    return addr;
+}
+
+uint32_t FS_ExtentAllocator::allocate(uint32_t length)
+{
+    if (length == 0)
+        return _top;
+
+    uint8_t best = _holeCount;
+    uint32_t bestAddr = MJOLN_ALLOCATION_FAILED;
+    if (_policy == FS_ALLOCATE_NEXT_FIT)
+    {
+        bool fits;
+        best = nextFit(length, fits);
+        if (!fits)
+            return MJOLN_ALLOCATION_FAILED;
+        if (best < _holeCount)
+            bestAddr = _holes[best].startAddr;
+    }
+    else
+    {
+        for (uint8_t i = 0; i < _holeCount; i++)
+        {
+            uint32_t addr = placeIn(_holes[i].startAddr, _holes[i].startAddr + _holes[i].length, length);
+            if (addr != MJOLN_ALLOCATION_FAILED && (best == _holeCount || _holes[i].length < _holes[best].length))
+            {
+                best = i;
+                bestAddr = addr;
+            }
+        }
+    }
+
+    if (best < _holeCount)
+    {
+        uint32_t start = _holes[best].startAddr;
+        uint32_t end = start + _holes[best].length;
+        if (bestAddr == start)
+        {
+            _holes[best].startAddr += length;
+            _holes[best].length -= length;
+            if (_holes[best].length == 0)
+                removeHole(best);
+        }
+        else
+        {
+            _holes[best].length = bestAddr - start;
+            if (bestAddr + length < end)
+                insertHole(best + 1, bestAddr + length, end - bestAddr - length);
+        }
+        _cursor = bestAddr + length;
+        return bestAddr;
+    }
+
+    uint32_t addr = placeIn(_top, _dataEnd, length);
+    if (addr == MJOLN_ALLOCATION_FAILED)
+        return MJOLN_ALLOCATION_FAILED;
+    if (addr > _top)
+        release(_top, addr - _top);
+    _top = addr + length;
+    _cursor = _top;
+    return addr;
+}
+
+uint8_t FS_ExtentAllocator::nextFit(uint32_t length, bool &fits) const
+{
+    // The holes in address order, followed by the space above the top, are searched from the cursor on and
+    // then from the start of the data area, so consecutive allocations walk across the whole chip.
+    for (uint8_t pass = 0; pass < 2; pass++)
+    {
+        for (uint8_t i = 0; i <= _holeCount; i++)
+        {
+            uint32_t start = i < _holeCount ? _holes[i].startAddr : _top;
+            uint32_t end = i < _holeCount ? start + _holes[i].length : _dataEnd;
+            if ((pass == 0 && start < _cursor) || placeIn(start, end, length) == MJOLN_ALLOCATION_FAILED)
+                continue;
+            fits = true;
+            return i;
+        }
+    }
+    fits = false;
+    return _holeCount;
+}
+
+bool FS_ExtentAllocator::extend(uint32_t addr, uint32_t length)
+{
+    if (addr == _top)
+    {
+        if (_top + length > _dataEnd)
+            return false;
+        _top += length;
+        return true;
+    }
+
+    for (uint8_t i = 0; i < _holeCount && _holes[i].startAddr <= addr; i++)
+    {
+        if (_holes[i].startAddr == addr && _holes[i].length >= length)
+        {
+            _holes[i].startAddr += length;
+            _holes[i].length -= length;
+            if (_holes[i].length == 0)
+                removeHole(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FS_ExtentAllocator::shrink(uint32_t length)
+{
+    // Holes all lie below the top, so the space above it is the only free space at the end.
+    if (_dataEnd - _top < length)
+        return false;
+    _dataEnd -= length;
+    _cursor = min(_cursor, _dataEnd);
+    return true;
+}
+
+void FS_ExtentAllocator::grow(uint32_t length)
+{
+    // The bytes lie above the top, where everything is free, so no hole is needed.
+    _dataEnd += length;
+}
+
+void FS_ExtentAllocator::release(uint32_t addr, uint32_t length)
+{
+    if (length == 0)
+        return;
+
+    if (addr + length == _top)
+    {
+        _top = addr;
+        if (_holeCount > 0 && _holes[_holeCount - 1].startAddr + _holes[_holeCount - 1].length == _top)
+        {
+            _top = _holes[_holeCount - 1].startAddr;
+            removeHole(_holeCount - 1);
+        }
+        return;
+    }
+
+    uint8_t i = 0;
+    while (i < _holeCount && _holes[i].startAddr < addr)
+        i++;
+
+    bool mergePrevious = i > 0 && _holes[i - 1].startAddr + _holes[i - 1].length == addr;
+    bool mergeNext = i < _holeCount && addr + length == _holes[i].startAddr;
+    if (mergePrevious && mergeNext)
+    {
+        _holes[i - 1].length += length + _holes[i].length;
+        removeHole(i);
+    }
+    else if (mergePrevious)
+        _holes[i - 1].length += length;
+    else if (mergeNext)
+    {
+        _holes[i].startAddr = addr;
+        _holes[i].length += length;
+    }
+    else
+        insertHole(i, addr, length);
+}
+
+uint32_t FS_ExtentAllocator::freeBytes() const
+{
+    uint32_t total = _dataEnd - _top;
+    for (uint8_t i = 0; i < _holeCount; i++)
+        total += _holes[i].length;
+    return total;
+}
+
+void FS_ExtentAllocator::removeHole(uint8_t index)
+{
+    for (uint8_t i = index; i + 1 < _holeCount; i++)
+        _holes[i] = _holes[i + 1];
+    _holeCount--;
+}
+
+void FS_ExtentAllocator::insertHole(uint8_t index, uint32_t addr, uint32_t length)
+{
+    if (_holeCount == MJOLN_FILE_SYSTEM_FREE_EXTENTS)
+    {
+        uint8_t smallest = 0;
+        for (uint8_t i = 1; i < _holeCount; i++)
+            if (_holes[i].length < _holes[smallest].length)
+                smallest = i;
+
+        if (_holes[smallest].length >= length)
+            return;
+        removeHole(smallest);
+        if (smallest < index)
+            index--;
+    }
+
+    for (uint8_t i = _holeCount; i > index; i--)
+        _holes[i] = _holes[i - 1];
+    _holes[index].startAddr = addr;
+    _holes[index].length = length;
+    _holeCount++;
+}
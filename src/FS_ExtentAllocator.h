@@ -0,0 +1,129 @@
+#ifndef FS_EXTENTALLOCATOR_H
+#define FS_EXTENTALLOCATOR_H
+
+#include <Arduino.h>
+#include "MjolnConst.h"
+
+#ifdef __cplusplus
+
+#define MJOLN_ALLOCATION_FAILED 0xFFFFFFFFUL // Returned by FS_ExtentAllocator::allocate() when no space fits
+
+/**
+ * @brief Where new data is placed in the data area.
+ */
+enum FS_AllocationPolicy
+{
+    FS_ALLOCATE_BEST_FIT,     // Smallest free extent that fits, so holes are filled tightly
+    FS_ALLOCATE_PAGE_ALIGNED, // Data starts on a page boundary, so it is programmed with the fewest page writes
+    FS_ALLOCATE_NEXT_FIT,     // First fit after the previous allocation, wrapping around, so writes rotate over the chip
+};
+
+/**
+ * @brief A run of free bytes in the data area.
+ */
+struct FS_FreeExtent
+{
+    uint32_t startAddr; // First free byte
+    uint32_t length;    // Number of free bytes
+};
+
+/**
+ * @brief Mjoln EEPROM File System free-space allocator
+ * @note The data area is used from its start up to a top address; everything above the top is free.
+ * Below the top, holes left by deleted data are kept in a fixed-size list sorted by address and
+ * merged with their neighbours when released, so no heap is used.
+ * @note If the list overflows, the smallest hole is forgotten. It is found again when the list is
+ * rebuilt from the FAT at the next mount.
+ */
+class FS_ExtentAllocator
+{
+public:
+    FS_ExtentAllocator();
+
+    /**
+     * @brief Starts a rebuild with [dataStart, top) entirely free.
+     * @param dataStart First address of the data area.
+     * @param dataEnd Address one past the end of the data area.
+     * @param top Address above which nothing is allocated.
+     * @param pageSize Size of an EEPROM page, used by FS_ALLOCATE_PAGE_ALIGNED.
+     * @note Every extent still in use must then be passed to reserve().
+     */
+    void begin(uint32_t dataStart, uint32_t dataEnd, uint32_t top, uint16_t pageSize);
+
+    /**
+     * @brief Marks an extent below the top as used while rebuilding.
+     */
+    void reserve(uint32_t addr, uint32_t length);
+
+    /**
+     * @brief Finds space for length bytes according to the placement policy.
+     * @return Start address of the space, or MJOLN_ALLOCATION_FAILED.
+     */
+    uint32_t allocate(uint32_t length);
+
+    /**
+     * @brief Grows the extent ending at addr by length bytes if the bytes after it are free.
+     * @return true if the space was taken, false if the extent has to continue elsewhere.
+     */
+    bool extend(uint32_t addr, uint32_t length);
+
+    /**
+     * @brief Takes length bytes off the end of the data area if nothing is allocated in them.
+     * @return true if the data area shrank, false if data lies within the last length bytes.
+     */
+    bool shrink(uint32_t length);
+
+    /**
+     * @brief Gives length bytes that shrink() took back to the end of the data area.
+     */
+    void grow(uint32_t length);
+
+    /**
+     * @brief Returns an extent to the free space.
+     */
+    void release(uint32_t addr, uint32_t length);
+
+    /**
+     * @brief Sets where allocate() places new data.
+     */
+    void setPolicy(FS_AllocationPolicy policy) { _policy = policy; }
+    FS_AllocationPolicy policy() const { return _policy; }
+
+    /**
+     * @brief Returns the address FS_ALLOCATE_NEXT_FIT continues searching from.
+     */
+    uint32_t cursor() const { return _cursor; }
+    void setCursor(uint32_t cursor) { _cursor = cursor; }
+
+    /**
+     * @brief Returns the address above which nothing is allocated.
+     */
+    uint32_t top() const { return _top; }
+
+    /**
+     * @brief Returns the number of free bytes the allocator knows about.
+     */
+    uint32_t freeBytes() const;
+
+    uint8_t holeCount() const { return _holeCount; }
+    FS_FreeExtent hole(uint8_t index) const { return _holes[index]; }
+
+private:
+    void removeHole(uint8_t index);
+    void insertHole(uint8_t index, uint32_t addr, uint32_t length);
+    uint32_t placeIn(uint32_t start, uint32_t end, uint32_t length) const;
+    uint8_t nextFit(uint32_t length, bool &fits) const;
+
+    FS_FreeExtent _holes[MJOLN_FILE_SYSTEM_FREE_EXTENTS];
+    uint8_t _holeCount;
+    uint32_t _dataStart;
+    uint32_t _dataEnd;
+    uint32_t _top;
+    uint32_t _cursor;
+    uint16_t _pageSize;
+    FS_AllocationPolicy _policy;
+};
+
+#endif // __cplusplus
+#endif // FS_EXTENTALLOCATOR_H
+       // This file defines the free-space allocator of the Mjoln EEPROM File System.
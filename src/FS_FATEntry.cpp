@@ -1,36 +1,52 @@
 #include "FS_FATEntry.h"
-
-FS_FATEntry toFATEntry(uint8_t *buffer, size_t bufferSize)
+#include "FS_Crc.h"
+#include "FS_Layout.h"
+
+// The on-disk layout of a FAT entry; each field starts where the previous one ends.
+static constexpr FS_Field fatStartAddr = {0, MJOLN_FILE_SYSTEM_START_ADDR_SIZE};
+static constexpr FS_Field fatSize = fieldAfter(fatStartAddr, MJOLN_FILE_SYSTEM_FILE_SIZE);
+static constexpr FS_Field fatFilename = fieldAfter(fatSize, MJOLN_FILE_NAME_MAX_LENGTH - 1);
+static constexpr FS_Field fatLink = fieldAfter(fatFilename, 4);
+static constexpr FS_Field fatStatus = fieldAfter(fatLink, 1);
+static constexpr FS_Field fatRecordSize = fieldAfter(fatStatus, 2);
+static constexpr FS_Field fatFlags = fieldAfter(fatRecordSize, 1);
+static constexpr FS_Field fatCrc = fieldAfter(fatFlags, 2);
+
+static_assert(fatLink.offset == 14 && fatStatus.offset == 18 && fatRecordSize.offset == 19 && fatFlags.offset == 21,
+              "FAT entry fields moved; existing volumes could no longer be read");
+static_assert(fatCrc.offset == MJOLN_FILE_SYSTEM_FAT_ENTRY_BYTES, "The CRC must follow the data bytes of a FAT entry");
+static_assert(fieldEnd(fatCrc) == MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE, "The FAT entry layout must fill MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE");
+static_assert(sizeof(FS_FATEntry) == MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE, "The FAT mirror decodes entries in place, so the structure must be as long as the record");
+
+FS_FATEntry toFATEntry(const uint8_t *buffer)
 {
-    FS_FATEntry fatEntry;
-
-    if (bufferSize < MJOLN_FILE_SYSTEM_START_ADDR_SIZE + MJOLN_FILE_SYSTEM_FILE_SIZE + MJOLN_FILE_NAME_MAX_LENGTH + 1)
-        return {};
-
-    memcpy(fatEntry.startAddr, buffer, MJOLN_FILE_SYSTEM_START_ADDR_SIZE);
-    memcpy(fatEntry.size, buffer + MJOLN_FILE_SYSTEM_START_ADDR_SIZE, MJOLN_FILE_SYSTEM_FILE_SIZE);
-    memcpy(fatEntry.filename, buffer + MJOLN_FILE_SYSTEM_START_ADDR_SIZE + MJOLN_FILE_SYSTEM_FILE_SIZE, MJOLN_FILE_NAME_MAX_LENGTH - 1);
+    FS_FATEntry fatEntry = FS_FATEntry();
 
+    memcpy(fatEntry.startAddr, buffer + fatStartAddr.offset, fatStartAddr.length);
+    memcpy(fatEntry.size, buffer + fatSize.offset, fatSize.length);
+    memcpy(fatEntry.filename, buffer + fatFilename.offset, fatFilename.length);
     fatEntry.filename[MJOLN_FILE_NAME_MAX_LENGTH - 1] = '\0';
-    memcpy(&fatEntry.link, buffer + MJOLN_FILE_SYSTEM_START_ADDR_SIZE + MJOLN_FILE_SYSTEM_FILE_SIZE + MJOLN_FILE_NAME_MAX_LENGTH - 1, sizeof(fatEntry.link));
-    fatEntry.status = buffer[MJOLN_FILE_SYSTEM_START_ADDR_SIZE + MJOLN_FILE_SYSTEM_FILE_SIZE + MJOLN_FILE_NAME_MAX_LENGTH - 1 + sizeof(fatEntry.link)];
+    fatEntry.link = getField(buffer, fatLink);
+    fatEntry.status = getField(buffer, fatStatus);
+    fatEntry.recordSize = getField(buffer, fatRecordSize);
+    fatEntry.flags = getField(buffer, fatFlags);
 
     return fatEntry;
 }
 
-uint8_t *fatToBytes(const FS_FATEntry *fatEntry)
+void fatToBytes(const FS_FATEntry &fatEntry, uint8_t *buffer)
 {
-    uint8_t *buffer = (uint8_t *)malloc(MJOLN_FILE_SYSTEM_START_ADDR_SIZE + MJOLN_FILE_SYSTEM_FILE_SIZE + MJOLN_FILE_NAME_MAX_LENGTH + 1);
-
-    if (!buffer)
-        return NULL;
-
-    memcpy(buffer, fatEntry->startAddr, MJOLN_FILE_SYSTEM_START_ADDR_SIZE);
-    memcpy(buffer + MJOLN_FILE_SYSTEM_START_ADDR_SIZE, fatEntry->size, MJOLN_FILE_SYSTEM_FILE_SIZE);
-    memcpy(buffer + MJOLN_FILE_SYSTEM_START_ADDR_SIZE + MJOLN_FILE_SYSTEM_FILE_SIZE, fatEntry->filename, MJOLN_FILE_NAME_MAX_LENGTH - 1);
-    buffer[MJOLN_FILE_SYSTEM_START_ADDR_SIZE + MJOLN_FILE_SYSTEM_FILE_SIZE + MJOLN_FILE_NAME_MAX_LENGTH - 1] = '\0';
-    memcpy(buffer + MJOLN_FILE_SYSTEM_START_ADDR_SIZE + MJOLN_FILE_SYSTEM_FILE_SIZE + MJOLN_FILE_NAME_MAX_LENGTH - 1, &fatEntry->link, sizeof(fatEntry->link));
-    buffer[MJOLN_FILE_SYSTEM_START_ADDR_SIZE + MJOLN_FILE_SYSTEM_FILE_SIZE + MJOLN_FILE_NAME_MAX_LENGTH - 1 + sizeof(fatEntry->link)] = fatEntry->status;
+    memcpy(buffer + fatStartAddr.offset, fatEntry.startAddr, fatStartAddr.length);
+    memcpy(buffer + fatSize.offset, fatEntry.size, fatSize.length);
+    memcpy(buffer + fatFilename.offset, fatEntry.filename, fatFilename.length);
+    putField(buffer, fatLink, fatEntry.link);
+    putField(buffer, fatStatus, fatEntry.status);
+    putField(buffer, fatRecordSize, fatEntry.recordSize);
+    putField(buffer, fatFlags, fatEntry.flags);
+    putField(buffer, fatCrc, crc16(buffer, fatCrc.offset));
+}
 
-    return buffer;
+bool fatEntryIntact(const uint8_t *buffer)
+{
+    return crc16(buffer, fatCrc.offset) == getField(buffer, fatCrc);
 }
@@ -6,36 +6,49 @@
 
 #ifdef __cplusplus
 
+#define MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE 24 // Bytes a FAT entry takes on the EEPROM, its CRC included
+
 /**
  * @brief Mjoln EEPROM File System FAT Entry
  * @note This structure represents a FAT entry in the Mjoln EEPROM File System.
  * @note It contains information about the start address, size, filename, and status of the file.
+ * @note On the EEPROM the fields take MJOLN_FILE_SYSTEM_FAT_ENTRY_BYTES bytes, followed by a CRC-16 of them
+ * that fills the MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE bytes an entry occupies. The structure has the same size on
+ * every platform, so a raw FAT region read into an array of entries can be decoded in place.
  */
 struct FS_FATEntry
 {
     uint8_t startAddr[MJOLN_FILE_SYSTEM_START_ADDR_SIZE]; // Start address of the file in EEPROM
     uint8_t size[MJOLN_FILE_SYSTEM_FILE_SIZE];            // Size of the file in bytes
     char filename[MJOLN_FILE_NAME_MAX_LENGTH];            // File name (null-terminated)
+    uint8_t reserved;                                     // Pads the structure to the same size on every platform
     uint32_t link;                                        // Link to the next FAT entry (for linked list structure)
-    uint8_t status;                                       // Status of the file (0: free, 1: used)
+    uint8_t status;                                       // Status of the file (0: free, 1: used, 2: link extent)
+    uint8_t flags;                                        // MJOLN_FILE_FLAG_* bits describing how the data is stored
+    uint16_t recordSize;                                  // Size of a record for record files, 0 for plain files
 };
 
 /**
  * @brief Converts a byte buffer to a FS_FATEntry structure.
- * @param buffer Pointer to the byte buffer.
- * @param bufferSize Size of the buffer.
+ * @param buffer Pointer to the MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE bytes of the entry.
  * @return FS_FATEntry structure.
- * @note The buffer must be at least sizeof(FS_FATEntry) bytes long.
+ * @note The CRC is not checked, see fatEntryIntact().
+ */
+FS_FATEntry toFATEntry(const uint8_t *buffer);
+
+/**
+ * @brief Checks the CRC of a FAT entry read from the EEPROM.
+ * @param buffer Pointer to the MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE bytes of the entry.
+ * @return true if the entry is intact, false if it is torn or was never written.
  */
-FS_FATEntry toFATEntry(uint8_t *buffer, size_t bufferSize);
+bool fatEntryIntact(const uint8_t *buffer);
 
 /**
- * @brief Converts a FS_FATEntry structure to a byte buffer.
- * @param fatEntry Pointer to the FS_FATEntry structure.
- * @return Pointer to the byte buffer.
- * @note The caller is responsible for freeing the allocated memory.
+ * @brief Converts a FS_FATEntry structure to bytes, including its CRC.
+ * @param fatEntry The FAT entry to convert.
+ * @param buffer Pointer to MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE bytes.
  */
-uint8_t *fatToBytes(const FS_FATEntry *fatEntry);
+void fatToBytes(const FS_FATEntry &fatEntry, uint8_t *buffer);
 
 #endif //__cplusplus
 #endif // FS_FATENTRY_H
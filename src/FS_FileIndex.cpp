@@ -0,0 +1,86 @@
+#include "FS_FileIndex.h"
+
+#if MJOLN_FILE_SYSTEM_INDEX_SLOTS <= MJOLN_FILE_SYSTEM_MAX_FILES
+#error "MJOLN_FILE_SYSTEM_FAT_BITMAP_BYTES allows more files than the filename index holds, at most 32 bytes are supported"
+#endif
+
+FS_FileIndex::FS_FileIndex()
+{
+    clear();
+}
+
+void FS_FileIndex::clear()
+{
+    memset(_slots, 0, sizeof(_slots));
+    _complete = true;
+}
+
+uint16_t FS_FileIndex::hash(const char *filename)
+{
+    // FNV-1a over the stored part of the name, folded to 16 bits.
+    uint32_t h = 2166136261UL;
+    for (uint8_t i = 0; i < MJOLN_FILE_NAME_MAX_LENGTH - 1 && filename[i] != '\0'; i++)
+    {
+        h ^= (uint8_t)filename[i];
+        h *= 16777619UL;
+    }
+    return (uint16_t)(h ^ (h >> 16));
+}
+
+bool FS_FileIndex::insert(const char *filename, uint16_t fatIndex)
+{
+    uint16_t h = hash(filename);
+    uint16_t mask = MJOLN_FILE_SYSTEM_INDEX_SLOTS - 1;
+
+    for (uint16_t probe = 0; probe < MJOLN_FILE_SYSTEM_INDEX_SLOTS; probe++)
+    {
+        FS_FileIndexSlot &slot = _slots[(h + probe) & mask];
+        if (slot.fatIndex == MJOLN_FILE_INDEX_EMPTY || slot.fatIndex == MJOLN_FILE_INDEX_TOMBSTONE)
+        {
+            slot.hash = h;
+            slot.fatIndex = fatIndex;
+            return true;
+        }
+    }
+
+    _complete = false;
+    return false;
+}
+
+void FS_FileIndex::remove(const char *filename, uint16_t fatIndex)
+{
+    uint16_t h = hash(filename);
+    uint16_t mask = MJOLN_FILE_SYSTEM_INDEX_SLOTS - 1;
+
+    for (uint16_t probe = 0; probe < MJOLN_FILE_SYSTEM_INDEX_SLOTS; probe++)
+    {
+        FS_FileIndexSlot &slot = _slots[(h + probe) & mask];
+        if (slot.fatIndex == MJOLN_FILE_INDEX_EMPTY)
+            return;
+        if (slot.fatIndex == fatIndex && slot.hash == h)
+        {
+            slot.fatIndex = MJOLN_FILE_INDEX_TOMBSTONE;
+            return;
+        }
+    }
+}
+
+uint16_t FS_FileIndex::nextCandidate(const char *filename, uint16_t &cursor) const
+{
+    uint16_t h = hash(filename);
+    uint16_t mask = MJOLN_FILE_SYSTEM_INDEX_SLOTS - 1;
+
+    while (cursor < MJOLN_FILE_SYSTEM_INDEX_SLOTS)
+    {
+        const FS_FileIndexSlot &slot = _slots[(h + cursor) & mask];
+        cursor++;
+        if (slot.fatIndex == MJOLN_FILE_INDEX_EMPTY)
+        {
+            cursor = MJOLN_FILE_SYSTEM_INDEX_SLOTS;
+            break;
+        }
+        if (slot.fatIndex != MJOLN_FILE_INDEX_TOMBSTONE && slot.hash == h)
+            return slot.fatIndex;
+    }
+    return MJOLN_FILE_NOT_FOUND;
+}
@@ -0,0 +1,78 @@
+#ifndef FS_FILEINDEX_H
+#define FS_FILEINDEX_H
+
+#include <Arduino.h>
+#include "MjolnConst.h"
+
+#ifdef __cplusplus
+
+#define MJOLN_FILE_INDEX_EMPTY 0x0000     // Slot has never been used; ends a probe sequence
+#define MJOLN_FILE_INDEX_TOMBSTONE 0xFFFF // Slot held a deleted file; probing continues past it
+
+/**
+ * @brief A slot of the filename index.
+ */
+struct FS_FileIndexSlot
+{
+    uint16_t hash;     // Hash of the file name
+    uint16_t fatIndex; // FAT index of the file, or MJOLN_FILE_INDEX_EMPTY / MJOLN_FILE_INDEX_TOMBSTONE
+};
+
+/**
+ * @brief Mjoln EEPROM File System filename index
+ * @note Fixed-size open-addressing table mapping filename hashes to FAT indices.
+ * @note Hashes may collide, so every candidate returned must be confirmed against its FAT entry.
+ */
+class FS_FileIndex
+{
+public:
+    FS_FileIndex();
+
+    /**
+     * @brief Removes every entry.
+     */
+    void clear();
+
+    /**
+     * @brief Adds a file to the index.
+     * @param filename Name of the file.
+     * @param fatIndex FAT index of the file.
+     * @return true if the file was added, false if the table is full.
+     * @note A failed insert marks the index as incomplete until the next clear().
+     */
+    bool insert(const char *filename, uint16_t fatIndex);
+
+    /**
+     * @brief Removes a file from the index.
+     * @param filename Name of the file.
+     * @param fatIndex FAT index of the file.
+     */
+    void remove(const char *filename, uint16_t fatIndex);
+
+    /**
+     * @brief Returns the next FAT index whose name hash matches the file name.
+     * @param filename Name of the file.
+     * @param cursor Probe position; set to 0 before the first call.
+     * @return FAT index of a candidate, or MJOLN_FILE_NOT_FOUND when there are no more candidates.
+     */
+    uint16_t nextCandidate(const char *filename, uint16_t &cursor) const;
+
+    /**
+     * @brief Checks if every file that was inserted is in the table.
+     * @note When false, a miss does not prove that the file does not exist.
+     */
+    bool isComplete() const { return _complete; }
+
+    /**
+     * @brief Hashes a file name the way it is stored in a FAT entry.
+     */
+    static uint16_t hash(const char *filename);
+
+private:
+    FS_FileIndexSlot _slots[MJOLN_FILE_SYSTEM_INDEX_SLOTS];
+    bool _complete;
+};
+
+#endif // __cplusplus
+#endif // FS_FILEINDEX_H
+       // This file defines the filename index of the Mjoln EEPROM File System.
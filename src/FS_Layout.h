@@ -0,0 +1,57 @@
+#ifndef FS_LAYOUT_H
+#define FS_LAYOUT_H
+
+#include <Arduino.h>
+
+#ifdef __cplusplus
+
+/**
+ * @brief Position of a field in a metadata record on the EEPROM.
+ * @note A record is described once, as a chain of fieldAfter() calls, and the encoder, the decoder and the
+ * static_asserts that pin the on-disk offsets all read that one description.
+ */
+struct FS_Field
+{
+    uint8_t offset; // First byte of the field in the record
+    uint8_t length; // Bytes the field takes
+};
+
+/**
+ * @brief Describes the field that follows another one.
+ */
+constexpr FS_Field fieldAfter(FS_Field previous, uint8_t length)
+{
+    return FS_Field{(uint8_t)(previous.offset + previous.length), length};
+}
+
+/**
+ * @brief Returns the offset of the first byte after a field.
+ */
+constexpr uint8_t fieldEnd(FS_Field field)
+{
+    return field.offset + field.length;
+}
+
+/**
+ * @brief Stores an integer in a field, least significant byte first.
+ */
+inline void putField(uint8_t *buffer, FS_Field field, uint32_t value)
+{
+    for (uint8_t i = 0; i < field.length; i++)
+        buffer[field.offset + i] = (value >> (8 * i)) & 0xFF;
+}
+
+/**
+ * @brief Reads an integer stored by putField().
+ */
+inline uint32_t getField(const uint8_t *buffer, FS_Field field)
+{
+    uint32_t value = 0;
+    for (uint8_t i = field.length; i > 0; i--)
+        value = value << 8 | buffer[field.offset + i - 1];
+    return value;
+}
+
+#endif // __cplusplus
+#endif // FS_LAYOUT_H
+       // This file defines how the metadata records of the Mjoln EEPROM File System are laid out.
@@ -0,0 +1,161 @@
+#include "FS_Lz.h"
+
+static uint8_t prefixHash(const uint8_t *src)
+{
+    uint16_t key = ((uint16_t)src[0] << 8 | src[1]) ^ ((uint16_t)src[2] << 4);
+    return (uint16_t)(key * 0x9E37) >> (16 - MJOLN_LZ_HASH_BITS);
+}
+
+uint16_t lzPack(const uint8_t *src, uint16_t length, FS_LzSink sink, void *context)
+{
+    // Positions are stored plus one, so 0 marks an empty slot.
+    uint16_t head[1 << MJOLN_LZ_HASH_BITS];
+    memset(head, 0, sizeof(head));
+
+    uint8_t group[1 + 8 * 2];
+    uint8_t groupLength = 1;
+    uint8_t items = 0;
+    uint16_t packed = 0;
+    group[0] = 0;
+
+    uint16_t pos = 0;
+    while (pos < length)
+    {
+        uint16_t matchLength = 0;
+        uint16_t distance = 0;
+        if (length - pos >= MJOLN_LZ_MIN_MATCH)
+        {
+            uint8_t slot = prefixHash(src + pos);
+            uint16_t candidate = head[slot];
+            head[slot] = pos + 1;
+            if (candidate != 0 && pos - (candidate - 1) <= MJOLN_LZ_WINDOW)
+            {
+                // The match may run into the bytes it copies; the decoder produces them in the same order.
+                uint16_t from = candidate - 1;
+                uint16_t longest = min((uint16_t)(length - pos), (uint16_t)MJOLN_LZ_MAX_MATCH);
+                while (matchLength < longest && src[from + matchLength] == src[pos + matchLength])
+                    matchLength++;
+                distance = pos - from;
+            }
+        }
+
+        if (matchLength >= MJOLN_LZ_MIN_MATCH)
+        {
+            group[0] |= 1 << items;
+            group[groupLength++] = distance - 1;
+            group[groupLength++] = matchLength - MJOLN_LZ_MIN_MATCH;
+            for (uint16_t i = 1; i < matchLength && length - (pos + i) >= MJOLN_LZ_MIN_MATCH; i++)
+                head[prefixHash(src + pos + i)] = pos + i + 1;
+            pos += matchLength;
+        }
+        else
+            group[groupLength++] = src[pos++];
+
+        if (++items == 8 || pos == length)
+        {
+            if (sink && !sink(context, group, groupLength))
+                return 0;
+            packed += groupLength;
+            group[0] = 0;
+            groupLength = 1;
+            items = 0;
+        }
+    }
+    return packed;
+}
+
+FS_LzDecoder::FS_LzDecoder()
+    : _window(NULL), _windowPos(0), _control(0), _controlBits(0), _matchDistance(0), _matchLeft(0), _inputPos(0), _inputLength(0)
+{
+}
+
+FS_LzDecoder::~FS_LzDecoder()
+{
+    end();
+}
+
+bool FS_LzDecoder::begin()
+{
+    if (_window)
+        return true;
+    _window = (uint8_t *)malloc(MJOLN_LZ_WINDOW);
+    reset();
+    return _window != NULL;
+}
+
+void FS_LzDecoder::end()
+{
+    free(_window);
+    _window = NULL;
+}
+
+void FS_LzDecoder::reset()
+{
+    _windowPos = 0;
+    _control = 0;
+    _controlBits = 0;
+    _matchLeft = 0;
+    _inputPos = 0;
+    _inputLength = 0;
+}
+
+bool FS_LzDecoder::take(uint8_t &byte, FS_LzSource source, void *context)
+{
+    if (_inputPos == _inputLength)
+    {
+        _inputLength = source(context, _input, sizeof(_input));
+        _inputPos = 0;
+        if (_inputLength == 0)
+            return false;
+    }
+    byte = _input[_inputPos++];
+    return true;
+}
+
+uint16_t FS_LzDecoder::decode(uint8_t *out, uint16_t length, FS_LzSource source, void *context)
+{
+    if (!_window)
+        return 0;
+
+    uint16_t produced = 0;
+    while (produced < length)
+    {
+        uint8_t byte;
+        if (_matchLeft > 0)
+        {
+            // The window is 256 bytes, so the uint8_t index wraps exactly at its end.
+            byte = _window[(uint8_t)(_windowPos - _matchDistance)];
+            _matchLeft--;
+        }
+        else
+        {
+            if (_controlBits == 0)
+            {
+                if (!take(_control, source, context))
+                    break;
+                _controlBits = 8;
+            }
+            bool match = _control & 1;
+            _control >>= 1;
+            _controlBits--;
+
+            if (match)
+            {
+                uint8_t distance, matchLength;
+                if (!take(distance, source, context) || !take(matchLength, source, context))
+                    break;
+                _matchDistance = distance + 1;
+                _matchLeft = matchLength + MJOLN_LZ_MIN_MATCH;
+                continue;
+            }
+            if (!take(byte, source, context))
+                break;
+        }
+
+        _window[_windowPos++] = byte;
+        if (out)
+            out[produced] = byte;
+        produced++;
+    }
+    return produced;
+}
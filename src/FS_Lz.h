@@ -0,0 +1,99 @@
+#ifndef FS_LZ_H
+#define FS_LZ_H
+
+#include <Arduino.h>
+#include "MjolnConst.h"
+
+#ifdef __cplusplus
+
+#define MJOLN_LZ_WINDOW 256     // Bytes a match can reach back; the decoder keeps this much history
+#define MJOLN_LZ_MIN_MATCH 3    // Shortest match worth coding, a match takes two bytes
+#define MJOLN_LZ_MAX_MATCH 258  // Longest match, the length byte holds length - MJOLN_LZ_MIN_MATCH
+#define MJOLN_LZ_HASH_BITS 6    // The encoder remembers the last position of 2^bits three-byte prefixes
+#define MJOLN_LZ_INPUT_BYTES 16 // Compressed bytes the decoder fetches at a time
+
+/**
+ * @brief Receives the bytes produced by lzPack().
+ * @return false to stop packing.
+ */
+typedef bool (*FS_LzSink)(void *context, const uint8_t *data, uint16_t length);
+
+/**
+ * @brief Supplies compressed bytes to FS_LzDecoder.
+ * @return Number of bytes placed in the buffer, 0 when there are none left.
+ */
+typedef uint16_t (*FS_LzSource)(void *context, uint8_t *buffer, uint16_t length);
+
+/**
+ * @brief Compresses a buffer with a byte-oriented LZSS scheme.
+ * @param src Bytes to compress.
+ * @param length Number of bytes.
+ * @param sink Receives the compressed bytes a group at a time, or NULL to only measure.
+ * @param context Passed to the sink.
+ * @return Number of compressed bytes, 0 if the sink failed.
+ * @note A control byte announces the next eight items, one bit each: 0 for a literal byte, 1 for a match of
+ * two bytes, distance - 1 and length - MJOLN_LZ_MIN_MATCH.
+ * @note Matches are found through a table of 2^MJOLN_LZ_HASH_BITS positions on the stack, so packing is
+ * fast and deterministic and takes no heap.
+ */
+uint16_t lzPack(const uint8_t *src, uint16_t length, FS_LzSink sink, void *context);
+
+/**
+ * @brief Mjoln EEPROM File System LZSS decoder
+ * @note Decodes in caller-sized pieces, so a compressed file can be streamed. The history window is only
+ * allocated by begin(), so the decoder costs little RAM until a compressed file is read.
+ */
+class FS_LzDecoder
+{
+public:
+    FS_LzDecoder();
+    ~FS_LzDecoder();
+
+    /**
+     * @brief Allocates the history window.
+     * @return true if the memory was allocated, false otherwise.
+     */
+    bool begin();
+
+    /**
+     * @brief Releases the history window.
+     */
+    void end();
+
+    /**
+     * @brief Checks if the history window has been allocated.
+     */
+    bool isEnabled() const { return _window != NULL; }
+
+    /**
+     * @brief Prepares for a new compressed stream.
+     */
+    void reset();
+
+    /**
+     * @brief Decodes the next bytes of the stream.
+     * @param out Destination buffer, or NULL to skip the bytes.
+     * @param length Number of bytes wanted.
+     * @param source Supplies the compressed bytes.
+     * @param context Passed to the source.
+     * @return Number of bytes decoded; less than length only if the source ran dry.
+     */
+    uint16_t decode(uint8_t *out, uint16_t length, FS_LzSource source, void *context);
+
+private:
+    bool take(uint8_t &byte, FS_LzSource source, void *context);
+
+    uint8_t *_window;
+    uint8_t _windowPos;
+    uint8_t _control;
+    uint8_t _controlBits;
+    uint16_t _matchDistance;
+    uint16_t _matchLeft;
+    uint8_t _input[MJOLN_LZ_INPUT_BYTES];
+    uint8_t _inputPos;
+    uint8_t _inputLength;
+};
+
+#endif // __cplusplus
+#endif // FS_LZ_H
+       // This file defines the compression codec of the Mjoln EEPROM File System.
@@ -0,0 +1,124 @@
+#include "FS_PageCache.h"
+
+FS_PageCache::FS_PageCache()
+    : _pages(NULL), _memory(NULL), _pageCount(0), _pageSize(0), _useCounter(0)
+{
+}
+
+FS_PageCache::~FS_PageCache()
+{
+    end();
+}
+
+bool FS_PageCache::begin(uint8_t pageCount, uint16_t pageSize)
+{
+    end();
+
+    if (pageCount == 0 || pageSize == 0)
+        return false;
+
+    _pages = (FS_CachedPage *)malloc(pageCount * sizeof(FS_CachedPage));
+    _memory = (uint8_t *)malloc(pageCount * pageSize);
+
+    if (!_pages || !_memory)
+    {
+        end();
+        return false;
+    }
+
+    _pageCount = pageCount;
+    _pageSize = pageSize;
+    for (uint8_t i = 0; i < _pageCount; i++)
+        _pages[i].data = _memory + (i * pageSize);
+    invalidate();
+    return true;
+}
+
+void FS_PageCache::end()
+{
+    free(_pages);
+    free(_memory);
+    _pages = NULL;
+    _memory = NULL;
+    _pageCount = 0;
+    _pageSize = 0;
+}
+
+FS_CachedPage *FS_PageCache::lookup(uint32_t pageAddr)
+{
+    for (uint8_t i = 0; i < _pageCount; i++)
+    {
+        if (_pages[i].valid && _pages[i].pageAddr == pageAddr)
+        {
+            _pages[i].lastUse = ++_useCounter;
+            return &_pages[i];
+        }
+    }
+    return NULL;
+}
+
+FS_CachedPage *FS_PageCache::victim()
+{
+    FS_CachedPage *oldest = NULL;
+    for (uint8_t i = 0; i < _pageCount; i++)
+    {
+        if (!_pages[i].valid)
+            return &_pages[i];
+        if (!oldest || _pages[i].lastUse < oldest->lastUse)
+            oldest = &_pages[i];
+    }
+    return oldest;
+}
+
+void FS_PageCache::assign(FS_CachedPage *page, uint32_t pageAddr)
+{
+    page->pageAddr = pageAddr;
+    page->valid = true;
+    page->filled = false;
+    page->dirtyStart = _pageSize;
+    page->dirtyEnd = 0;
+    page->lastUse = ++_useCounter;
+}
+
+void FS_PageCache::markDirty(FS_CachedPage *page, uint16_t offset, uint16_t length)
+{
+    if (offset < page->dirtyStart)
+        page->dirtyStart = offset;
+    if (offset + length > page->dirtyEnd)
+        page->dirtyEnd = offset + length;
+}
+
+void FS_PageCache::markClean(FS_CachedPage *page)
+{
+    page->dirtyStart = _pageSize;
+    page->dirtyEnd = 0;
+}
+
+FS_CachedPage *FS_PageCache::nextDirty()
+{
+    FS_CachedPage *lowest = NULL;
+    for (uint8_t i = 0; i < _pageCount; i++)
+        if (isDirty(&_pages[i]) && (!lowest || _pages[i].pageAddr < lowest->pageAddr))
+            lowest = &_pages[i];
+    return lowest;
+}
+
+void FS_PageCache::drop(FS_CachedPage *page)
+{
+    page->valid = false;
+    page->filled = false;
+    page->dirtyStart = _pageSize;
+    page->dirtyEnd = 0;
+}
+
+void FS_PageCache::invalidate()
+{
+    for (uint8_t i = 0; i < _pageCount; i++)
+    {
+        _pages[i].valid = false;
+        _pages[i].filled = false;
+        _pages[i].dirtyStart = _pageSize;
+        _pages[i].dirtyEnd = 0;
+        _pages[i].lastUse = 0;
+    }
+}
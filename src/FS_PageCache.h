@@ -0,0 +1,113 @@
+#ifndef FS_PAGECACHE_H
+#define FS_PAGECACHE_H
+
+#include <Arduino.h>
+#include "MjolnConst.h"
+
+#ifdef __cplusplus
+
+/**
+ * @brief A single page held by the write-back cache.
+ * @note Only the bytes in [dirtyStart, dirtyEnd) are known unless the page is filled.
+ */
+struct FS_CachedPage
+{
+    uint32_t pageAddr;   // EEPROM address of the first byte of the page
+    uint8_t *data;       // Page contents, pageSize bytes long
+    uint16_t dirtyStart; // Offset of the first modified byte
+    uint16_t dirtyEnd;   // Offset one past the last modified byte
+    uint32_t lastUse;    // Use stamp for least recently used eviction
+    bool valid;          // The slot holds a page
+    bool filled;         // The whole page was read from EEPROM, not just the dirty range
+};
+
+/**
+ * @brief Mjoln EEPROM File System page-granular write-back cache
+ * @note Holds a few dirty pages so that writes landing on the same page are merged and the
+ * page is programmed once when it is flushed, instead of once per write.
+ * @note The cache only tracks pages; reading, filling and programming them is done by the caller.
+ */
+class FS_PageCache
+{
+public:
+    FS_PageCache();
+    ~FS_PageCache();
+
+    /**
+     * @brief Allocates the cache.
+     * @param pageCount Number of pages to hold.
+     * @param pageSize Size of an EEPROM page in bytes.
+     * @return true if the memory was allocated, false otherwise.
+     */
+    bool begin(uint8_t pageCount, uint16_t pageSize);
+
+    /**
+     * @brief Releases the cache memory. Dirty pages are discarded.
+     */
+    void end();
+
+    /**
+     * @brief Checks if the cache has been allocated.
+     */
+    bool isEnabled() const { return _pageCount > 0; }
+
+    /**
+     * @brief Finds the cached copy of a page.
+     * @param pageAddr Page aligned EEPROM address.
+     * @return Pointer to the cached page, or NULL if it is not cached.
+     */
+    FS_CachedPage *lookup(uint32_t pageAddr);
+
+    /**
+     * @brief Picks the slot to reuse for a new page: a free one, otherwise the least recently used.
+     * @note The caller must flush the returned page first if it is still dirty.
+     */
+    FS_CachedPage *victim();
+
+    /**
+     * @brief Claims a slot for a page whose contents are not known yet.
+     */
+    void assign(FS_CachedPage *page, uint32_t pageAddr);
+
+    /**
+     * @brief Records that [offset, offset + length) of the page was modified.
+     */
+    void markDirty(FS_CachedPage *page, uint16_t offset, uint16_t length);
+
+    /**
+     * @brief Marks a page as clean after it has been programmed.
+     */
+    void markClean(FS_CachedPage *page);
+
+    /**
+     * @brief Returns the dirty page with the lowest address, or NULL if every page is clean.
+     */
+    FS_CachedPage *nextDirty();
+
+    /**
+     * @brief Drops one cached page, dirty or not; its changes are never programmed.
+     */
+    void drop(FS_CachedPage *page);
+
+    /**
+     * @brief Drops every cached page, dirty or not.
+     */
+    void invalidate();
+
+    static bool isDirty(const FS_CachedPage *page) { return page->valid && page->dirtyEnd > page->dirtyStart; }
+
+    uint8_t pageCount() const { return _pageCount; }
+    uint16_t pageSize() const { return _pageSize; }
+    FS_CachedPage *page(uint8_t index) { return &_pages[index]; }
+
+private:
+    FS_CachedPage *_pages;
+    uint8_t *_memory;
+    uint8_t _pageCount;
+    uint16_t _pageSize;
+    uint32_t _useCounter;
+};
+
+#endif // __cplusplus
+#endif // FS_PAGECACHE_H
+       // This file defines the write-back page cache of the Mjoln EEPROM File System.
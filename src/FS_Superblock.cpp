@@ -0,0 +1,66 @@
+#include "FS_Superblock.h"
+#include "FS_Crc.h"
+#include "FS_Layout.h"
+
+// The on-disk layout of a superblock; each field starts where the previous one ends.
+static constexpr FS_Field superSequence = {0, 4};
+static constexpr FS_Field superLastDataAddr = fieldAfter(superSequence, 3);
+static constexpr FS_Field superFileCount = fieldAfter(superLastDataAddr, MJOLN_FILE_SYSTEM_FILE_COUNT_LENGTH);
+static constexpr FS_Field superDeleted = fieldAfter(superFileCount, 1);
+static constexpr FS_Field superBytesInUse = fieldAfter(superDeleted, 4);
+static constexpr FS_Field superAllocCursor = fieldAfter(superBytesInUse, 3);
+static constexpr FS_Field superFatCursor = fieldAfter(superAllocCursor, 2);
+static constexpr FS_Field superActiveFAT = fieldAfter(superFatCursor, 1);
+static constexpr FS_Field superSyncCount = fieldAfter(superActiveFAT, 1);
+static constexpr FS_Field superSyncList = fieldAfter(superSyncCount, 2 * MJOLN_FILE_SYSTEM_SYNC_ENTRIES);
+static constexpr FS_Field superFatChunks = fieldAfter(superSyncList, 1);
+static constexpr FS_Field superCrc = fieldAfter(superFatChunks, 2);
+
+static_assert(superBytesInUse.offset == 10 && superActiveFAT.offset == 19 && superSyncList.offset == 21 && superFatChunks.offset == 29,
+              "Superblock fields moved; existing volumes could no longer be read");
+static_assert(fieldEnd(superCrc) == MJOLN_FILE_SYSTEM_SUPERBLOCK_SIZE, "The superblock layout must fill MJOLN_FILE_SYSTEM_SUPERBLOCK_SIZE");
+
+// Returns the field of one syncList entry.
+static constexpr FS_Field syncEntry(uint8_t index)
+{
+    return FS_Field{(uint8_t)(superSyncList.offset + 2 * index), 2};
+}
+
+bool toSuperblock(const uint8_t *buffer, FS_Superblock &superblock, uint16_t generation)
+{
+    if (crc16(buffer, superCrc.offset, MJOLN_CRC16_INIT ^ generation) != getField(buffer, superCrc))
+        return false;
+
+    superblock.sequence = getField(buffer, superSequence);
+    memcpy(superblock.lastDataAddr, buffer + superLastDataAddr.offset, superLastDataAddr.length);
+    memcpy(superblock.fileCount, buffer + superFileCount.offset, superFileCount.length);
+    superblock.deleted = getField(buffer, superDeleted);
+    superblock.bytesInUse = getField(buffer, superBytesInUse);
+    memcpy(superblock.allocCursor, buffer + superAllocCursor.offset, superAllocCursor.length);
+    memcpy(superblock.fatCursor, buffer + superFatCursor.offset, superFatCursor.length);
+    superblock.activeFAT = getField(buffer, superActiveFAT);
+    superblock.syncCount = getField(buffer, superSyncCount);
+    for (uint8_t i = 0; i < MJOLN_FILE_SYSTEM_SYNC_ENTRIES; i++)
+        superblock.syncList[i] = getField(buffer, syncEntry(i));
+    superblock.fatChunks = getField(buffer, superFatChunks);
+    return true;
+}
+
+void superblockToBytes(const FS_Superblock &superblock, uint8_t *buffer, uint16_t generation)
+{
+    putField(buffer, superSequence, superblock.sequence);
+    memcpy(buffer + superLastDataAddr.offset, superblock.lastDataAddr, superLastDataAddr.length);
+    memcpy(buffer + superFileCount.offset, superblock.fileCount, superFileCount.length);
+    putField(buffer, superDeleted, superblock.deleted);
+    putField(buffer, superBytesInUse, superblock.bytesInUse);
+    memcpy(buffer + superAllocCursor.offset, superblock.allocCursor, superAllocCursor.length);
+    memcpy(buffer + superFatCursor.offset, superblock.fatCursor, superFatCursor.length);
+    putField(buffer, superActiveFAT, superblock.activeFAT);
+    putField(buffer, superSyncCount, superblock.syncCount);
+    for (uint8_t i = 0; i < MJOLN_FILE_SYSTEM_SYNC_ENTRIES; i++)
+        putField(buffer, syncEntry(i), superblock.syncList[i]);
+    putField(buffer, superFatChunks, superblock.fatChunks);
+
+    // Seeding the checksum with the generation keeps superblocks written before the last format from validating.
+    putField(buffer, superCrc, crc16(buffer, superCrc.offset, MJOLN_CRC16_INIT ^ generation));
+}
@@ -0,0 +1,54 @@
+#ifndef FS_SUPERBLOCK_H
+#define FS_SUPERBLOCK_H
+
+#include <Arduino.h>
+#include "MjolnConst.h"
+
+#ifdef __cplusplus
+
+#define MJOLN_FILE_SYSTEM_SUPERBLOCK_SIZE 32 // Bytes a superblock takes on the EEPROM
+#define MJOLN_FILE_SYSTEM_SYNC_ALL 0xFF      // syncCount value: every FAT entry may differ between the two copies
+
+/**
+ * @brief Mjoln EEPROM File System Superblock
+ * @note The superblock holds the part of the boot sector that changes with every file operation.
+ * @note Superblocks are written round-robin to a ring of page-sized slots after the boot sector. The valid
+ * slot with the highest sequence number is the current one, so each slot is programmed once per lap of the ring.
+ * @note It also selects which of the two FAT copies is current. An update writes its FAT entries to the other
+ * copy and then writes a superblock pointing at it, so a reset leaves either the old or the new state.
+ */
+struct FS_Superblock
+{
+    uint32_t sequence;                                      // Incremented on every write, selects the current slot
+    uint8_t lastDataAddr[3];                                // Last data address in EEPROM
+    uint8_t fileCount[MJOLN_FILE_SYSTEM_FILE_COUNT_LENGTH]; // Number of FAT entries in use
+    uint8_t deleted;                                        // Deleted count
+    uint32_t bytesInUse;                                    // Total bytes used from available storage space
+    uint8_t allocCursor[3];                                 // Where the next-fit allocator continues after a remount
+    uint8_t fatCursor[2];                                   // FAT index the search for a deleted entry continues from
+    uint8_t activeFAT;                                      // FAT copy holding the current entries
+    uint8_t syncCount;                                      // Entries in syncList, or MJOLN_FILE_SYSTEM_SYNC_ALL
+    uint16_t syncList[MJOLN_FILE_SYSTEM_SYNC_ENTRIES];      // Entries the other FAT copy is behind on
+    uint8_t fatChunks;                                      // Chunks the FAT has taken from the end of the volume
+};
+
+/**
+ * @brief Converts a byte buffer to a FS_Superblock structure.
+ * @param buffer Pointer to MJOLN_FILE_SYSTEM_SUPERBLOCK_SIZE bytes.
+ * @param superblock Structure to fill.
+ * @param generation Generation of the boot sector the superblock has to belong to.
+ * @return true if the checksum matches, false for a blank, partially written or earlier format's slot.
+ */
+bool toSuperblock(const uint8_t *buffer, FS_Superblock &superblock, uint16_t generation);
+
+/**
+ * @brief Converts a FS_Superblock structure to bytes, including its checksum.
+ * @param superblock The superblock to convert.
+ * @param buffer Pointer to MJOLN_FILE_SYSTEM_SUPERBLOCK_SIZE bytes.
+ * @param generation Generation of the boot sector, mixed into the checksum.
+ */
+void superblockToBytes(const FS_Superblock &superblock, uint8_t *buffer, uint16_t generation);
+
+#endif // __cplusplus
+#endif // FS_SUPERBLOCK_H
+       // This file defines the structure of the superblock of the Mjoln EEPROM File System.
@@ -0,0 +1,152 @@
+#include "FS_WriteQueue.h"
+
+FS_WriteQueue::FS_WriteQueue()
+    : _writes(NULL), _memory(NULL), _pageCount(0), _pageSize(0), _head(0), _count(0), _queued(0), _failed(false),
+      _ticketHead(0), _ticketCount(0), _ticketCounter(0)
+{
+}
+
+FS_WriteQueue::~FS_WriteQueue()
+{
+    end();
+}
+
+bool FS_WriteQueue::begin(uint8_t pageCount, uint16_t pageSize)
+{
+    end();
+
+    if (pageCount == 0 || pageSize == 0)
+        return false;
+
+    _writes = (FS_QueuedWrite *)malloc(pageCount * sizeof(FS_QueuedWrite));
+    _memory = (uint8_t *)malloc(pageCount * pageSize);
+
+    if (!_writes || !_memory)
+    {
+        end();
+        return false;
+    }
+
+    _pageCount = pageCount;
+    _pageSize = pageSize;
+    for (uint8_t i = 0; i < _pageCount; i++)
+        _writes[i].data = _memory + (i * pageSize);
+    return true;
+}
+
+void FS_WriteQueue::end()
+{
+    free(_writes);
+    free(_memory);
+    _writes = NULL;
+    _memory = NULL;
+    _pageCount = 0;
+    _pageSize = 0;
+    _head = 0;
+    _count = 0;
+    _queued = 0;
+    _failed = false;
+    _ticketHead = 0;
+    _ticketCount = 0;
+}
+
+bool FS_WriteQueue::push(uint32_t addr, const uint8_t *data, uint16_t length)
+{
+    // Merging into the newest entry keeps the order intact: nothing queued after it can be overtaken.
+    if (_count > 0)
+    {
+        FS_QueuedWrite *tail = &_writes[(_head + _count - 1) % _pageCount];
+        uint32_t pageAddr = tail->addr - tail->addr % _pageSize;
+        if (addr - addr % _pageSize == pageAddr && addr <= tail->addr + tail->length && addr + length >= tail->addr)
+        {
+            uint32_t start = min(addr, tail->addr);
+            uint32_t end = max(addr + length, tail->addr + tail->length);
+            if (data)
+                memcpy(tail->data + (addr - pageAddr), data, length);
+            else
+                memset(tail->data + (addr - pageAddr), 0xFF, length);
+            tail->addr = start;
+            tail->length = end - start;
+            return true;
+        }
+    }
+
+    if (_count == _pageCount)
+        return false;
+
+    // Entries keep their bytes at the page offset they belong to, so merging never moves data.
+    FS_QueuedWrite *write = &_writes[(_head + _count) % _pageCount];
+    write->addr = addr;
+    write->length = length;
+    write->sequence = ++_queued;
+    if (data)
+        memcpy(write->data + addr % _pageSize, data, length);
+    else
+        memset(write->data + addr % _pageSize, 0xFF, length);
+    _count++;
+    return true;
+}
+
+FS_QueuedWrite *FS_WriteQueue::front()
+{
+    return _count > 0 ? &_writes[_head] : NULL;
+}
+
+void FS_WriteQueue::pop(bool success)
+{
+    if (_count == 0)
+        return;
+
+    _failed |= !success;
+    _head = (_head + 1) % _pageCount;
+    _count--;
+}
+
+void FS_WriteQueue::advance(uint16_t length)
+{
+    if (_count == 0)
+        return;
+
+    // The bytes stay at their page offset, so only the range moves.
+    _writes[_head].addr += length;
+    _writes[_head].length -= length;
+}
+
+void FS_WriteQueue::overlay(uint32_t addr, uint8_t *buffer, uint16_t length)
+{
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        FS_QueuedWrite *write = &_writes[(_head + i) % _pageCount];
+        uint32_t from = max(write->addr, addr);
+        uint32_t to = min(write->addr + write->length, addr + length);
+        if (from < to)
+            memcpy(buffer + (from - addr), write->data + from % _pageSize, to - from);
+    }
+}
+
+void FS_WriteQueue::addTicket()
+{
+    if (_ticketCount == MJOLN_WRITE_QUEUE_TICKETS)
+    {
+        _tickets[(_ticketHead + _ticketCount - 1) % MJOLN_WRITE_QUEUE_TICKETS].sequence = _queued;
+        return;
+    }
+
+    FS_WriteTicket &ticket = _tickets[(_ticketHead + _ticketCount) % MJOLN_WRITE_QUEUE_TICKETS];
+    ticket.id = ++_ticketCounter;
+    ticket.sequence = _queued;
+    _ticketCount++;
+}
+
+bool FS_WriteQueue::takeCompletedTicket(uint32_t durable, uint32_t &id, bool &success)
+{
+    if (_ticketCount == 0 || (int32_t)(_tickets[_ticketHead].sequence - durable) > 0)
+        return false;
+
+    id = _tickets[_ticketHead].id;
+    success = !_failed;
+    _failed = false;
+    _ticketHead = (_ticketHead + 1) % MJOLN_WRITE_QUEUE_TICKETS;
+    _ticketCount--;
+    return true;
+}
@@ -0,0 +1,139 @@
+#ifndef FS_WRITEQUEUE_H
+#define FS_WRITEQUEUE_H
+
+#include <Arduino.h>
+#include "MjolnConst.h"
+
+#ifdef __cplusplus
+
+/**
+ * @brief Reports that a queued operation has reached the EEPROM.
+ * @param ticket The number lastTicket() returned after the operation was queued.
+ * @param success false if one of the page programs it depends on failed.
+ */
+typedef void (*FS_CompletionCallback)(uint32_t ticket, bool success);
+
+/**
+ * @brief A page program waiting in the write queue.
+ * @note The range never crosses a page boundary, so it lands on one chip. A page larger than the Wire buffer
+ * is sent in several transmissions, and the entry is advanced past each one.
+ */
+struct FS_QueuedWrite
+{
+    uint32_t addr;     // Volume address of the first byte
+    uint16_t length;   // Bytes to program
+    uint32_t sequence; // Position in the order the writes were queued
+    uint8_t *data;     // Bytes to program, pageSize bytes of room
+};
+
+/**
+ * @brief A ticket handed out for a queued operation.
+ */
+struct FS_WriteTicket
+{
+    uint32_t id;       // Number reported to the completion callback
+    uint32_t sequence; // Last queued write the operation depends on
+};
+
+/**
+ * @brief Mjoln EEPROM File System asynchronous write queue
+ * @note Page programs are kept in the order they were issued and leave the queue in that order, so the
+ * EEPROM goes through the same states as with blocking writes and a reset is survived the same way.
+ * @note A write to the page the last queued entry covers is merged into it when the ranges touch.
+ * @note The queue only tracks writes; programming them is done by the caller.
+ */
+class FS_WriteQueue
+{
+public:
+    FS_WriteQueue();
+    ~FS_WriteQueue();
+
+    /**
+     * @brief Allocates the queue.
+     * @param pageCount Number of page programs to hold.
+     * @param pageSize Size of an EEPROM page in bytes.
+     * @return true if the memory was allocated, false otherwise.
+     */
+    bool begin(uint8_t pageCount, uint16_t pageSize);
+
+    /**
+     * @brief Releases the queue memory. Queued writes are discarded.
+     */
+    void end();
+
+    /**
+     * @brief Checks if the queue has been allocated.
+     */
+    bool isEnabled() const { return _pageCount > 0; }
+
+    bool isEmpty() const { return _count == 0; }
+
+    /**
+     * @brief Queues a write.
+     * @param addr Volume address of the first byte.
+     * @param data Bytes to write, or NULL to write 0xFF.
+     * @param length Number of bytes; the range must not cross a page boundary.
+     * @return true if the write was queued, false if the queue is full and it has to be drained first.
+     */
+    bool push(uint32_t addr, const uint8_t *data, uint16_t length);
+
+    /**
+     * @brief Returns the oldest queued write, or NULL if the queue is empty.
+     */
+    FS_QueuedWrite *front();
+
+    /**
+     * @brief Removes the oldest queued write once it has been sent to the EEPROM.
+     * @param success false if programming it failed; the ticket covering it then reports failure.
+     */
+    void pop(bool success);
+
+    /**
+     * @brief Drops the first bytes of the oldest queued write once they have been sent to the EEPROM.
+     * @param length Bytes sent; must be fewer than the entry holds, the last transmission pops it instead.
+     */
+    void advance(uint16_t length);
+
+    /**
+     * @brief Lays the queued bytes over a buffer read from the EEPROM, oldest first.
+     */
+    void overlay(uint32_t addr, uint8_t *buffer, uint16_t length);
+
+    /**
+     * @brief Hands out a ticket that completes once everything queued so far is programmed.
+     * @note With MJOLN_WRITE_QUEUE_TICKETS tickets outstanding, the newest one is extended instead and its
+     * number is handed out again.
+     */
+    void addTicket();
+
+    /**
+     * @brief Takes the oldest ticket whose writes are all programmed.
+     * @param durable Sequence number up to which every write has finished its write cycle.
+     * @param id Set to the ticket number.
+     * @param success Set to false if one of the writes since the previous ticket failed.
+     * @return false if no ticket has completed.
+     */
+    bool takeCompletedTicket(uint32_t durable, uint32_t &id, bool &success);
+
+    bool hasTickets() const { return _ticketCount > 0; }
+    uint32_t lastTicket() const { return _ticketCounter; }
+    uint32_t queued() const { return _queued; }
+
+private:
+    FS_QueuedWrite *_writes;
+    uint8_t *_memory;
+    uint8_t _pageCount;
+    uint16_t _pageSize;
+    uint8_t _head;
+    uint8_t _count;
+    uint32_t _queued;
+    bool _failed;
+    FS_WriteTicket _tickets[MJOLN_WRITE_QUEUE_TICKETS];
+    uint8_t _ticketHead;
+    uint8_t _ticketCount;
+    uint32_t _ticketCounter;
+};
+
+#endif // __cplusplus
+#endif // FS_WRITEQUEUE_H
+       // This file defines the asynchronous write queue of the Mjoln EEPROM File System.
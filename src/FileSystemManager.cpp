@@ -1,109 +1,67 @@
 #include "FileSystemManager.h"
 
-bool eepromReadBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, uint8_t *buffer, uint16_t length, uint8_t pageSize)
+#if MJOLN_ENABLE_STATS
+FS_Stats mjolnStats = {0};
+#endif
+
+static FS_Geometry geometryOf(AT24CX_ADDR_SIZE addressSize, uint8_t pageSize)
 {
-    uint16_t bytesRead = 0;
-    while (length > 0)
-    {
-        uint16_t remainingPageSize = min(length, (uint16_t)(pageSize - (storeAddr % pageSize)));
-        Wire.beginTransmission(eepromAddr);
-        if (addressSize == AT24CX_16Bit)
-            Wire.write((storeAddr >> 8) & 0xFF);
-        Wire.write(storeAddr & 0xFF);
-        Wire.endTransmission();
-        Wire.requestFrom((int)eepromAddr, (int)remainingPageSize);
-        for (uint16_t i = 0; i < remainingPageSize && Wire.available(); i++)
-            buffer[bytesRead++] = Wire.read();
-        length -= remainingPageSize;
-        storeAddr += remainingPageSize;
-    }
-    return Wire.available() == 0;
+    FS_Geometry geometry = {pageSize, addressSize, 1, 1};
+    return geometry;
 }
 
-bool eepromWriteBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, const uint8_t *data, uint16_t length, uint8_t pageSize)
+bool eepromReadBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, uint8_t *buffer, uint16_t length)
 {
-    uint16_t bytesWrote = 0;
-    while (length > 0)
-    {
-        uint16_t remainingPageSize = min(length, (uint16_t)(pageSize - (storeAddr % pageSize)));
-        delay(5);
-        Wire.beginTransmission(eepromAddr);
-        if (addressSize == AT24CX_16Bit)
-            Wire.write((storeAddr >> 8) & 0xFF);
-        Wire.write(storeAddr & 0xFF);
-        for (uint16_t i = 0; i < remainingPageSize; i++)
-            Wire.write(data[bytesWrote++]);
-        length -= remainingPageSize;
-        storeAddr += remainingPageSize;
-        if (Wire.endTransmission() != 0)
-            return 0;
-    }
-    return true;
+    return eepromReadRange(geometryOf(addressSize, 0), eepromAddr, storeAddr, buffer, length);
 }
 
-void showMemoryDump(uint8_t eepromAddr, uint16_t start, uint16_t end, AT24CX_ADDR_SIZE addressSize, uint8_t pageSize)
+uint16_t eepromWriteChunk(uint32_t storeAddr, uint32_t length, AT24CX_ADDR_SIZE addressSize, uint8_t pageSize)
 {
-    for (uint16_t addr = start; addr < end; addr += pageSize)
-    {
-        printLogs("Addr " + String(addr) + " - " + String(addr + pageSize) + ": ");
-        Wire.beginTransmission(eepromAddr);
-        if (addressSize == AT24CX_16Bit)
-            Wire.write((addr >> 8) & 0xFF);
-        Wire.write(addr & 0xFF);
-        Wire.endTransmission();
-        Wire.requestFrom((int)eepromAddr, end - start);
-        for (uint16_t i = 0; i < pageSize; i++)
-            printLogs("0x" + String(Wire.read(), HEX) + ", ");
-        printLogs("\n");
-    }
+    return eepromWriteChunk(geometryOf(addressSize, pageSize), storeAddr, length);
 }
 
-bool eepromDeleteMemoryRange(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, uint16_t length, uint8_t pageSize)
+bool eepromWriteBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, const uint8_t *data, uint16_t length, uint8_t pageSize, bool waitForCompletion)
 {
-    uint16_t bytesWrote = 0;
-    while (length > 0)
-    {
-        uint16_t remainingPageSize = min(length, (uint16_t)(pageSize - (storeAddr % pageSize)));
-        delay(5);
-        Wire.beginTransmission(eepromAddr);
-        if (addressSize == AT24CX_16Bit)
-            Wire.write((storeAddr >> 8) & 0xFF);
-        Wire.write(storeAddr & 0xFF);
-        for (uint16_t i = 0; i < remainingPageSize; i++)
-            Wire.write(0xFF);
-        length -= remainingPageSize;
-        storeAddr += remainingPageSize;
-        if (Wire.endTransmission() != 0)
-            return false;
-    }
-    return true;
+    return eepromProgramRange(geometryOf(addressSize, pageSize), eepromAddr, storeAddr, data, length, waitForCompletion);
 }
 
-bool deletePartition(uint8_t eepromAddr, uint16_t length)
+bool eepromWaitForWriteCycle(uint8_t eepromAddr, uint32_t timeoutUs)
 {
-    printLogs("Deleting partition...\n\n|--------------------|\n ");
-    uint8_t progress = 0;
-    for (uint16_t addr = 0; addr < length - 64; addr += 64)
+    uint32_t start = micros();
+    while (true)
     {
+        // The EEPROM ignores its address while the internal write cycle runs, so the first ACK marks completion.
         Wire.beginTransmission(eepromAddr);
-        Wire.write((addr >> 8) & 0xFF);
-        Wire.write(addr & 0xFF);
-        for (uint16_t i = 0; i < 64; i++)
+        MJOLN_STAT_ADD(i2cTransactions, 1);
+        bool ready = Wire.endTransmission() == 0;
+        uint32_t waited = micros() - start;
+        if (ready || waited >= timeoutUs)
         {
-            Wire.write(0xFF);
+            MJOLN_STAT_ADD(writeWaitMicros, waited);
+            return ready;
         }
         yield();
-        if ((addr * 100) / length > progress)
+    }
+}
+
+void showMemoryDump(uint8_t eepromAddr, uint16_t start, uint16_t end, AT24CX_ADDR_SIZE addressSize)
+{
+    uint8_t buffer[MJOLN_COMPARE_CHUNK_BYTES];
+    for (uint16_t addr = start; addr < end; addr += sizeof(buffer))
+    {
+        printLogf("Addr %u - %u: ", addr, (unsigned int)(addr + sizeof(buffer)));
+        if (!eepromReadBytes(eepromAddr, addr, addressSize, buffer, sizeof(buffer)))
         {
-            progress = (addr * 100) / length;
-            if (progress % 5 == 0)
-                printLogs("=");
+            printLogf("read failed\n");
+            return;
         }
-        if (Wire.endTransmission() != 0)
-            return false;
-        delay(5);
+        for (uint16_t i = 0; i < sizeof(buffer); i++)
+            printLogf("0x%x, ", buffer[i]);
+        printLogf("\n");
     }
-    printLogs("=\n\n");
-    printLogs("Partition deleted successfully.\n");
-    return true;
+}
+
+bool eepromDeleteMemoryRange(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, uint32_t length, uint8_t pageSize, bool waitForCompletion)
+{
+    return eepromProgramRange(geometryOf(addressSize, pageSize), eepromAddr, storeAddr, (const uint8_t *)NULL, length, waitForCompletion);
 }
@@ -7,13 +7,52 @@
 #include <Wire.h>
 #include "Logger.h"
 #include "MjolnConst.h"
+#include "FS_ChipGeometry.h"
 
-enum AT24CX_ADDR_SIZE
+#ifndef MJOLN_I2C_BUFFER_LENGTH
+#if defined(I2C_BUFFER_LENGTH)
+#define MJOLN_I2C_BUFFER_LENGTH I2C_BUFFER_LENGTH // Size of the Wire transmit and receive buffers
+#elif defined(BUFFER_LENGTH)
+#define MJOLN_I2C_BUFFER_LENGTH BUFFER_LENGTH
+#else
+#define MJOLN_I2C_BUFFER_LENGTH 32
+#endif
+#endif
+
+#ifndef MJOLN_I2C_READ_CHUNK_SIZE
+#define MJOLN_I2C_READ_CHUNK_SIZE MJOLN_I2C_BUFFER_LENGTH // Largest read the Wire library can buffer
+#endif
+
+/**
+ * @brief Performance counters of the Mjoln EEPROM File System, see MjolnFileSystem::getStats().
+ * @note The counters are shared by every file system instance, as the bus is.
+ */
+struct FS_Stats
 {
-    AT24CX_8Bit = 0x00, // 8-bit address size
-    AT24CX_16Bit = 0x01 // 16-bit address size
+    uint32_t i2cTransactions;  // Addressed I2C transfers, write-cycle polls included
+    uint32_t bytesRead;        // Data bytes read from the EEPROM
+    uint32_t bytesWritten;     // Data bytes sent to the EEPROM
+    uint32_t pagePrograms;     // Write transfers carrying data, each one an internal write cycle
+    uint32_t writeWaitMicros;  // Time spent polling for write cycles to end
+    uint32_t fatReads;         // FAT entries read from the EEPROM rather than the FAT mirror
+    uint32_t lookupHits;       // File names resolved through the filename index
+    uint32_t lookupMisses;     // File names the index could not resolve: absent, or found by scanning the FAT
 };
 
+#if MJOLN_ENABLE_STATS
+extern FS_Stats mjolnStats;
+#define MJOLN_STAT_ADD(counter, amount) (mjolnStats.counter += (amount))
+#else
+#define MJOLN_STAT_ADD(counter, amount) ((void)0)
+#endif
+
+/**
+ * @brief Reports the progress of a long running operation.
+ * @param done Bytes processed so far.
+ * @param total Bytes the operation covers.
+ */
+typedef void (*FS_ProgressCallback)(uint32_t done, uint32_t total);
+
 /**
  * @brief Reads a specified number of bytes from the EEPROM.
  * @param eepromAddr The I2C address of the EEPROM.
@@ -21,11 +60,20 @@ enum AT24CX_ADDR_SIZE
  * @param addressSize The size of the address in bytes.
  * @param buffer Pointer to the buffer where the read data will be stored.
  * @param length The number of bytes to read.
- * @param pageSize The size of the EEPROM page.
- * @note The pageSize is used to determine the maximum number of bytes that can be read in a single operation.
+ * @note The range is addressed once and streamed sequentially in chunks of MJOLN_I2C_READ_CHUNK_SIZE; pages do not split reads.
  * @return true if the read operation was successful, false otherwise.
  */
-bool eepromReadBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, uint8_t *buffer, uint16_t length, uint8_t pageSize);
+bool eepromReadBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, uint8_t *buffer, uint16_t length);
+
+/**
+ * @brief Returns how many bytes from storeAddr on fit in one write transmission.
+ * @param storeAddr The address in the EEPROM the transmission starts at.
+ * @param length The number of bytes left to write.
+ * @param addressSize The size of the address in bytes.
+ * @param pageSize The size of the EEPROM page.
+ * @note A transmission stays within one page, and its data and word address together fit in MJOLN_I2C_BUFFER_LENGTH.
+ */
+uint16_t eepromWriteChunk(uint32_t storeAddr, uint32_t length, AT24CX_ADDR_SIZE addressSize, uint8_t pageSize);
 
 /**
  * @brief Writes a specified number of bytes to the EEPROM.
@@ -35,10 +83,13 @@ bool eepromReadBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE ad
  * @param data Pointer to the data to be written.
  * @param length The number of bytes to write.
  * @param pageSize The size of the EEPROM page.
- * @note The pageSize is used to determine the maximum number of bytes that can be written in a single operation.
+ * @param waitForCompletion When false, the write cycle of the last page is left running and the EEPROM has to be
+ * polled with eepromWaitForWriteCycle() before it is accessed again.
+ * @note Data is sent in transmissions of eepromWriteChunk() bytes, each one an internal write cycle. A page only
+ * takes one transmission when it fits in the Wire buffer with its word address.
  * @return true if the write operation was successful, false otherwise.
  */
-bool eepromWriteBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, const uint8_t *data, uint16_t length, uint8_t pageSize);
+bool eepromWriteBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, const uint8_t *data, uint16_t length, uint8_t pageSize, bool waitForCompletion = true);
 
 /**
  * @brief Deletes a specified number of bytes from the EEPROM.
@@ -47,18 +98,20 @@ bool eepromWriteBytes(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE a
  * @param addressSize The size of the address in bytes.
  * @param length The number of bytes to delete.
  * @param pageSize The size of the EEPROM page.
- * @note The pageSize is used to determine the maximum number of bytes that can be written in a single operation.
+ * @param waitForCompletion When false, the write cycle of the last page is left running, as with eepromWriteBytes().
+ * @note The range is sent in transmissions of eepromWriteChunk() bytes, as with eepromWriteBytes().
  * @return true if the delete operation was successful, false otherwise.
  */
-bool eepromDeleteMemoryRange(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, uint16_t length, uint8_t pageSize);
+bool eepromDeleteMemoryRange(uint8_t eepromAddr, uint32_t storeAddr, AT24CX_ADDR_SIZE addressSize, uint32_t length, uint8_t pageSize, bool waitForCompletion = true);
 
 /**
- * @brief Deletes all data in the EEPROM.
+ * @brief Waits for the EEPROM to finish its internal write cycle.
  * @param eepromAddr The I2C address of the EEPROM.
- * @param length The number of bytes to delete.
- * @return true if the delete operation was successful, false otherwise.
+ * @param timeoutUs The maximum time to wait in microseconds.
+ * @note The device NACKs its address until the cycle ends, so it is polled instead of sleeping for the worst case tWR.
+ * @return true once the device acknowledges, false if it stayed busy past the timeout.
  */
-bool deletePartition(uint8_t eepromAddr, uint16_t length);
+bool eepromWaitForWriteCycle(uint8_t eepromAddr, uint32_t timeoutUs = MJOLN_WRITE_CYCLE_TIMEOUT_US);
 
 /**
  * @brief Prints the raw data in the eeprom over the start and end addresses specified.
@@ -66,10 +119,96 @@ bool deletePartition(uint8_t eepromAddr, uint16_t length);
  * @param start The starting address in the EEPROM.
  * @param end The address to which memory dump should be printed.
  * @param addressSize The size of the address in bytes.
- * @param pageSize The size of the EEPROM page.
- * @note The pageSize is used to determine the maximum number of bytes that can be written in a single operation.
  */
-void showMemoryDump(uint8_t eepromAddr, uint16_t start, uint16_t end, AT24CX_ADDR_SIZE addressSize, uint8_t pageSize);
+void showMemoryDump(uint8_t eepromAddr, uint16_t start, uint16_t end, AT24CX_ADDR_SIZE addressSize);
+
+/**
+ * @brief Starts a transmission to the EEPROM and sends the word address of storeAddr.
+ * @param geometry FS_Geometry, or FS_FixedGeometry for an address size known at compile time.
+ * @return The I2C address the transmission went to; 8-bit parts take the block bits in it.
+ */
+template <class Geometry>
+uint8_t eepromBeginTransmission(const Geometry &geometry, uint8_t eepromAddr, uint32_t storeAddr)
+{
+    // Parts with 8-bit word addresses take the bits above them from the device address, one per 256-byte block.
+    uint8_t deviceAddr = eepromAddr;
+    if (geometry.addressSize() == AT24CX_8Bit)
+        deviceAddr |= (storeAddr >> 8) & MJOLN_BLOCK_SELECT_MASK;
+
+    Wire.beginTransmission(deviceAddr);
+    if (geometry.addressSize() == AT24CX_16Bit)
+        Wire.write((storeAddr >> 8) & 0xFF);
+    Wire.write(storeAddr & 0xFF);
+    return deviceAddr;
+}
+
+/**
+ * @brief eepromWriteChunk() for a geometry that may be known at compile time.
+ */
+template <class Geometry>
+uint16_t eepromWriteChunk(const Geometry &geometry, uint32_t storeAddr, uint32_t length)
+{
+    // The word address shares the Wire buffer with the data; bytes past its end would be dropped silently.
+    uint16_t room = MJOLN_I2C_BUFFER_LENGTH - (geometry.addressSize() == AT24CX_16Bit ? 2 : 1);
+    return min(min(length, (uint32_t)(geometry.pageSize() - storeAddr % geometry.pageSize())), (uint32_t)room);
+}
+
+/**
+ * @brief eepromReadBytes() for a geometry that may be known at compile time.
+ */
+template <class Geometry>
+bool eepromReadRange(const Geometry &geometry, uint8_t eepromAddr, uint32_t storeAddr, uint8_t *buffer, uint16_t length)
+{
+    if (length == 0)
+        return true;
+
+    // Reads are not limited by page boundaries: once addressed, the EEPROM keeps streaming from its internal
+    // address counter, so only the Wire buffer size splits the transfer.
+    uint8_t deviceAddr = eepromBeginTransmission(geometry, eepromAddr, storeAddr);
+    MJOLN_STAT_ADD(i2cTransactions, 1);
+    if (Wire.endTransmission() != 0)
+        return false;
+
+    uint16_t bytesRead = 0;
+    while (length > 0)
+    {
+        uint16_t chunkSize = min(length, (uint16_t)MJOLN_I2C_READ_CHUNK_SIZE);
+        MJOLN_STAT_ADD(i2cTransactions, 1);
+        if (Wire.requestFrom((int)deviceAddr, (int)chunkSize) != chunkSize)
+            return false;
+        MJOLN_STAT_ADD(bytesRead, chunkSize);
+        for (uint16_t i = 0; i < chunkSize; i++)
+            buffer[bytesRead++] = Wire.read();
+        length -= chunkSize;
+    }
+    return true;
+}
+
+/**
+ * @brief eepromWriteBytes() and eepromDeleteMemoryRange() for a geometry that may be known at compile time.
+ * @param data Bytes to program, or NULL to program 0xFF.
+ */
+template <class Geometry>
+bool eepromProgramRange(const Geometry &geometry, uint8_t eepromAddr, uint32_t storeAddr, const uint8_t *data, uint32_t length, bool waitForCompletion)
+{
+    while (length > 0)
+    {
+        uint16_t chunk = eepromWriteChunk(geometry, storeAddr, length);
+        uint8_t deviceAddr = eepromBeginTransmission(geometry, eepromAddr, storeAddr);
+        for (uint16_t i = 0; i < chunk; i++)
+            Wire.write(data ? *data++ : 0xFF);
+        length -= chunk;
+        storeAddr += chunk;
+        MJOLN_STAT_ADD(i2cTransactions, 1);
+        if (Wire.endTransmission() != 0)
+            return false;
+        MJOLN_STAT_ADD(bytesWritten, chunk);
+        MJOLN_STAT_ADD(pagePrograms, 1);
+        if ((length > 0 || waitForCompletion) && !eepromWaitForWriteCycle(deviceAddr))
+            return false;
+    }
+    return true;
+}
 
 #endif // __cplusplus
 #endif // FILESYSTEM_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include "MjolnFS.h"
+
+static bool testBit(const uint8_t *bits, uint16_t index)
+{
+    return bits[index >> 3] & (1 << (index & 7));
+}
+
+static void setBit(uint8_t *bits, uint16_t index)
+{
+    bits[index >> 3] |= 1 << (index & 7);
+}
+
+bool MjolnFileSystem::fsck(uint32_t budgetMs)
+{
+    uint32_t start = millis();
+    while (fsckStep())
+    {
+        if (millis() - start >= budgetMs)
+            return true;
+        yield();
+    }
+    return false;
+}
+
+bool MjolnFileSystem::needsFsck()
+{
+    return _fatDamaged;
+}
+
+FS_FsckReport MjolnFileSystem::getFsckReport()
+{
+    return _fsckReport;
+}
+
+bool MjolnFileSystem::fsckStep()
+{
+    if (!isFileSystemInitialized())
+        return false;
+    // Repairs are committed through the superblock, which would publish a half-done move or update with them.
+    abortCompaction();
+    discardFATChanges();
+
+    // Whatever changed since the check began may have changed what it found, so it starts over.
+    if (_fsck.phase == FS_FSCK_IDLE || _fsck.sequence != _superblock.sequence)
+        startFsck();
+
+    if (_fsck.phase == FS_FSCK_COUNTERS)
+    {
+        checkCounters();
+        _fsck.phase = FS_FSCK_IDLE;
+        return false;
+    }
+
+    if (_fsck.index > _fatEntryCount)
+    {
+        _fsck.phase = (FS_FsckPhase)(_fsck.phase + 1);
+        _fsck.index = 1;
+        return true;
+    }
+
+    bool checked = true;
+    switch (_fsck.phase)
+    {
+    case FS_FSCK_ENTRIES:
+        checked = checkFATCopies(_fsck.index);
+        break;
+    case FS_FSCK_CHAINS:
+        checked = checkChain(_fsck.index);
+        break;
+    case FS_FSCK_ORPHANS:
+        checked = checkOrphan(_fsck.index);
+        break;
+    case FS_FSCK_OVERLAPS:
+        checkOverlaps(_fsck.index);
+        break;
+    default:
+        break;
+    }
+    if (!checked)
+    {
+        MJOLN_LOG_ERROR("File system check stopped.\n");
+        _fsck.phase = FS_FSCK_IDLE;
+        return false;
+    }
+    _fsck.index++;
+    return true;
+}
+
+void MjolnFileSystem::startFsck()
+{
+    memset(&_fsck, 0, sizeof(_fsck));
+    memset(&_fsckReport, 0, sizeof(_fsckReport));
+    _fsck.phase = FS_FSCK_ENTRIES;
+    _fsck.index = 1;
+    _fsck.sequence = _superblock.sequence;
+}
+
+bool MjolnFileSystem::commitFsckRepair()
+{
+    if (!writeSuperblock())
+    {
+        MJOLN_LOG_ERROR("Failed to write superblock.\n");
+        reloadMetadata();
+        return false;
+    }
+    _fsck.sequence = _superblock.sequence;
+    return true;
+}
+
+bool MjolnFileSystem::checkFATCopies(uint16_t index)
+{
+    _fsckReport.entriesChecked++;
+    uint8_t inactive = (_activeFAT + 1) % MJOLN_FILE_SYSTEM_FAT_COUNT;
+    uint8_t active[MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE];
+    uint8_t twin[MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE];
+    if (!storageRead(fatEntryAddress(index, _activeFAT), active, sizeof(active)) ||
+        !storageRead(fatEntryAddress(index, inactive), twin, sizeof(twin)))
+        return false;
+
+    bool activeGood = fatEntryIntact(active) && validFATEntry(index, toFATEntry(active));
+    bool twinGood = fatEntryIntact(twin) && validFATEntry(index, toFATEntry(twin));
+    // A copy that is behind is brought up to date by the next commit anyway and cannot stand in for the other.
+    bool inSync = !testBit(_fatStale, index);
+
+    if (activeGood)
+    {
+        if (!inSync || (twinGood && memcmp(active, twin, sizeof(active)) == 0))
+            return true;
+        if (!storageWrite(fatEntryAddress(index, inactive), active, sizeof(active)) || !completeOperation())
+            return false;
+        _fsckReport.repaired++;
+        return true;
+    }
+
+    if (inSync && twinGood)
+    {
+        // Reads already fall back to the twin, so only the damaged bytes need replacing.
+        if (!storageWrite(fatEntryAddress(index, _activeFAT), twin, sizeof(twin)) || !completeOperation())
+            return false;
+        _fsckReport.repaired++;
+        return true;
+    }
+
+    // Reads have treated the entry as free since it was found damaged; the FAT is made to say so.
+    MJOLN_LOG_WARN("Dropping FAT entry %u.\n", index);
+    if (!updateFATEntry(index, FS_FATEntry()) || !commitFsckRepair())
+        return false;
+    _fsckReport.dropped++;
+    return true;
+}
+
+bool MjolnFileSystem::checkChain(uint16_t index)
+{
+    FS_FATEntry entry = readFATEntry(index);
+    if (entry.status != MJOLN_FILE_SYSTEM_FAT_AVAILABLE)
+        return true;
+
+    _fsck.files++;
+    _fsck.bytesInUse += entry.size[0] | (entry.size[1] << 8) | (entry.size[2] << 16);
+
+    // Every link is reached once, so a loop or a link shared with another file shows up as one already seen.
+    uint16_t prevIndex = index;
+    FS_FATEntry prev = entry;
+    while (prev.link != MJOLN_FILE_NOT_FOUND)
+    {
+        uint16_t link = prev.link;
+        FS_FATEntry next = readFATEntry(link);
+        if (link > _fatEntryCount || next.status != MJOLN_FILE_SYSTEM_FAT_LINK || testBit(_fsck.linked, link) ||
+            strncmp(next.filename, entry.filename, MJOLN_FILE_NAME_MAX_LENGTH - 1) != 0)
+        {
+            // The file keeps the extents up to here; the rest is freed as orphans if nothing else reaches it.
+            MJOLN_LOG_WARN("Cutting the link chain of %s.\n", entry.filename);
+            prev.link = MJOLN_FILE_NOT_FOUND;
+            if (!updateFATEntry(prevIndex, prev) || !commitFsckRepair())
+                return false;
+            forgetTail(index);
+            _fsckReport.brokenChains++;
+            return true;
+        }
+        setBit(_fsck.linked, link);
+        _fsck.bytesInUse += next.size[0] | (next.size[1] << 8) | (next.size[2] << 16);
+        prevIndex = link;
+        prev = next;
+    }
+    return true;
+}
+
+bool MjolnFileSystem::checkOrphan(uint16_t index)
+{
+    FS_FATEntry entry = readFATEntry(index);
+    if (entry.status != MJOLN_FILE_SYSTEM_FAT_LINK || testBit(_fsck.linked, index))
+        return true;
+
+    MJOLN_LOG_WARN("Freeing orphaned FAT entry %u.\n", index);
+    entry.status = MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE;
+    if (!updateFATEntry(index, entry) || !commitFsckRepair())
+        return false;
+    _fsckReport.orphanLinks++;
+    return true;
+}
+
+void MjolnFileSystem::checkOverlaps(uint16_t index)
+{
+    FS_FATEntry entry = readFATEntry(index);
+    uint32_t start = entry.startAddr[0] | (entry.startAddr[1] << 8) | (entry.startAddr[2] << 16);
+    uint32_t end = start + (entry.size[0] | (entry.size[1] << 8) | (entry.size[2] << 16));
+    if (entry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE || end == start)
+        return;
+
+    // Each pair is compared once, from its lower index.
+    for (uint16_t i = index + 1; i <= _fatEntryCount; i++)
+    {
+        FS_FATEntry other = readFATEntry(i);
+        uint32_t otherStart = other.startAddr[0] | (other.startAddr[1] << 8) | (other.startAddr[2] << 16);
+        uint32_t otherEnd = otherStart + (other.size[0] | (other.size[1] << 8) | (other.size[2] << 16));
+        if (other.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE || otherEnd == otherStart)
+            continue;
+        if (start < otherEnd && otherStart < end)
+        {
+            MJOLN_LOG_WARN("FAT entries %u and %u overlap.\n", index, i);
+            _fsckReport.overlaps++;
+        }
+    }
+}
+
+bool MjolnFileSystem::checkCounters()
+{
+    if (_bootSector.bytesInUse != _fsck.bytesInUse)
+    {
+        MJOLN_LOG_INFO("Correcting bytes in use from %lu to %lu.\n", (unsigned long)_bootSector.bytesInUse, (unsigned long)_fsck.bytesInUse);
+        _bootSector.bytesInUse = _fsck.bytesInUse;
+        if (!commitFsckRepair())
+            return false;
+        _fsckReport.countersFixed = true;
+    }
+
+    // Entries changed under the free space map and the filename index, so both are rebuilt from the FAT.
+    if (_fsckReport.dropped > 0 || _fsckReport.brokenChains > 0 || _fsckReport.orphanLinks > 0)
+        runInitialIndexingAndStore();
+    else
+        _liveFileCount = _fsck.files;
+
+    _fsckReport.complete = true;
+    _fatDamaged = false;
+    return true;
+}
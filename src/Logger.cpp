@@ -1,9 +1,17 @@
 #include "Logger.h"
+#include <stdarg.h>
 
-bool logEnabled = true; // Flag to control logging
+void printLogf(const char *format, ...)
+{
+    char line[MJOLN_LOG_LINE_SIZE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    Serial.print(line);
+}
 
-void printLogs(String message)
+void printLogData(const void *data, size_t length)
 {
-    if (logEnabled)
-        Serial.print(message);
-}
\ No newline at end of file
+    Serial.write((const uint8_t *)data, length);
+}
@@ -4,9 +4,74 @@
 
 #include <Arduino.h>
 
-extern bool logEnabled; // Flag to control logging
+#define MJOLN_LOG_LEVEL_NONE 0  // No messages at all
+#define MJOLN_LOG_LEVEL_ERROR 1 // Operations that failed
+#define MJOLN_LOG_LEVEL_WARN 2  // Damage found and worked around
+#define MJOLN_LOG_LEVEL_INFO 3  // Mount, format and repair progress
+#define MJOLN_LOG_LEVEL_DEBUG 4 // Per-operation detail
 
-void printLogs(String message);
+// Messages above this level are not compiled in; define it before including the library to trim the build.
+#ifndef MJOLN_LOG_LEVEL
+#define MJOLN_LOG_LEVEL MJOLN_LOG_LEVEL_DEBUG
+#endif
+
+#ifndef MJOLN_LOG_LINE_SIZE
+#define MJOLN_LOG_LINE_SIZE 96 // Longest formatted line, held on the stack; longer lines are cut
+#endif
+
+/**
+ * @brief Formats a message printf-style and prints it to Serial.
+ * @param format The printf format string.
+ * @note The line is formatted into a stack buffer, so nothing is allocated. Floats are not
+ *       supported by every core's printf and should be printed as scaled integers.
+ */
+void printLogf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Prints raw bytes to Serial as they are.
+ * @param data The bytes to print.
+ * @param length The number of bytes.
+ */
+void printLogData(const void *data, size_t length);
+
+// True when a message of the given level is compiled in and the enabled flag is set; the flag is
+// only read for levels that are compiled in, so a block guarded by it folds away otherwise.
+#define MJOLN_LOG_ACTIVE(level, enabled) ((level) <= MJOLN_LOG_LEVEL && (enabled))
+
+// The arguments are only evaluated when the message is printed.
+#define MJOLN_LOG_AT(level, enabled, ...)        \
+    do                                           \
+    {                                            \
+        if (MJOLN_LOG_ACTIVE(level, enabled))    \
+            printLogf(__VA_ARGS__);              \
+    } while (0)
+
+// Leveled messages for MjolnFileSystem members, gated on the instance's own flag.
+#define MJOLN_LOGGING(level) MJOLN_LOG_ACTIVE(level, _logEnabled)
+
+#if MJOLN_LOG_LEVEL >= MJOLN_LOG_LEVEL_ERROR
+#define MJOLN_LOG_ERROR(...) MJOLN_LOG_AT(MJOLN_LOG_LEVEL_ERROR, _logEnabled, __VA_ARGS__)
+#else
+#define MJOLN_LOG_ERROR(...) ((void)0)
+#endif
+
+#if MJOLN_LOG_LEVEL >= MJOLN_LOG_LEVEL_WARN
+#define MJOLN_LOG_WARN(...) MJOLN_LOG_AT(MJOLN_LOG_LEVEL_WARN, _logEnabled, __VA_ARGS__)
+#else
+#define MJOLN_LOG_WARN(...) ((void)0)
+#endif
+
+#if MJOLN_LOG_LEVEL >= MJOLN_LOG_LEVEL_INFO
+#define MJOLN_LOG_INFO(...) MJOLN_LOG_AT(MJOLN_LOG_LEVEL_INFO, _logEnabled, __VA_ARGS__)
+#else
+#define MJOLN_LOG_INFO(...) ((void)0)
+#endif
+
+#if MJOLN_LOG_LEVEL >= MJOLN_LOG_LEVEL_DEBUG
+#define MJOLN_LOG_DEBUG(...) MJOLN_LOG_AT(MJOLN_LOG_LEVEL_DEBUG, _logEnabled, __VA_ARGS__)
+#else
+#define MJOLN_LOG_DEBUG(...) ((void)0)
+#endif
 
 #endif // __cplusplus
-       // This file defines the logging functionality for the Mjoln EEPROM File System.
\ No newline at end of file
+       // This file defines the logging functionality for the Mjoln EEPROM File System.
@@ -0,0 +1,373 @@
+#include "MjolnFS.h"
+
+static bool testBit(const uint8_t *bits, uint16_t index)
+{
+    return bits[index >> 3] & (1 << (index & 7));
+}
+
+static void setBit(uint8_t *bits, uint16_t index)
+{
+    bits[index >> 3] |= 1 << (index & 7);
+}
+
+static bool sameFATEntry(const FS_FATEntry &a, const FS_FATEntry &b)
+{
+    return memcmp(a.startAddr, b.startAddr, MJOLN_FILE_SYSTEM_START_ADDR_SIZE) == 0 &&
+           memcmp(a.size, b.size, MJOLN_FILE_SYSTEM_FILE_SIZE) == 0 &&
+           strncmp(a.filename, b.filename, MJOLN_FILE_NAME_MAX_LENGTH - 1) == 0 &&
+           a.link == b.link && a.status == b.status && a.recordSize == b.recordSize &&
+           a.flags == b.flags;
+}
+
+uint32_t MjolnFileSystem::superblockAddress(uint8_t slot)
+{
+    // Each slot starts on its own page, so writing one never reprograms the boot sector or a neighbouring slot.
+    uint16_t pageSize = getPageSize();
+    uint32_t ringStart = (MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE + pageSize - 1) / pageSize * pageSize;
+    uint32_t slotSize = (MJOLN_FILE_SYSTEM_SUPERBLOCK_SIZE + pageSize - 1) / pageSize * pageSize;
+    return ringStart + slot * slotSize;
+}
+
+uint16_t MjolnFileSystem::fatChunkCopySize()
+{
+    // Each copy of a chunk fills whole pages, so the two copies never share a page. Page sizes are multiples
+    // of 8 bytes, so three pages hold a whole number of entries and the chunk grows with the chip.
+    return MJOLN_FILE_SYSTEM_FAT_CHUNK_PAGES * getPageSize();
+}
+
+uint16_t MjolnFileSystem::fatChunkEntries()
+{
+    return fatChunkCopySize() / MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE;
+}
+
+uint32_t MjolnFileSystem::dataStart()
+{
+    return superblockAddress(_bootSector.superblockSlots);
+}
+
+uint32_t MjolnFileSystem::dataEnd()
+{
+    return _eepromSize - (uint32_t)_fatChunks * MJOLN_FILE_SYSTEM_FAT_COUNT * fatChunkCopySize();
+}
+
+uint16_t MjolnFileSystem::fatCapacity()
+{
+    return min((uint32_t)_fatChunks * fatChunkEntries(), (uint32_t)_bootSector.fatLimit);
+}
+
+bool MjolnFileSystem::growFAT()
+{
+    if (fatCapacity() >= _bootSector.fatLimit || _fatChunks == 0xFF)
+    {
+        MJOLN_LOG_ERROR("The FAT is full, %u entries.\n", _bootSector.fatLimit);
+        return false;
+    }
+    // The chunk comes off the end of the data area, so it has to be free; compaction moves data away from there.
+    if (!_allocator.shrink(MJOLN_FILE_SYSTEM_FAT_COUNT * fatChunkCopySize()))
+    {
+        MJOLN_LOG_ERROR("No free space at the end of the volume to grow the FAT.\n");
+        return false;
+    }
+    // The next superblock records the new chunk; until then the space is unused data area on the EEPROM, and
+    // discardFATChanges() hands it back if the update fails.
+    _fatChunks++;
+    return true;
+}
+
+uint32_t MjolnFileSystem::fatEntryAddress(uint16_t index, uint8_t copy)
+{
+    // Chunks are stacked downwards from the end of the volume and hold both copies of a run of entries,
+    // so the FAT grows without moving the entries it has. Entries are numbered from 1.
+    uint16_t perChunk = fatChunkEntries();
+    uint16_t chunk = (index - 1) / perChunk;
+    uint32_t chunkStart = _eepromSize - (uint32_t)(chunk + 1) * MJOLN_FILE_SYSTEM_FAT_COUNT * fatChunkCopySize();
+    return chunkStart + (uint32_t)copy * fatChunkCopySize() + (uint32_t)((index - 1) % perChunk) * MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE;
+}
+
+uint8_t MjolnFileSystem::superblockSlotsFor(bool wearLeveling)
+{
+    // Two slots are the minimum: the previous superblock stays intact while the next one is written.
+    if (!wearLeveling)
+        return 2;
+
+    // The ring never takes more than a sixteenth of the volume away from the data.
+    uint8_t slots = MJOLN_FILE_SYSTEM_SUPERBLOCK_SLOTS;
+    while (slots > 2 && superblockAddress(slots) > _eepromSize / 16)
+        slots--;
+    return slots;
+}
+
+bool MjolnFileSystem::loadSuperblock()
+{
+    bool found = false;
+    FS_Superblock candidate;
+    uint8_t buffer[MJOLN_FILE_SYSTEM_SUPERBLOCK_SIZE];
+    for (uint8_t slot = 0; slot < _bootSector.superblockSlots; slot++)
+    {
+        if (!storageRead(superblockAddress(slot), buffer, sizeof(buffer)) || !toSuperblock(buffer, candidate, _bootSector.generation))
+            continue;
+
+        // Compared as a difference so the ring keeps working when the sequence number wraps.
+        if (!found || (int32_t)(candidate.sequence - _superblock.sequence) > 0)
+        {
+            _superblock = candidate;
+            _superblockSlot = slot;
+            found = true;
+        }
+    }
+    if (!found || _superblock.activeFAT >= MJOLN_FILE_SYSTEM_FAT_COUNT ||
+        (uint32_t)_superblock.fatChunks * MJOLN_FILE_SYSTEM_FAT_COUNT * fatChunkCopySize() > _eepromSize - dataStart())
+        return false;
+
+    memcpy(_bootSector.lastDataAddr, _superblock.lastDataAddr, 3);
+    memcpy(_bootSector.fileCount, _superblock.fileCount, MJOLN_FILE_SYSTEM_FILE_COUNT_LENGTH);
+    _bootSector.deleted = _superblock.deleted;
+    _bootSector.bytesInUse = _superblock.bytesInUse;
+    _fatChunks = _superblock.fatChunks;
+
+    _activeFAT = _superblock.activeFAT;
+    memset(_fatPending, 0, sizeof(_fatPending));
+    _fatPendingAny = false;
+    if (_superblock.syncCount == MJOLN_FILE_SYSTEM_SYNC_ALL)
+        memset(_fatStale, 0xFF, sizeof(_fatStale));
+    else
+    {
+        memset(_fatStale, 0, sizeof(_fatStale));
+        for (uint8_t i = 0; i < _superblock.syncCount && i < MJOLN_FILE_SYSTEM_SYNC_ENTRIES; i++)
+            if (_superblock.syncList[i] < MJOLN_FILE_SYSTEM_FAT_BITMAP_BYTES * 8)
+                setBit(_fatStale, _superblock.syncList[i]);
+    }
+    return true;
+}
+
+bool MjolnFileSystem::writeSuperblock()
+{
+    // The entries changed by this update are already in the inactive copy. Once the rest of that copy has
+    // caught up, pointing the superblock at it publishes the whole update at once.
+    bool flip = _fatPendingAny;
+    if (flip && !syncInactiveFAT())
+        return false;
+
+    FS_Superblock superblock;
+    superblock.sequence = _superblock.sequence + 1;
+    memcpy(superblock.lastDataAddr, _bootSector.lastDataAddr, 3);
+    memcpy(superblock.fileCount, _bootSector.fileCount, MJOLN_FILE_SYSTEM_FILE_COUNT_LENGTH);
+    superblock.deleted = _bootSector.deleted;
+    superblock.bytesInUse = _bootSector.bytesInUse;
+    uint32_t cursor = _allocator.cursor();
+    superblock.allocCursor[0] = cursor & 0xFF;
+    superblock.allocCursor[1] = (cursor >> 8) & 0xFF;
+    superblock.allocCursor[2] = (cursor >> 16) & 0xFF;
+    superblock.fatCursor[0] = _fatCursor & 0xFF;
+    superblock.fatCursor[1] = (_fatCursor >> 8) & 0xFF;
+    superblock.activeFAT = flip ? (_activeFAT + 1) % MJOLN_FILE_SYSTEM_FAT_COUNT : _activeFAT;
+    superblock.fatChunks = _fatChunks;
+
+    // After a flip the copy that was current lacks exactly the entries of this update.
+    const uint8_t *stale = flip ? _fatPending : _fatStale;
+    superblock.syncCount = 0;
+    memset(superblock.syncList, 0, sizeof(superblock.syncList));
+    for (uint16_t i = 1; i <= _fatEntryCount && superblock.syncCount != MJOLN_FILE_SYSTEM_SYNC_ALL; i++)
+    {
+        if (!testBit(stale, i))
+            continue;
+        if (superblock.syncCount == MJOLN_FILE_SYSTEM_SYNC_ENTRIES)
+            superblock.syncCount = MJOLN_FILE_SYSTEM_SYNC_ALL;
+        else
+            superblock.syncList[superblock.syncCount++] = i;
+    }
+
+    // The slot after the current one is overwritten, so the current state stays readable until the write completes.
+    uint8_t slot = (_superblockSlot + 1) % _bootSector.superblockSlots;
+    // Writes leave write cycles running; a blocking commit returns once all of them ended, a queued one
+    // hands out the ticket that reports when they have.
+    // The write cache would program its pages in eviction order, so everything the superblock points to is
+    // sent ahead of it and the superblock itself right after it, never held back behind a later update.
+    uint8_t buffer[MJOLN_FILE_SYSTEM_SUPERBLOCK_SIZE];
+    superblockToBytes(superblock, buffer, _bootSector.generation);
+    if (!flushWriteCache() || !storageWrite(superblockAddress(slot), buffer, sizeof(buffer)) || !flushWriteCache() ||
+        !completeOperation())
+        return false;
+
+    _superblock = superblock;
+    _superblockSlot = slot;
+    if (flip)
+    {
+        _activeFAT = superblock.activeFAT;
+        memcpy(_fatStale, _fatPending, sizeof(_fatStale));
+        memset(_fatPending, 0, sizeof(_fatPending));
+        _fatPendingAny = false;
+    }
+    return true;
+}
+
+bool MjolnFileSystem::syncInactiveFAT()
+{
+    uint8_t inactive = (_activeFAT + 1) % MJOLN_FILE_SYSTEM_FAT_COUNT;
+    for (uint16_t i = 1; i <= _fatEntryCount; i++)
+    {
+        if (!testBit(_fatStale, i) || testBit(_fatPending, i))
+            continue;
+
+        // A failed read must stop the sync; readFATEntry() would hand back a free entry to copy over the file.
+        uint8_t buffer[MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE];
+        FS_FATEntry current;
+        if (i < _fatMirrorSize)
+            current = _fatMirror[i];
+        else if (storageRead(fatEntryAddress(i, _activeFAT), buffer, sizeof(buffer)))
+            current = decodeFATEntry(i, _activeFAT, buffer);
+        else
+            return false;
+
+        // Entries that happen to match already, which is common after a full resync request, are not rewritten.
+        if (!storageRead(fatEntryAddress(i, inactive), buffer, sizeof(buffer)))
+            return false;
+        if (!fatEntryIntact(buffer) || !sameFATEntry(current, toFATEntry(buffer)))
+        {
+            fatToBytes(current, buffer);
+            if (!storageWrite(fatEntryAddress(i, inactive), buffer, sizeof(buffer)))
+                return false;
+        }
+        _fatStale[i >> 3] &= ~(1 << (i & 7));
+    }
+    return true;
+}
+
+void MjolnFileSystem::discardFATChanges()
+{
+    // Chunks the FAT took for an update that never committed go back to the data area.
+    if (_fatChunks > _superblock.fatChunks)
+    {
+        _allocator.grow((uint32_t)(_fatChunks - _superblock.fatChunks) * MJOLN_FILE_SYSTEM_FAT_COUNT * fatChunkCopySize());
+        _fatChunks = _superblock.fatChunks;
+    }
+    if (!_fatPendingAny)
+        return;
+
+    // The inactive copy now differs from the current one wherever the abandoned update wrote.
+    for (uint8_t i = 0; i < sizeof(_fatStale); i++)
+        _fatStale[i] |= _fatPending[i];
+    memset(_fatPending, 0, sizeof(_fatPending));
+    _fatPendingAny = false;
+    if (_fatMirrorEnabled)
+        loadFATMirror();
+}
+
+bool MjolnFileSystem::reloadMetadata()
+{
+    // Entries the failed update wrote, and those still out of sync before it, stay queued for the next sync.
+    uint8_t stale[sizeof(_fatStale)];
+    for (uint8_t i = 0; i < sizeof(stale); i++)
+        stale[i] = _fatStale[i] | _fatPending[i];
+
+    // A superblock still held by the write cache must never reach the EEPROM after its update was abandoned.
+    uint8_t slot = (_superblockSlot + 1) % _bootSector.superblockSlots;
+    uint32_t addr = superblockAddress(slot);
+    FS_CachedPage *page = _writeCache.isEnabled() ? _writeCache.lookup(addr - addr % getPageSize()) : NULL;
+    if (page)
+        _writeCache.drop(page);
+
+    if (!loadSuperblock())
+    {
+        MJOLN_LOG_ERROR("No valid superblock found, mount the file system again.\n");
+        isInit = false;
+        return false;
+    }
+    for (uint8_t i = 0; i < sizeof(stale); i++)
+        _fatStale[i] |= stale[i];
+    _fatEntryCount = _bootSector.fileCount[0] | (_bootSector.fileCount[1] << 8);
+    loadFATMirror();
+    runInitialIndexingAndStore();
+    return true;
+}
+
+FS_FATEntry MjolnFileSystem::readFATEntry(uint16_t index)
+{
+    if (index == MJOLN_FILE_NOT_FOUND)
+        return FS_FATEntry();
+    if (index < _fatMirrorSize)
+        return _fatMirror[index];
+
+    // Entries written by the update in progress are read back from the copy they were written to.
+    uint8_t copy = testBit(_fatPending, index) ? (_activeFAT + 1) % MJOLN_FILE_SYSTEM_FAT_COUNT : _activeFAT;
+    uint8_t buffer[MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE];
+    MJOLN_STAT_ADD(fatReads, 1);
+    if (!storageRead(fatEntryAddress(index, copy), buffer, sizeof(buffer)))
+        return FS_FATEntry();
+    return decodeFATEntry(index, copy, buffer);
+}
+
+FS_FATEntry MjolnFileSystem::decodeFATEntry(uint16_t index, uint8_t copy, uint8_t *buffer)
+{
+    if (fatEntryIntact(buffer))
+    {
+        FS_FATEntry fatEntry = toFATEntry(buffer);
+        if (validFATEntry(index, fatEntry))
+            return fatEntry;
+    }
+    _fatDamaged = true;
+
+    // The other copy holds the same entry unless it is behind or the entry is being rewritten.
+    uint8_t twin[MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE];
+    if (!testBit(_fatStale, index) && !testBit(_fatPending, index) &&
+        storageRead(fatEntryAddress(index, (copy + 1) % MJOLN_FILE_SYSTEM_FAT_COUNT), twin, sizeof(twin)) && fatEntryIntact(twin))
+    {
+        FS_FATEntry fatEntry = toFATEntry(twin);
+        if (validFATEntry(index, fatEntry))
+            return fatEntry;
+    }
+
+    // An entry that cannot be trusted is treated as free rather than pointing files at random data.
+    MJOLN_LOG_WARN("FAT entry %u is damaged.\n", index);
+    return FS_FATEntry();
+}
+
+bool MjolnFileSystem::validFATEntry(uint16_t index, const FS_FATEntry &entry)
+{
+    if (entry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE)
+        return true;
+    if (entry.status != MJOLN_FILE_SYSTEM_FAT_AVAILABLE && entry.status != MJOLN_FILE_SYSTEM_FAT_LINK)
+        return false;
+
+    uint32_t startAddr = entry.startAddr[0] | (entry.startAddr[1] << 8) | (entry.startAddr[2] << 16);
+    uint32_t size = entry.size[0] | (entry.size[1] << 8) | (entry.size[2] << 16);
+    if (size > 0 && (startAddr < dataStart() || startAddr + size > dataEnd()))
+        return false;
+    return entry.link == MJOLN_FILE_NOT_FOUND || (entry.link != index && entry.link <= fatCapacity());
+}
+
+bool MjolnFileSystem::writeFATEntry(uint16_t index, const FS_FATEntry &entry)
+{
+    if (storeFATEntry(index, entry))
+    {
+        MJOLN_LOG_DEBUG("FAT entry written successfully.\n");
+        return true;
+    }
+    MJOLN_LOG_ERROR("Failed to write FAT entry.\n");
+    return false;
+}
+
+bool MjolnFileSystem::updateFATEntry(uint16_t index, const FS_FATEntry &entry)
+{
+    return storeFATEntry(index, entry);
+}
+
+bool MjolnFileSystem::storeFATEntry(uint16_t index, const FS_FATEntry &entry)
+{
+    if (index == MJOLN_FILE_NOT_FOUND || index > fatCapacity())
+        return false;
+
+    // Entries only ever go to the inactive copy; writeSuperblock() makes them current.
+    uint8_t buffer[MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE];
+    fatToBytes(entry, buffer);
+    if (!storageWrite(fatEntryAddress(index, (_activeFAT + 1) % MJOLN_FILE_SYSTEM_FAT_COUNT), buffer, sizeof(buffer)))
+    {
+        setBit(_fatStale, index);
+        return false;
+    }
+
+    setBit(_fatPending, index);
+    _fatPendingAny = true;
+    mirrorFATEntry(index, entry);
+    return true;
+}
@@ -10,23 +10,59 @@
  * @note The constants are used in the Mjoln EEPROM File System implementation.
  */
 
-#define MJOLN_FILE_SYSTEM_VERSION 1              // Version of the Mjoln EEPROM File System
+#define MJOLN_FILE_SYSTEM_VERSION 8              // Version of the Mjoln EEPROM File System
 #define MJOLN_SIGNATURE "MjolnFS"                // Signature to identify the file system
 #define MJOLN_FILE_NAME_MAX_LENGTH 9             // Maximum length of the file name
 #define MJOLN_FILE_SYSTEM_SIGNATURE_SIZE 8       // Length of the file system signature
 #define MJOLN_FILE_SYSTEM_PAGE_SIZE 64           // Size of a page in EEPROM
-#define MJOLN_FILE_SYSTEM_FAT_SIZE 16            // Size of the FAT in pages
-#define MJOLN_FILE_SYSTEM_FAT_COUNT 2            // Number of FAT copies
+#define MJOLN_FILE_SYSTEM_FAT_CHUNK_PAGES 3      // Pages each FAT copy grows by; three pages hold a whole number of entries
+#define MJOLN_FILE_SYSTEM_FAT_COUNT 2            // Number of FAT copies, the superblock selects the current one
 #define MJOLN_FILE_SYSTEM_RESERVED_SIZE 2        // Size of the reserved area in the file system
-#define MJOLN_FILE_SYSTEM_MAX_FILES 16           // Maximum number of files in the file system
 #define MJOLN_FILE_SYSTEM_START_ADDR_SIZE 0x03   // Start address of the file system in EEPROM
 #define MJOLN_FILE_SYSTEM_FILE_SIZE 0x03         // Size of the file in bytes
 #define MJOLN_FILE_SYSTEM_FILE_COUNT_LENGTH 0x02 // Maximum size of a file in bytes
 #define MJOLN_FILE_SYSTEM_FAT_AVAILABLE 0x01     // The FAT Entry is available in File System
 #define MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE 0x00   // The FAT Entry is unavailable in File System
+#define MJOLN_FILE_SYSTEM_FAT_LINK 0x02          // The FAT Entry holds a further extent of a file, not a file
+#define MJOLN_FILE_SYSTEM_FAT_ENTRY_BYTES 22     // Bytes of a FAT entry that carry data on the EEPROM, its CRC follows
+#define MJOLN_FILE_FLAG_COMPRESSED 0x01          // FAT entry flag: the file data is stored as compressed blocks
 #define MJOLN_FILE_NOT_FOUND 0                   // The default value to be returned when file is not found
-#define MJOLN_FILE_SYSTEM_CACHING_LIMIT 10       // The limit for lookup file list for improved file system reads and checks
+#define MJOLN_FILE_MAX_EXTENTS 4                 // Extents of a link chain an open file handle keeps resolved
+#define MJOLN_FILE_SYSTEM_CACHE_PAGES 4          // Default number of pages held by the write-back cache
+#define MJOLN_WRITE_QUEUE_PAGES 8                // Default number of page programs the asynchronous write queue holds
+#define MJOLN_WRITE_QUEUE_TICKETS 8              // Queued operations whose completion is reported separately
+#define MJOLN_FILE_SYSTEM_FAT_MIRROR_GROWTH 4    // Spare entries allocated each time the FAT mirror grows
+#define MJOLN_FILE_SYSTEM_APPEND_TAILS 4         // Files whose last extent is remembered between appends
+#define MJOLN_FILE_SYSTEM_APPEND_MERGE_PAGES 4   // Pages a file's last extent may span and still move to grow
+#define MJOLN_FILE_SYSTEM_FREE_EXTENTS 16        // Holes in the data area tracked by the free-space allocator
+#define MJOLN_FILE_SYSTEM_VOID_FAT_CACHE 8       // Deleted FAT entries remembered for reuse
+#define MJOLN_COMPACT_STEP_BYTES 32              // File bytes moved by one compactStep() call
+#define MJOLN_COMPRESS_BLOCK_BYTES 512           // File bytes per compressed block; a seek decodes at most one block
+#define MJOLN_COMPRESS_BLOCK_HEADER 4            // Bytes before each compressed block: its raw and its stored length
+#define MJOLN_COMPRESS_STAGE_BYTES 128           // Compressed bytes gathered before they are written, a page of the largest part
+#define MJOLN_COMPARE_CHUNK_BYTES 32             // Bytes read at a time when comparing a page before rewriting it
+#define MJOLN_FILE_SYSTEM_SUPERBLOCK_SLOTS 8     // Superblock slots the boot state rotates over with wear leveling
+#define MJOLN_FLAG_WEAR_LEVELING 0x01            // Boot sector flag: metadata and data writes are spread over the chip
+#define MJOLN_FILE_SYSTEM_SYNC_ENTRIES 4         // Stale FAT entries the superblock lists before asking for a full resync
+
+#ifndef MJOLN_FILE_SYSTEM_FAT_BITMAP_BYTES
+#define MJOLN_FILE_SYSTEM_FAT_BITMAP_BYTES 4 // Size of the per-entry FAT bitmaps, limits a FAT copy to 31 entries; raise with -D for more files
+#endif
+#define MJOLN_FILE_SYSTEM_MAX_FILES (MJOLN_FILE_SYSTEM_FAT_BITMAP_BYTES * 8 - 1) // Most FAT entries a volume can be formatted for, and the default
+
+// Slots in the filename index: the power of two above MJOLN_FILE_SYSTEM_MAX_FILES, so every file a volume can
+// hold is indexed. Each slot takes 4 bytes of RAM.
+#define MJOLN_FILE_SYSTEM_INDEX_SLOTS                                                                          \
+    (MJOLN_FILE_SYSTEM_MAX_FILES < 16 ? 16 : MJOLN_FILE_SYSTEM_MAX_FILES < 32 ? 32 : MJOLN_FILE_SYSTEM_MAX_FILES < 64 ? 64 \
+     : MJOLN_FILE_SYSTEM_MAX_FILES < 128 ? 128 : MJOLN_FILE_SYSTEM_MAX_FILES < 256 ? 256 : 512)
 
 #define MJOLN_STORAGE_DEVICE_ADDRESS 0x50 // I2C address of the EEPROM device
+#define MJOLN_BLOCK_SELECT_MASK 0x07       // Device address bits that select a 256-byte block on AT24C04/08/16
+#define MJOLN_MAX_CHIPS 8                  // EEPROMs a volume can stripe over, one per address from 0x50 to 0x57
+#define MJOLN_WRITE_CYCLE_TIMEOUT_US 10000 // Longest wait for an EEPROM write cycle before the write is reported as failed
+
+#ifndef MJOLN_ENABLE_STATS
+#define MJOLN_ENABLE_STATS 1 // Keep the performance counters of getStats(); 0 compiles every count out
+#endif
 
 #endif // MJOLN_CONST_H
\ No newline at end of file
@@ -1,108 +1,216 @@
 #include "MjolnFS.h"
 
-MjolnFileSystem::MjolnFileSystem(AT24CXType eepromModel)
-    : _eepromType(eepromModel), _deviceAddress(MJOLN_STORAGE_DEVICE_ADDRESS), _eepromSize(0), _pageSize(0), _fatEntryCount(0), signature(MJOLN_SIGNATURE)
+MjolnFileSystem::MjolnFileSystem(AT24CXType eepromModel, uint8_t chipCount)
+    : MjolnFileSystem(eepromModel, chipCount, chipSize(eepromModel), chipPageSize(eepromModel),
+                      chipAddressSize(eepromModel), chipAddressCount(eepromModel))
 {
 }
 
+MjolnFileSystem::MjolnFileSystem(AT24CXType eepromModel, uint8_t chipCount, uint32_t chipBytes, uint8_t pageSize,
+                                 AT24CX_ADDR_SIZE addressSize, uint8_t addressesPerChip)
+    : _deviceAddress(MJOLN_STORAGE_DEVICE_ADDRESS), _chipCount(chipCount), _chipCountRequested(chipCount), _eepromSize(0),
+      _pageSize(pageSize), _addressesPerChip(addressesPerChip), _addressSize(addressSize), signature(MJOLN_SIGNATURE),
+      _eepromType(eepromModel), _fatEntryCount(0)
+{
+    memset(_appendTails, 0, sizeof(_appendTails));
+
+    // 8-bit parts answer on one address per 256-byte block, so fewer of them fit on the bus. An invalid
+    // count is kept in range so the geometry stays usable, and mount() and format() refuse the volume.
+    _chipCount = max((uint8_t)1, min(chipCount, (uint8_t)(MJOLN_MAX_CHIPS / addressesPerChip)));
+    _eepromSize = chipBytes * _chipCount;
+}
+
+bool MjolnFileSystem::checkChipCount()
+{
+    if (_chipCountRequested == _chipCount)
+        return true;
+    MJOLN_LOG_ERROR("%u chips configured, 1 to %u of this model fit on the bus.\n", _chipCountRequested, MJOLN_MAX_CHIPS / _addressesPerChip);
+    return false;
+}
+
+MjolnFileSystem::~MjolnFileSystem()
+{
+    disableFATMirror();
+}
+
 FS_BootSector MjolnFileSystem::readBootSector()
 {
-    FS_BootSector bootSector;
-    uint8_t buffer[sizeof(FS_BootSector)];
-    eepromReadBytes(MJOLN_STORAGE_DEVICE_ADDRESS, 0, getAddressSize(), buffer, sizeof(FS_BootSector), getPageSize());
-    bootSector = toBootSector(buffer);
-    return bootSector;
+    uint8_t buffer[MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE];
+    if (!storageRead(0, buffer, sizeof(buffer)))
+        memset(buffer, 0, sizeof(buffer));
+    return toBootSector(buffer);
 }
 
 bool MjolnFileSystem::writeBootSector(const FS_BootSector &bootSector)
 {
-    uint8_t *buffer = bootSectorToBytes(&bootSector);
-    printLogs("Writing boot sector...\n");
-    if (eepromWriteBytes(MJOLN_STORAGE_DEVICE_ADDRESS, 0, getAddressSize(), buffer, sizeof(FS_BootSector), getPageSize()))
+    uint8_t buffer[MJOLN_FILE_SYSTEM_BOOT_SECTOR_SIZE];
+    bootSectorToBytes(bootSector, buffer);
+    if (storageWrite(0, buffer, sizeof(buffer)))
     {
-        printLogs("Boot sector written successfully.\n");
-        printLogs("Boot sector data: ");
-
-        for (size_t i = 0; i < sizeof(FS_BootSector); i++)
-            printLogs(String(buffer[i], HEX) + " ");
-
-        printLogs("\n");
-        free(buffer);
+        MJOLN_LOG_DEBUG("Boot sector written, generation %u.\n", bootSector.generation);
         return true;
     }
-
-    free(buffer);
+    MJOLN_LOG_ERROR("Failed to write boot sector.\n");
     return false;
 }
 
-FS_FATEntry MjolnFileSystem::readFATEntry(uint16_t index)
+void MjolnFileSystem::enableWearLeveling(bool enable)
+{
+    _wearLevelingRequested = enable;
+}
+
+void MjolnFileSystem::enableInPlaceUpdates(bool enable)
+{
+    _inPlaceUpdates = enable;
+}
+
+void MjolnFileSystem::setFATLimit(uint16_t entries)
+{
+    _fatLimitRequested = max((uint16_t)1, min(entries, (uint16_t)MJOLN_FILE_SYSTEM_MAX_FILES));
+}
+
+bool MjolnFileSystem::isWearLeveling()
 {
-    FS_FATEntry fatEntry;
-    uint8_t buffer[sizeof(FS_FATEntry)];
-    eepromReadBytes(MJOLN_STORAGE_DEVICE_ADDRESS, sizeof(FS_BootSector) + (index * sizeof(FS_FATEntry)), getAddressSize(), buffer, sizeof(FS_FATEntry), getPageSize());
-    fatEntry = toFATEntry(buffer, sizeof(buffer));
-    return fatEntry;
+    return _bootSector.flags & MJOLN_FLAG_WEAR_LEVELING;
 }
 
-bool MjolnFileSystem::writeFATEntry(uint16_t index, const FS_FATEntry &entry)
+bool MjolnFileSystem::enableFATMirror()
 {
-    uint8_t *buffer = fatToBytes(&entry);
-    if (eepromWriteBytes(MJOLN_STORAGE_DEVICE_ADDRESS, sizeof(FS_BootSector) + (index * sizeof(FS_FATEntry)), getAddressSize(), buffer, sizeof(FS_FATEntry), getPageSize()))
+    _fatMirrorEnabled = true;
+    return !isInit || loadFATMirror();
+}
+
+void MjolnFileSystem::disableFATMirror()
+{
+    _fatMirrorEnabled = false;
+    free(_fatMirror);
+    _fatMirror = NULL;
+    _fatMirrorSize = 0;
+    _fatMirrorCapacity = 0;
+}
+
+bool MjolnFileSystem::loadFATMirror()
+{
+    _fatMirrorSize = 0;
+    if (!_fatMirrorEnabled)
+        return false;
+
+    if (!reserveFATMirror(_fatEntryCount + 1))
     {
-        free(buffer);
-        printLogs("FAT entry written successfully.\n");
-        return true;
+        MJOLN_LOG_ERROR("Not enough memory for the FAT mirror.\n");
+        disableFATMirror();
+        return false;
     }
-    else
+
+    // Entries are laid out back to back within a chunk, so each chunk is read in one sequential burst
+    // straight into the mirror and then decoded in place.
+    if (_fatEntryCount > 0)
     {
-        free(buffer);
-        printLogs("Failed to write FAT entry.\n");
-        return false;
+        uint16_t perChunk = fatChunkEntries();
+        for (uint16_t first = 1; first <= _fatEntryCount; first += perChunk)
+        {
+            uint16_t count = min((uint16_t)(_fatEntryCount - first + 1), perChunk);
+            if (!storageRead(fatEntryAddress(first, _activeFAT), (uint8_t *)&_fatMirror[first], count * MJOLN_FILE_SYSTEM_FAT_ENTRY_SIZE))
+                return false;
+        }
+
+        for (uint16_t i = 1; i <= _fatEntryCount; i++)
+            _fatMirror[i] = decodeFATEntry(i, _activeFAT, (uint8_t *)&_fatMirror[i]);
+        MJOLN_STAT_ADD(fatReads, _fatEntryCount);
     }
+
+    _fatMirror[0] = FS_FATEntry();
+    _fatMirrorSize = _fatEntryCount + 1;
+    return true;
 }
 
-bool MjolnFileSystem::updateFATEntry(uint16_t index, const FS_FATEntry &entry)
+bool MjolnFileSystem::reserveFATMirror(uint16_t entries)
 {
-    uint8_t *buffer = fatToBytes(&entry);
-    if (eepromWriteBytes(MJOLN_STORAGE_DEVICE_ADDRESS, sizeof(FS_BootSector) + index * sizeof(FS_FATEntry), getAddressSize(), buffer, sizeof(FS_FATEntry), getPageSize()))
-    {
-        free(buffer);
+    if (entries <= _fatMirrorCapacity)
         return true;
-    }
-    else
-    {
-        free(buffer);
+
+    uint16_t capacity = entries + MJOLN_FILE_SYSTEM_FAT_MIRROR_GROWTH;
+    FS_FATEntry *mirror = (FS_FATEntry *)realloc(_fatMirror, capacity * sizeof(FS_FATEntry));
+    if (!mirror)
         return false;
+
+    _fatMirror = mirror;
+    _fatMirrorCapacity = capacity;
+    return true;
+}
+
+void MjolnFileSystem::mirrorFATEntry(uint16_t index, const FS_FATEntry &entry)
+{
+    if (!_fatMirrorEnabled || _fatMirrorSize == 0)
+        return;
+
+    if (!reserveFATMirror(index + 1))
+    {
+        // A mirror that misses an entry would return stale data, so it is dropped instead.
+        MJOLN_LOG_ERROR("Not enough memory for the FAT mirror.\n");
+        disableFATMirror();
+        return;
     }
+
+    // Entries between the old end and index were never written; they fail their CRC and read as free.
+    for (uint16_t i = _fatMirrorSize; i < index; i++)
+        _fatMirror[i] = FS_FATEntry();
+
+    _fatMirror[index] = entry;
+    _fatMirror[index].filename[MJOLN_FILE_NAME_MAX_LENGTH - 1] = '\0';
+    if (index >= _fatMirrorSize)
+        _fatMirrorSize = index + 1;
 }
 
 bool MjolnFileSystem::mount()
 {
+    if (!checkChipCount())
+        return false;
     Wire.begin();
     _bootSector = readBootSector();
-    if (verifyBootSector(&_bootSector))
+    if (verifyBootSector(_bootSector))
     {
-        _pageSize = _bootSector.pageSize;
+        if (_bootSector.chipCount != _chipCount)
+        {
+            MJOLN_LOG_ERROR("File system spans %u chips, %u configured.\n", _bootSector.chipCount, _chipCount);
+            return false;
+        }
+        if (_bootSector.pageSize != _pageSize)
+        {
+            MJOLN_LOG_ERROR("File system uses %u-byte pages, the EEPROM has %u.\n", _bootSector.pageSize, _pageSize);
+            return false;
+        }
+        if (!loadSuperblock())
+        {
+            MJOLN_LOG_ERROR("No valid superblock found.\n");
+            return false;
+        }
+        if (isWearLeveling())
+            _allocator.setPolicy(FS_ALLOCATE_NEXT_FIT);
         _fatEntryCount = _bootSector.fileCount[0] | (_bootSector.fileCount[1] << 8);
-        uint32_t lastDataAddr = _bootSector.lastDataAddr[0] | (_bootSector.lastDataAddr[1] << 8) | (_bootSector.lastDataAddr[2] << 16);
 
-        printLogs("Mounting file system...\n");
+        MJOLN_LOG_INFO("Mounting file system...\n");
+        loadFATMirror();
         runInitialIndexingAndStore();
-        printLogs("File system mounted.");
-
-        printLogs("\nMjoln File System\n-----------------\n");
-        printLogs("EEPROM type: " + String(_eepromType) + "\n");
-        printLogs("Valid file system signature.\n");
-        printLogs("File system version: " + String(_bootSector.version) + "\n");
-        printLogs("File system signature: " + String(_bootSector.signature) + "\n");
-        printLogs("Last data address: " + String(lastDataAddr) + "\n");
-        printLogs("File count: " + String(_fatEntryCount - (uint16_t)_bootSector.deleted) + "\n\n");
+        MJOLN_LOG_INFO("File system mounted.");
+
+        if (MJOLN_LOGGING(MJOLN_LOG_LEVEL_INFO))
+        {
+            uint32_t lastDataAddr = _bootSector.lastDataAddr[0] | (_bootSector.lastDataAddr[1] << 8) | (_bootSector.lastDataAddr[2] << 16);
+            printLogf("\nMjoln File System\n-----------------\n");
+            printLogf("EEPROM type: %u\n", _eepromType);
+            printLogf("Valid file system signature.\n");
+            printLogf("File system version: %u\n", _bootSector.version);
+            printLogf("File system signature: %.*s\n", (int)MJOLN_FILE_SYSTEM_SIGNATURE_SIZE, _bootSector.signature);
+            printLogf("Last data address: %lu\n", (unsigned long)lastDataAddr);
+            printLogf("File count: %u\n\n", _liveFileCount);
+        }
         isInit = true;
         getBytesUsed();
     }
     else
     {
-        printLogs("Invalid file system signature.\n");
+        MJOLN_LOG_WARN("Invalid file system signature.\n");
         return false;
     }
     return true;
@@ -110,24 +218,57 @@ bool MjolnFileSystem::mount()
 
 bool MjolnFileSystem::format()
 {
-    printLogs("Formatting file system...\n");
-    if (!cleanFormat())
+    if (!checkChipCount())
         return false;
+    MJOLN_LOG_INFO("Formatting file system...\n");
+    if (!Wire.available())
+        Wire.begin();
+
+    // Cached writes belong to the file system being replaced and must not land on top of the new one.
+    _writeCache.invalidate();
+    abortCompaction();
+
+    // Bumping the generation retires every superblock, and with them the FAT and data they describe,
+    // so nothing but the boot sector and the first superblock has to be written.
+    FS_BootSector previous = readBootSector();
+    uint16_t generation = verifyBootSector(previous) ? previous.generation + 1 : (uint16_t)micros();
+    if (generation == 0)
+        generation = 1;
 
     _bootSector.version = MJOLN_FILE_SYSTEM_VERSION;
     memcpy(_bootSector.signature, signature, MJOLN_FILE_SYSTEM_SIGNATURE_SIZE);
-    _bootSector.pageSize = MJOLN_FILE_SYSTEM_PAGE_SIZE;
-    uint16_t reservedSize = getReservedSize();
-    _bootSector.lastDataAddr[0] = reservedSize & 0xFF;
-    _bootSector.lastDataAddr[1] = (reservedSize >> 8) & 0xFF;
-    _bootSector.lastDataAddr[2] = (reservedSize >> 16) & 0xFF;
-    _bootSector.fileCount[0] = 0;
-    _bootSector.fileCount[1] = 0;
+    _bootSector.pageSize = getPageSize();
+    _bootSector.superblockSlots = superblockSlotsFor(_wearLevelingRequested);
+    _bootSector.flags = _wearLevelingRequested ? MJOLN_FLAG_WEAR_LEVELING : 0;
+    _bootSector.generation = generation;
+    _bootSector.chipCount = _chipCount;
+    _bootSector.fatLimit = _fatLimitRequested;
+    // The FAT starts out empty and takes its first chunk from the data area with the first file.
+    _fatChunks = 0;
+    uint32_t start = dataStart();
+    _bootSector.lastDataAddr[0] = start & 0xFF;
+    _bootSector.lastDataAddr[1] = (start >> 8) & 0xFF;
+    _bootSector.lastDataAddr[2] = (start >> 16) & 0xFF;
     _bootSector.deleted = 0;
     _bootSector.bytesInUse = 0;
-    _fatEntryCount = 0;
-
-    if (!writeBootSector(_bootSector))
+    setFATEntryCount(0);
+
+    // The first superblock goes to slot 0 with sequence number 1.
+    _superblock.sequence = 0;
+    _superblockSlot = _bootSector.superblockSlots - 1;
+    memcpy(_superblock.allocCursor, _bootSector.lastDataAddr, 3);
+    _superblock.fatCursor[0] = 1;
+    _superblock.fatCursor[1] = 0;
+    _activeFAT = 0;
+    memset(_fatStale, 0, sizeof(_fatStale));
+    memset(_fatPending, 0, sizeof(_fatPending));
+    _fatPendingAny = false;
+    if (isWearLeveling())
+        _allocator.setPolicy(FS_ALLOCATE_NEXT_FIT);
+    runInitialIndexingAndStore();
+    loadFATMirror();
+
+    if (!writeBootSector(_bootSector) || !writeSuperblock() || !flush())
     {
         _bootSector = readBootSector();
         return false;
@@ -136,142 +277,415 @@ bool MjolnFileSystem::format()
     return true;
 }
 
-bool MjolnFileSystem::cleanFormat()
+bool MjolnFileSystem::cleanFormat(FS_ProgressCallback progress)
 {
+    if (!checkChipCount())
+        return false;
     if (!Wire.available())
         Wire.begin();
 
-    if (!deletePartition(MJOLN_STORAGE_DEVICE_ADDRESS, (uint16_t)(pow(2, (uint8_t)_eepromType) - 1)))
+    // The whole volume is about to be erased, so pending cached writes are meaningless.
+    _writeCache.invalidate();
+    abortCompaction();
+    isInit = false;
+
+    // The volume is erased in stripe order rather than chip by chip, so each chip's write cycle runs
+    // while the next page goes to another one.
+    MJOLN_LOG_INFO("Deleting partition...\n\n|--------------------|\n ");
+    uint16_t pageSize = getPageSize();
+    uint8_t marks = 0;
+    uint8_t buffer[MJOLN_COMPARE_CHUNK_BYTES];
+    for (uint32_t addr = 0; addr < _eepromSize; addr += pageSize)
     {
-        printLogs("Failed to delete partition.\n");
-        return false;
+        bool blank = true;
+        for (uint16_t offset = 0; offset < pageSize && blank; offset += sizeof(buffer))
+        {
+            uint16_t chunk = min((uint16_t)(pageSize - offset), (uint16_t)sizeof(buffer));
+            if (!deviceRead(addr + offset, buffer, chunk))
+                blank = false;
+            for (uint16_t i = 0; i < chunk && blank; i++)
+                blank = buffer[i] == 0xFF;
+        }
+        if (!blank && !deviceErase(addr, pageSize))
+        {
+            MJOLN_LOG_ERROR("\nFailed to delete partition.\n");
+            return false;
+        }
+        yield();
+
+        if (progress)
+            progress(addr + pageSize, _eepromSize);
+        for (; marks < (addr + pageSize) * 20 / _eepromSize; marks++)
+            MJOLN_LOG_INFO("=");
     }
+    MJOLN_LOG_INFO("\n\n");
+    if (!flush())
+        return false;
+    MJOLN_LOG_INFO("Partition deleted successfully.\n");
     return true;
 }
 
-bool MjolnFileSystem::updateFile(const char *filename, const char *data)
+bool MjolnFileSystem::updateFile(const char *filename, const char *data, bool secureErase)
 {
     if (!isFileSystemInitialized())
         return false;
+    abortCompaction();
+    discardFATChanges();
 
     uint16_t index = checkFileExistence(filename);
 
+    if (index != MJOLN_FILE_NOT_FOUND && tempFatEntry.recordSize != 0)
+    {
+        MJOLN_LOG_ERROR("Record files are changed with writeRecord().\n");
+        return false;
+    }
+
     if (index != MJOLN_FILE_NOT_FOUND)
     {
-        FS_FATEntry fatEntry;
+        FS_FATEntry fatEntry = tempFatEntry;
         uint32_t length = strlen(data);
-        fatEntry.size[0] = length & 0xFF;
-        fatEntry.size[1] = (length >> 8) & 0xFF;
-        fatEntry.size[2] = (length >> 16) & 0xFF;
-        uint32_t startAddr = tempFatEntry.startAddr[0] | (tempFatEntry.startAddr[1] << 8) | (tempFatEntry.startAddr[2] << 16);
-        printLogs("Updating file...\n");
-        if (length <= (tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16)))
+        uint32_t oldLength = tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16);
+        uint32_t oldStart = tempFatEntry.startAddr[0] | (tempFatEntry.startAddr[1] << 8) | (tempFatEntry.startAddr[2] << 16);
+        uint16_t links = tempFatEntry.link;
+        // Compressed files are packed again; their stored bytes do not line up with the data.
+        bool packed = tempFatEntry.flags & MJOLN_FILE_FLAG_COMPRESSED;
+        uint32_t startAddr = oldStart;
+        MJOLN_LOG_DEBUG("Updating file...\n");
+
+        if (_inPlaceUpdates && links == MJOLN_FILE_NOT_FOUND && length <= oldLength && !packed)
         {
-            uint32_t dataLength = tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16);
-            eepromDeleteMemoryRange(MJOLN_STORAGE_DEVICE_ADDRESS, startAddr, getAddressSize(), dataLength, getPageSize());
-            if (!eepromWriteBytes(MJOLN_STORAGE_DEVICE_ADDRESS, startAddr, getAddressSize(), (const uint8_t *)data, length + 1, getPageSize()))
-                printLogs("Failed to update the file data.\n");
-            else
-                updateFATEntry(index, fatEntry);
+            // EEPROM cells are rewritten directly, so the old contents are not blanked first, and pages
+            // that already hold the new bytes are not programmed at all.
+            if (!storageUpdate(startAddr, (const uint8_t *)data, length))
+            {
+                MJOLN_LOG_ERROR("Failed to update the file data.\n");
+                return false;
+            }
+            if (length < oldLength)
+            {
+                fatEntry.size[0] = length & 0xFF;
+                fatEntry.size[1] = (length >> 8) & 0xFF;
+                fatEntry.size[2] = (length >> 16) & 0xFF;
+                _bootSector.bytesInUse -= oldLength - length;
+                if (!updateFATEntry(index, fatEntry) || !writeSuperblock())
+                {
+                    MJOLN_LOG_ERROR("Failed to update the file entry.\n");
+                    reloadMetadata();
+                    return false;
+                }
+                if (secureErase && !storageErase(startAddr + length, oldLength - length))
+                    MJOLN_LOG_ERROR("Failed to erase the old file data.\n");
+                _allocator.release(startAddr + length, oldLength - length);
+                syncDataTop();
+            }
         }
         else
         {
-            bool logState = logEnabled;
-            if (logEnabled)
-                showLogs(false);
-            bool res = deleteFile(filename) && writeFile(filename, data);
-            if (logEnabled)
-                showLogs(logEnabled);
-            if (!res)
+            // The new contents go to free space and one commit switches the entry over to them, so a reset
+            // leaves either the old or the new file whole. The old extents are released afterwards.
+            uint32_t stored = packed ? packedLength((const uint8_t *)data, length) : length;
+            startAddr = _allocator.allocate(stored);
+            if (startAddr == MJOLN_ALLOCATION_FAILED)
             {
-                printLogs("Failed to update the file data.\n");
+                MJOLN_LOG_ERROR("Not enough space to update the file.\n");
                 return false;
             }
+            if (!writeData(startAddr, (const uint8_t *)data, length, packed))
+            {
+                MJOLN_LOG_ERROR("Failed to update the file data.\n");
+                _allocator.release(startAddr, stored);
+                return false;
+            }
+
+            fatEntry.startAddr[0] = startAddr & 0xFF;
+            fatEntry.startAddr[1] = (startAddr >> 8) & 0xFF;
+            fatEntry.startAddr[2] = (startAddr >> 16) & 0xFF;
+            fatEntry.size[0] = stored & 0xFF;
+            fatEntry.size[1] = (stored >> 8) & 0xFF;
+            fatEntry.size[2] = (stored >> 16) & 0xFF;
+            fatEntry.link = MJOLN_FILE_NOT_FOUND;
+            uint32_t linkBytes = 0;
+            syncDataTop();
+            if (!updateFATEntry(index, fatEntry) || !deleteLinks(links, linkBytes))
+            {
+                MJOLN_LOG_ERROR("Failed to update the file entry.\n");
+                reloadMetadata();
+                return false;
+            }
+            _bootSector.bytesInUse += stored - oldLength - linkBytes;
+            if (!writeSuperblock())
+            {
+                MJOLN_LOG_ERROR("Failed to write superblock.\n");
+                reloadMetadata();
+                return false;
+            }
+            forgetTail(index);
+            if (!releaseExtents(oldStart, oldLength, links, secureErase))
+                MJOLN_LOG_ERROR("Failed to erase the old file data.\n");
+            syncDataTop();
         }
 
-        if (logEnabled)
+        if (MJOLN_LOGGING(MJOLN_LOG_LEVEL_DEBUG))
         {
-            printLogs("\nFILE UPDATE LOGS\n");
-            printLogs("----------------\n");
-            printLogs("File updated successfully.\n");
-            printLogs("File name: " + String(fatEntry.filename) + "\n");
-            printLogs("File size: " + String(length) + " bytes\n");
-            printLogs("File start address: " + String(startAddr) + "\n");
-            printLogs("File status: " + String(fatEntry.status) + "\n");
-            printLogs("File data: ");
-            for (size_t i = 0; i < length; i++)
-                printLogs(String(data[i]));
-            printLogs("\n\n");
+            printLogf("\nFILE UPDATE LOGS\n");
+            printLogf("----------------\n");
+            printLogf("File updated successfully.\n");
+            printLogf("File name: %s\n", fatEntry.filename);
+            printLogf("File size: %lu bytes\n", (unsigned long)length);
+            printLogf("File start address: %lu\n", (unsigned long)startAddr);
+            printLogf("File status: %u\n", fatEntry.status);
+            printLogf("File data: ");
+            printLogData(data, length);
+            printLogf("\n\n");
         }
 
         return true;
     }
-    printLogs("File not found!\n");
+    MJOLN_LOG_ERROR("File not found!\n");
     return false;
 }
 
-bool MjolnFileSystem::writeFile(const char *filename, const char *data)
+bool MjolnFileSystem::writeFile(const char *filename, const char *data, bool compress)
 {
     if (!isFileSystemInitialized())
         return false;
+    abortCompaction();
+    discardFATChanges();
 
     if (checkFileExistence(filename) == MJOLN_FILE_NOT_FOUND)
     {
         uint32_t length = strlen(data);
+        uint32_t stored = compress ? packedLength((const uint8_t *)data, length) : length;
         FS_FATEntry fatEntry;
         fatEntry.status = 1;
-        memcpy(fatEntry.filename, filename, MJOLN_FILE_NAME_MAX_LENGTH);
-        fatEntry.size[0] = length & 0xFF;
-        fatEntry.size[1] = (length >> 8) & 0xFF;
-        fatEntry.size[2] = (length >> 16) & 0xFF;
-        memcpy(fatEntry.startAddr, _bootSector.lastDataAddr, sizeof(fatEntry.startAddr));
-        printLogs("Writing file...\n");
-        uint32_t startAddr = _bootSector.lastDataAddr[0] | (_bootSector.lastDataAddr[1] << 8) | (_bootSector.lastDataAddr[2] << 16);
+        fatEntry.link = MJOLN_FILE_NOT_FOUND;
+        fatEntry.recordSize = 0;
+        fatEntry.flags = compress ? MJOLN_FILE_FLAG_COMPRESSED : 0;
+        strncpy(fatEntry.filename, filename, MJOLN_FILE_NAME_MAX_LENGTH - 1);
+        fatEntry.filename[MJOLN_FILE_NAME_MAX_LENGTH - 1] = '\0';
+        fatEntry.size[0] = stored & 0xFF;
+        fatEntry.size[1] = (stored >> 8) & 0xFF;
+        fatEntry.size[2] = (stored >> 16) & 0xFF;
+
+        uint16_t fatIndex = newLinkEntry();
+        if (fatIndex == MJOLN_FILE_NOT_FOUND)
+        {
+            MJOLN_LOG_ERROR("No free FAT entry for the file.\n");
+            return false;
+        }
+        uint32_t startAddr = _allocator.allocate(stored);
+        if (startAddr == MJOLN_ALLOCATION_FAILED)
+        {
+            MJOLN_LOG_ERROR("Not enough space to write the file.\n");
+            discardFATChanges();
+            return false;
+        }
+        fatEntry.startAddr[0] = startAddr & 0xFF;
+        fatEntry.startAddr[1] = (startAddr >> 8) & 0xFF;
+        fatEntry.startAddr[2] = (startAddr >> 16) & 0xFF;
+        MJOLN_LOG_DEBUG("Writing file...\n");
 
-        if (writeFATEntry(_fatEntryCount + 1, fatEntry))
+        // The data goes to free space first; the FAT entry and the superblock then make the file visible.
+        if (!writeData(startAddr, (const uint8_t *)data, length, compress))
         {
-            if (eepromWriteBytes(MJOLN_STORAGE_DEVICE_ADDRESS, startAddr, getAddressSize(), (const uint8_t *)data, length, getPageSize()))
-            {
-                _bootSector.lastDataAddr[0] = (startAddr + length) & 0xFF;
-                _bootSector.lastDataAddr[1] = ((startAddr + length) >> 8) & 0xFF;
-                _bootSector.lastDataAddr[2] = ((startAddr + length) >> 16) & 0xFF;
-                _bootSector.fileCount[0] += 1;
-                _bootSector.fileCount[1] += (_bootSector.fileCount[0] >> 8) & 0xFF;
-                _bootSector.bytesInUse += length;
-                writeBootSector(_bootSector);
-            }
-            else
+            MJOLN_LOG_ERROR("Failed to write file data.\n");
+            _allocator.release(startAddr, stored);
+            discardFATChanges();
+            return false;
+        }
+
+        if (writeFATEntry(fatIndex, fatEntry))
+        {
+            _bootSector.bytesInUse += stored;
+            claimFATEntry(fatIndex);
+            syncDataTop();
+            _liveFileCount++;
+            _fileIndex.insert(fatEntry.filename, fatIndex);
+
+            if (!writeSuperblock())
             {
-                printLogs("Failed to write file data.\n");
+                MJOLN_LOG_ERROR("Failed to write superblock.\n");
+                reloadMetadata();
                 return false;
             }
-            _fatEntryCount++;
-            if (_fatEntryCount > 1)
-                fileLookupList.concat(",");
-            fileLookupList.concat(fatEntry.filename);
+        }
+        else
+        {
+            reloadMetadata();
+            return false;
         }
 
-        if (logEnabled)
+        if (MJOLN_LOGGING(MJOLN_LOG_LEVEL_DEBUG))
         {
-            printLogs("\nFILE WRITE LOGS\n");
-            printLogs("----------------\n");
-            printLogs("File written successfully.\n");
-            printLogs("File name: " + String(fatEntry.filename) + "\n");
-            printLogs("File size: " + String(length) + " bytes\n");
-            printLogs("File start address: " + String(startAddr) + "\n");
-            printLogs("File status: " + String(fatEntry.status) + "\n");
-            printLogs("File data: ");
-            for (size_t i = 0; i < length; i++)
-                printLogs(String(data[i]));
-            printLogs("\n\n");
+            printLogf("\nFILE WRITE LOGS\n");
+            printLogf("----------------\n");
+            printLogf("File written successfully.\n");
+            printLogf("File name: %s\n", fatEntry.filename);
+            printLogf("File size: %lu bytes\n", (unsigned long)length);
+            if (compress)
+                printLogf("Stored size: %lu bytes\n", (unsigned long)stored);
+            printLogf("File start address: %lu\n", (unsigned long)startAddr);
+            printLogf("File status: %u\n", fatEntry.status);
+            printLogf("File data: ");
+            printLogData(data, length);
+            printLogf("\n\n");
         }
 
         return true;
     }
-    printLogs("Couldn't write this file. File already exists!\n");
+    MJOLN_LOG_ERROR("Couldn't write this file. File already exists!\n");
     return false;
 }
 
+bool MjolnFileSystem::appendFile(const char *filename, const char *data, bool compress)
+{
+    if (!isFileSystemInitialized())
+        return false;
+    abortCompaction();
+    discardFATChanges();
+
+    uint16_t headIndex = checkFileExistence(filename);
+    if (headIndex == MJOLN_FILE_NOT_FOUND)
+        return writeFile(filename, data, compress);
+    if (tempFatEntry.recordSize != 0)
+    {
+        MJOLN_LOG_ERROR("Record files are changed with writeRecord().\n");
+        return false;
+    }
+
+    uint32_t length = strlen(data);
+    if (length == 0)
+        return true;
+
+    // A compressed file grows by whole blocks, so the new bytes are packed on their own.
+    bool packed = tempFatEntry.flags & MJOLN_FILE_FLAG_COMPRESSED;
+    uint32_t stored = packed ? packedLength((const uint8_t *)data, length) : length;
+    FS_FATEntry tail = tempFatEntry;
+    uint16_t tailIndex = findTailEntry(headIndex, tail);
+    if (tailIndex == MJOLN_FILE_NOT_FOUND)
+    {
+        MJOLN_LOG_WARN("Broken link chain.\n");
+        return false;
+    }
+
+    uint32_t tailStart = tail.startAddr[0] | (tail.startAddr[1] << 8) | (tail.startAddr[2] << 16);
+    uint32_t tailSize = tail.size[0] | (tail.size[1] << 8) | (tail.size[2] << 16);
+    uint32_t addr = tailStart + tailSize;
+    uint16_t linkIndex = MJOLN_FILE_NOT_FOUND;
+    bool growInPlace = _allocator.extend(addr, stored);
+
+    // Logs appended to in turn block each other's growth. A short last extent moves together with the new
+    // bytes instead of taking a FAT entry for every append, so the volume fills up before the FAT does.
+    uint32_t moveTo = MJOLN_ALLOCATION_FAILED;
+    if (!growInPlace && tailSize <= (uint32_t)MJOLN_FILE_SYSTEM_APPEND_MERGE_PAGES * getPageSize())
+        moveTo = _allocator.allocate(tailSize + stored);
+    bool relocate = moveTo != MJOLN_ALLOCATION_FAILED;
+    if (relocate)
+        addr = moveTo + tailSize;
+    else if (!growInPlace)
+    {
+        linkIndex = newLinkEntry();
+        if (linkIndex == MJOLN_FILE_NOT_FOUND)
+        {
+            MJOLN_LOG_ERROR("No free FAT entry for a new extent.\n");
+            return false;
+        }
+        addr = _allocator.allocate(stored);
+        if (addr == MJOLN_ALLOCATION_FAILED)
+        {
+            MJOLN_LOG_ERROR("Not enough space to append to the file.\n");
+            discardFATChanges();
+            return false;
+        }
+    }
+
+    MJOLN_LOG_DEBUG("Appending to file...\n");
+    if (relocate && !copyData(tailStart, moveTo, tailSize))
+    {
+        MJOLN_LOG_ERROR("Failed to move the last extent.\n");
+        _allocator.release(moveTo, tailSize + stored);
+        discardFATChanges();
+        return false;
+    }
+    if (!writeData(addr, (const uint8_t *)data, length, packed))
+    {
+        MJOLN_LOG_ERROR("Failed to write file data.\n");
+        if (relocate)
+            _allocator.release(moveTo, tailSize + stored);
+        else
+            _allocator.release(addr, stored);
+        discardFATChanges();
+        return false;
+    }
+
+    if (growInPlace || relocate)
+    {
+        // The last extent is followed by free space, so it simply grows, or it now starts at its copy.
+        uint32_t newStart = relocate ? moveTo : tailStart;
+        tail.startAddr[0] = newStart & 0xFF;
+        tail.startAddr[1] = (newStart >> 8) & 0xFF;
+        tail.startAddr[2] = (newStart >> 16) & 0xFF;
+        tail.size[0] = (tailSize + stored) & 0xFF;
+        tail.size[1] = ((tailSize + stored) >> 8) & 0xFF;
+        tail.size[2] = ((tailSize + stored) >> 16) & 0xFF;
+        if (!updateFATEntry(tailIndex, tail))
+        {
+            reloadMetadata();
+            return false;
+        }
+    }
+    else
+    {
+        FS_FATEntry linkEntry = tail;
+        linkEntry.status = MJOLN_FILE_SYSTEM_FAT_LINK;
+        linkEntry.link = MJOLN_FILE_NOT_FOUND;
+        linkEntry.startAddr[0] = addr & 0xFF;
+        linkEntry.startAddr[1] = (addr >> 8) & 0xFF;
+        linkEntry.startAddr[2] = (addr >> 16) & 0xFF;
+        linkEntry.size[0] = stored & 0xFF;
+        linkEntry.size[1] = (stored >> 8) & 0xFF;
+        linkEntry.size[2] = (stored >> 16) & 0xFF;
+
+        // The new extent is complete on the EEPROM before the chain points to it.
+        tail.link = linkIndex;
+        if (!writeFATEntry(linkIndex, linkEntry) || !updateFATEntry(tailIndex, tail))
+        {
+            reloadMetadata();
+            return false;
+        }
+        claimFATEntry(linkIndex);
+        tailIndex = linkIndex;
+    }
+
+    syncDataTop();
+    _bootSector.bytesInUse += stored;
+    rememberTail(headIndex, tailIndex);
+
+    if (!writeSuperblock())
+    {
+        MJOLN_LOG_ERROR("Failed to write superblock.\n");
+        reloadMetadata();
+        return false;
+    }
+    // The extent's old place is only given up once the copy is committed.
+    if (relocate)
+    {
+        _allocator.release(tailStart, tailSize);
+        syncDataTop();
+    }
+
+    if (MJOLN_LOGGING(MJOLN_LOG_LEVEL_DEBUG))
+    {
+        printLogf("\nFILE APPEND LOGS\n");
+        printLogf("----------------\n");
+        printLogf("File appended successfully.\n");
+        printLogf("File name: %s\n", tail.filename);
+        printLogf("Appended size: %lu bytes\n", (unsigned long)length);
+        printLogf("Extent FAT index: %u\n\n", tailIndex);
+    }
+    return true;
+}
+
 uint32_t MjolnFileSystem::readFile(const char *filename, char *buffer)
 {
     if (!isFileSystemInitialized())
@@ -282,399 +696,616 @@ uint32_t MjolnFileSystem::readFile(const char *filename, char *buffer)
     {
         uint32_t length = tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16);
         uint32_t startAddr = tempFatEntry.startAddr[0] | (tempFatEntry.startAddr[1] << 8) | (tempFatEntry.startAddr[2] << 16);
-        uint32_t totalLength = length;
-        printLogs("Reading file...\n");
-        while (true)
+        uint32_t totalLength = 0;
+        MJOLN_LOG_DEBUG("Reading file...\n");
+        if (tempFatEntry.flags & MJOLN_FILE_FLAG_COMPRESSED)
         {
-            eepromReadBytes(MJOLN_STORAGE_DEVICE_ADDRESS, startAddr, getAddressSize(), (uint8_t *)buffer, length, getPageSize());
-            if (tempFatEntry.link != MJOLN_FILE_NOT_FOUND)
+            // Compressed data is decoded through a handle, straight into the caller's buffer.
+            MjolnFile file = open(filename);
+            while (file && totalLength < file.size())
             {
+                uint16_t chunk = min(file.size() - totalLength, (uint32_t)0xFFFF);
+                if (file.read(buffer + totalLength, chunk) != chunk)
+                {
+                    MJOLN_LOG_ERROR("Failed to decompress the file.\n");
+                    break;
+                }
+                totalLength += chunk;
+            }
+        }
+        else
+        {
+            // A failed read ends the file there, as with MjolnFile::read(), so only bytes that were read count.
+            bool failed = false;
+            while (!failed)
+            {
+                for (uint32_t done = 0; done < length; done += 0xFFFF)
+                {
+                    uint16_t chunk = min(length - done, (uint32_t)0xFFFF);
+                    if (!storageRead(startAddr + done, (uint8_t *)buffer + totalLength, chunk))
+                    {
+                        MJOLN_LOG_ERROR("Failed to read the file.\n");
+                        failed = true;
+                        break;
+                    }
+                    totalLength += chunk;
+                }
+                if (failed || tempFatEntry.link == MJOLN_FILE_NOT_FOUND)
+                    break;
+
                 uint16_t nextIndex = tempFatEntry.link;
                 tempFatEntry = readFATEntry(nextIndex);
                 startAddr = tempFatEntry.startAddr[0] | (tempFatEntry.startAddr[1] << 8) | (tempFatEntry.startAddr[2] << 16);
                 length = tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16);
-                buffer += length;
-                totalLength += length;
             }
-            else
-                break;
+        }
 
-            buffer[totalLength] = '\0';
-            if (logEnabled)
-            {
-                printLogs("\nFILE READ LOGS\n");
-                printLogs("----------------\n");
-                printLogs("File read successfully.\n");
-                printLogs("File name: " + String(tempFatEntry.filename) + "\n");
-                printLogs("File size: " + String(totalLength) + " bytes\n");
-                printLogs("File start address: " + String(startAddr) + "\n");
-                printLogs("File data: ");
-                for (size_t i = 0; i < totalLength; i++)
-                    printLogs(String(buffer[i]));
-                printLogs("\n\n");
-            }
-            return totalLength;
+        buffer[totalLength] = '\0';
+        if (MJOLN_LOGGING(MJOLN_LOG_LEVEL_DEBUG))
+        {
+            printLogf("\nFILE READ LOGS\n");
+            printLogf("----------------\n");
+            printLogf("File read successfully.\n");
+            printLogf("File name: %s\n", tempFatEntry.filename);
+            printLogf("File size: %lu bytes\n", (unsigned long)totalLength);
+            printLogf("File start address: %lu\n", (unsigned long)startAddr);
+            printLogf("File data: ");
+            printLogData(buffer, totalLength);
+            printLogf("\n\n");
         }
-        printLogs("File not found.\n");
-        return 0;
+        return totalLength;
     }
+    MJOLN_LOG_ERROR("File not found.\n");
+    return 0;
+}
+
+MjolnFile MjolnFileSystem::open(const char *filename)
+{
+    MjolnFile file;
+    if (!isFileSystemInitialized())
+        return file;
 
-    bool MjolnFileSystem::deleteFile(const char *filename)
+    uint16_t index = checkFileExistence(filename);
+    if (index == MJOLN_FILE_NOT_FOUND)
     {
-        if (!isFileSystemInitialized())
-            return false;
+        MJOLN_LOG_ERROR("File not found.\n");
+        return file;
+    }
 
-        uint16_t i = checkFileExistence(filename);
-        if (i != MJOLN_FILE_NOT_FOUND)
-        {
-            tempFatEntry.status = 0;
-            if (updateFATEntry(i, tempFatEntry))
-            {
-                uint32_t length = tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16);
-                uint32_t startAddr = tempFatEntry.startAddr[0] | (tempFatEntry.startAddr[1] << 8) | (tempFatEntry.startAddr[2] << 16);
-                printLogs("Deleting file...\n");
-                if (eepromDeleteMemoryRange(MJOLN_STORAGE_DEVICE_ADDRESS, startAddr, getAddressSize(), length, getPageSize()))
-                {
-                    if ((_bootSector.lastDataAddr[0] | (_bootSector.lastDataAddr[1] << 8) | (_bootSector.lastDataAddr[2] << 16)) - length == startAddr)
-                    {
-                        _bootSector.lastDataAddr[0] = (startAddr - length) & 0xFF;
-                        _bootSector.lastDataAddr[1] = ((startAddr - length) >> 8) & 0xFF;
-                        _bootSector.lastDataAddr[2] = ((startAddr - length) >> 16) & 0xFF;
-                    }
-                    _bootSector.bytesInUse -= length;
-                    _bootSector.deleted++;
-                    deleteLinks(tempFatEntry.link);
-                    writeBootSector(_bootSector);
-                    delay(5);
-                    _bootSector = readBootSector();
-                }
-                else
-                {
-                    printLogs("Failed to delete the file.\n");
-                    tempFatEntry.status = 1;
-                    updateFATEntry(i, tempFatEntry);
-                    return false;
-                }
-                if (logEnabled)
-                {
-                    printLogs("\nFILE DELETE LOGS\n");
-                    printLogs("----------------\n");
-                    printLogs("File deleted successfully.\n");
-                    printLogs("File name: " + String(tempFatEntry.filename) + "\n");
-                    printLogs("File size: " + String(length) + " bytes\n");
-                    printLogs("File start address: " + String(startAddr) + "\n");
-                    printLogs("File status: DELETED\n\n");
-                }
-                return true;
-            }
-        }
-        printLogs("File not found.\n");
-        return false;
+    file._fs = this;
+    file._headIndex = index;
+    strncpy(file._name, tempFatEntry.filename, MJOLN_FILE_NAME_MAX_LENGTH);
+    if (!file.resolve(index, 0))
+    {
+        MJOLN_LOG_WARN("Broken link chain.\n");
+        file.close();
+        return file;
     }
 
-    bool MjolnFileSystem::deleteLinks(uint32_t firstLinkIndex)
+    file._packed = tempFatEntry.flags & MJOLN_FILE_FLAG_COMPRESSED;
+    // Handle number 0 means the decoder belongs to no handle.
+    if (++_handleCounter == 0)
+        _handleCounter = 1;
+    file._decodeId = _handleCounter;
+    for (uint8_t i = 0; i < file._extentCount; i++)
+        file._size += file._extents[i].length;
+
+    // Links past the resolved window only contribute their sizes; they are resolved again when reached.
+    uint16_t next = file._windowNext;
+    for (uint16_t hops = 0; next != MJOLN_FILE_NOT_FOUND; hops++)
     {
-        while (firstLinkIndex != MJOLN_FILE_NOT_FOUND)
+        FS_FATEntry entry = readFATEntry(next);
+        if (entry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE || hops > _fatEntryCount)
         {
-            FS_FATEntry linkEntry = readFATEntry(firstLinkIndex);
-            if (linkEntry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE)
-            {
-                printLogs("Link entry not found.\n");
-                return false;
-            }
-            uint32_t temp = linkEntry.link;
-            linkEntry.link = MJOLN_FILE_NOT_FOUND;
-            linkEntry.status = MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE;
-            if (!updateFATEntry(firstLinkIndex, linkEntry))
-            {
-                printLogs("Failed to update link entry.\n");
-                return false;
-            }
-            firstLinkIndex = temp;
+            MJOLN_LOG_WARN("Broken link chain.\n");
+            file.close();
+            return file;
         }
-        return true;
+        file._size += entry.size[0] | (entry.size[1] << 8) | (entry.size[2] << 16);
+        next = entry.link;
     }
 
-    uint16_t MjolnFileSystem::newLinkEntry(uint16_t length)
+    file._storedSize = file._size;
+    if (file._packed && !file.measurePacked())
     {
-        if (!isFileSystemInitialized())
-            return MJOLN_FILE_NOT_FOUND;
+        MJOLN_LOG_WARN("Broken compressed block.\n");
+        file.close();
+    }
+    return file;
+}
+
+bool MjolnFileSystem::deleteFile(const char *filename, bool secureErase)
+{
+    if (!isFileSystemInitialized())
+        return false;
+    abortCompaction();
+    discardFATChanges();
 
-        for (uint16_t i = 0; i < voidFATEntryCacheSize; i++)
+    uint16_t i = checkFileExistence(filename);
+    if (i != MJOLN_FILE_NOT_FOUND)
+    {
+        FS_FATEntry fatEntry = tempFatEntry;
+        uint32_t length = fatEntry.size[0] | (fatEntry.size[1] << 8) | (fatEntry.size[2] << 16);
+        uint32_t startAddr = fatEntry.startAddr[0] | (fatEntry.startAddr[1] << 8) | (fatEntry.startAddr[2] << 16);
+        uint32_t linkBytes = 0;
+        MJOLN_LOG_DEBUG("Deleting file...\n");
+
+        // The entries are marked deleted in the inactive FAT copy and committed by the superblock. Space is
+        // only released afterwards, so a delete that fails halfway leaves the file whole.
+        fatEntry.status = MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE;
+        if (!updateFATEntry(i, fatEntry) || !deleteLinks(fatEntry.link, linkBytes))
         {
-            if (length >= voidFATEntryCache[i])
-                return voidFATEntryCache[i];
+            MJOLN_LOG_ERROR("Failed to delete the file.\n");
+            discardFATChanges();
+            return false;
+        }
+        _bootSector.bytesInUse -= length + linkBytes;
+        _bootSector.deleted++;
+        if (!writeSuperblock())
+        {
+            MJOLN_LOG_ERROR("Failed to write superblock.\n");
+            reloadMetadata();
+            return false;
         }
-        return MJOLN_FILE_NOT_FOUND;
-    }
 
-    void MjolnFileSystem::findAllVoidFATEntries()
-    {
-        if (!isFileSystemInitialized())
-            return;
+        _fileIndex.remove(fatEntry.filename, i);
+        forgetTail(i);
+        _liveFileCount--;
+        releaseFATEntry(i);
+        // The data is left in place unless asked for; only the metadata says the space is free.
+        if (!releaseExtents(startAddr, length, fatEntry.link, secureErase))
+            MJOLN_LOG_ERROR("Failed to erase the file data.\n");
+        syncDataTop();
 
-        for (uint16_t i = 1; i <= _fatEntryCount; i++)
+        if (MJOLN_LOGGING(MJOLN_LOG_LEVEL_DEBUG))
         {
-            tempFatEntry = readFATEntry(i);
-            if (tempFatEntry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE && tempFatEntry.link != MJOLN_FILE_NOT_FOUND)
-                voidFATEntryCache[voidFATEntryCacheSize++] = i;
+            printLogf("\nFILE DELETE LOGS\n");
+            printLogf("----------------\n");
+            printLogf("File deleted successfully.\n");
+            printLogf("File name: %s\n", fatEntry.filename);
+            printLogf("File size: %lu bytes\n", (unsigned long)length);
+            printLogf("File start address: %lu\n", (unsigned long)startAddr);
+            printLogf("File status: DELETED\n\n");
         }
+        return true;
     }
+    MJOLN_LOG_ERROR("File not found.\n");
+    return false;
+}
 
-    uint16_t MjolnFileSystem::checkFileExistence(const char *filename)
+bool MjolnFileSystem::deleteLinks(uint32_t firstLinkIndex, uint32_t &bytes)
+{
+    // The link fields are kept so releaseExtents() can still walk the chain once the delete is committed.
+    for (uint16_t hops = 0; firstLinkIndex != MJOLN_FILE_NOT_FOUND; hops++)
     {
-        return findFileFromCache(filename);
+        FS_FATEntry linkEntry = readFATEntry(firstLinkIndex);
+        if (linkEntry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE || hops > _fatEntryCount)
+        {
+            MJOLN_LOG_ERROR("Link entry not found.\n");
+            return false;
+        }
+        linkEntry.status = MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE;
+        if (!updateFATEntry(firstLinkIndex, linkEntry))
+        {
+            MJOLN_LOG_ERROR("Failed to update link entry.\n");
+            return false;
+        }
+        bytes += linkEntry.size[0] | (linkEntry.size[1] << 8) | (linkEntry.size[2] << 16);
+        firstLinkIndex = linkEntry.link;
     }
+    return true;
+}
 
-    void MjolnFileSystem::listFiles()
+bool MjolnFileSystem::releaseExtents(uint32_t startAddr, uint32_t length, uint16_t link, bool erase)
+{
+    bool erased = !erase || storageErase(startAddr, length);
+    _allocator.release(startAddr, length);
+    for (uint16_t hops = 0; link != MJOLN_FILE_NOT_FOUND && hops <= _fatEntryCount; hops++)
     {
-        if (!isFileSystemInitialized())
-            return;
+        FS_FATEntry linkEntry = readFATEntry(link);
+        uint32_t linkStart = linkEntry.startAddr[0] | (linkEntry.startAddr[1] << 8) | (linkEntry.startAddr[2] << 16);
+        uint32_t linkLength = linkEntry.size[0] | (linkEntry.size[1] << 8) | (linkEntry.size[2] << 16);
+        if (erase && !storageErase(linkStart, linkLength))
+            erased = false;
+        _allocator.release(linkStart, linkLength);
+        releaseFATEntry(link);
+        link = linkEntry.link;
+    }
+    return erased;
+}
 
-        bool logState = logEnabled;
-        showLogs(true);
+uint16_t MjolnFileSystem::findTailEntry(uint16_t headIndex, FS_FATEntry &tail)
+{
+    for (uint8_t i = 0; i < MJOLN_FILE_SYSTEM_APPEND_TAILS; i++)
+    {
+        if (_appendTails[i].headIndex != headIndex)
+            continue;
 
-        printLogs("FILES LIST\nroot\\\n");
-        for (uint16_t i = 1; i <= _fatEntryCount; i++)
+        // Link entries carry the name of their file, which guards against a slot that was reused meanwhile.
+        FS_FATEntry entry = readFATEntry(_appendTails[i].tailIndex);
+        if (entry.link == MJOLN_FILE_NOT_FOUND && entry.status != MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE &&
+            strncmp(entry.filename, tail.filename, MJOLN_FILE_NAME_MAX_LENGTH - 1) == 0)
         {
-            tempFatEntry = readFATEntry(i);
-            if (tempFatEntry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE)
-                continue;
-            printLogs("     " + String(tempFatEntry.filename) + (i % 8 == 0 ? "\n" : ""));
+            tail = entry;
+            return _appendTails[i].tailIndex;
         }
-        printLogs("\n");
-
-        showLogs(logState);
+        _appendTails[i].headIndex = MJOLN_FILE_NOT_FOUND;
+        break;
     }
 
-    void MjolnFileSystem::showLogs(bool show)
+    uint16_t index = headIndex;
+    for (uint16_t hops = 0; tail.link != MJOLN_FILE_NOT_FOUND; hops++)
     {
-        logEnabled = show;
+        index = tail.link;
+        tail = readFATEntry(index);
+        if (tail.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE || hops > _fatEntryCount)
+            return MJOLN_FILE_NOT_FOUND;
     }
+    return index;
+}
 
-    uint8_t MjolnFileSystem::getPageSize()
+void MjolnFileSystem::rememberTail(uint16_t headIndex, uint16_t tailIndex)
+{
+    FS_AppendTail *slot = &_appendTails[0];
+    for (uint8_t i = 0; i < MJOLN_FILE_SYSTEM_APPEND_TAILS; i++)
     {
-        switch (_eepromType)
+        if (_appendTails[i].headIndex == headIndex)
         {
-        case AT24C04:
-        case AT24C08:
-        case AT24C16:
-            return 16;
-        case AT24C32:
-        case AT24C64:
-            return 32;
-        case AT24C128:
-        case AT24C256:
-            return 64;
-        case AT24C512:
-            return 128;
-        default:
-            return 0;
+            slot = &_appendTails[i];
+            break;
         }
+        if (_appendTails[i].lastUse < slot->lastUse)
+            slot = &_appendTails[i];
     }
+    slot->headIndex = headIndex;
+    slot->tailIndex = tailIndex;
+    slot->lastUse = ++_appendCounter;
+}
+
+void MjolnFileSystem::forgetTail(uint16_t headIndex)
+{
+    for (uint8_t i = 0; i < MJOLN_FILE_SYSTEM_APPEND_TAILS; i++)
+        if (_appendTails[i].headIndex == headIndex)
+            _appendTails[i].headIndex = MJOLN_FILE_NOT_FOUND;
+}
+
+void MjolnFileSystem::setFATEntryCount(uint16_t count)
+{
+    _fatEntryCount = count;
+    _bootSector.fileCount[0] = count & 0xFF;
+    _bootSector.fileCount[1] = (count >> 8) & 0xFF;
+}
+
+uint16_t MjolnFileSystem::newLinkEntry()
+{
+    // FAT entries are appended while the chunks the FAT has taken still hold the next one.
+    bool canGrow = _fatEntryCount < fatCapacity();
+
+    // With wear leveling every entry is used once before deleted ones are reused, in FAT order from
+    // the last one taken, so rewriting files moves their metadata across the whole FAT.
+    if (canGrow && isWearLeveling())
+        return _fatEntryCount + 1;
+
+    if (voidFATEntryCacheSize == 0 && voidFATEntriesDropped)
+        findAllVoidFATEntries();
+    if (voidFATEntryCacheSize > 0)
+        return voidFATEntryCache[isWearLeveling() ? 0 : voidFATEntryCacheSize - 1];
+
+    // Only a FAT without a reusable entry takes another chunk.
+    if (!canGrow)
+        canGrow = growFAT();
+    return canGrow ? _fatEntryCount + 1 : MJOLN_FILE_NOT_FOUND;
+}
 
-    uint16_t MjolnFileSystem::getUsableSize()
+void MjolnFileSystem::claimFATEntry(uint16_t index)
+{
+    for (uint8_t i = 0; i < voidFATEntryCacheSize; i++)
     {
-        return _eepromSize - sizeof(FS_BootSector) - (_fatEntryCount * sizeof(FS_FATEntry));
+        if (voidFATEntryCache[i] != index)
+            continue;
+        memmove(&voidFATEntryCache[i], &voidFATEntryCache[i + 1], (voidFATEntryCacheSize - i - 1) * sizeof(uint16_t));
+        voidFATEntryCacheSize--;
+        break;
     }
+    _fatCursor = index + 1;
+    if (index > _fatEntryCount)
+        setFATEntryCount(index);
+}
+
+void MjolnFileSystem::releaseFATEntry(uint16_t index)
+{
+    // With wear leveling the entry is found again by the next search from the FAT cursor instead of
+    // being reused right away.
+    if (!isWearLeveling() && voidFATEntryCacheSize < MJOLN_FILE_SYSTEM_VOID_FAT_CACHE)
+        voidFATEntryCache[voidFATEntryCacheSize++] = index;
+    else
+        voidFATEntriesDropped = true;
+}
 
-    uint16_t MjolnFileSystem::getReservedSize()
+void MjolnFileSystem::findAllVoidFATEntries()
+{
+    voidFATEntryCacheSize = 0;
+    voidFATEntriesDropped = false;
+    if (isWearLeveling())
     {
-        switch (_eepromType)
+        for (uint16_t n = 0; n < _fatEntryCount; n++)
         {
-        case AT24C04:
-            return 136;
-        case AT24C08:
-            return 256;
-        case AT24C16:
-            return 496;
-        case AT24C32:
-            return 916;
-        case AT24C64:
-            return 1816;
-        case AT24C128:
-            return 3016;
-        case AT24C256:
-            return 4216;
-        case AT24C512:
-            return 6016;
-        default:
-            return 0;
+            uint16_t i = (_fatCursor + _fatEntryCount - 1 + n) % _fatEntryCount + 1;
+            if (readFATEntry(i).status != MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE)
+                continue;
+            if (voidFATEntryCacheSize == MJOLN_FILE_SYSTEM_VOID_FAT_CACHE)
+            {
+                voidFATEntriesDropped = true;
+                break;
+            }
+            voidFATEntryCache[voidFATEntryCacheSize++] = i;
         }
+        return;
     }
 
-    AT24CX_ADDR_SIZE MjolnFileSystem::getAddressSize()
+    for (uint16_t i = _fatEntryCount; i >= 1; i--)
     {
-        return (_eepromType == AT24C04 || _eepromType == AT24C08 || _eepromType == AT24C16) ? AT24CX_8Bit : AT24CX_16Bit;
+        tempFatEntry = readFATEntry(i);
+        if (tempFatEntry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE)
+            releaseFATEntry(i);
     }
+}
 
-    float MjolnFileSystem::getStorageUsage()
-    {
-        if (!isFileSystemInitialized())
-            return -1;
+void MjolnFileSystem::syncDataTop()
+{
+    uint32_t top = _allocator.top();
+    _bootSector.lastDataAddr[0] = top & 0xFF;
+    _bootSector.lastDataAddr[1] = (top >> 8) & 0xFF;
+    _bootSector.lastDataAddr[2] = (top >> 16) & 0xFF;
+}
 
-        printLogs("\nSTORAGE USAGE\n-------------\n");
-        float usage = (_bootSector.bytesInUse * 100) / (pow(2, (uint8_t)_eepromType));
-        printLogs(String(usage) + "\% used from available space.\n");
-        printLogs("Total: " + String((uint32_t)pow(2, (uint8_t)_eepromType)) + " bytes, " + String(getReservedSize()) + " bytes reserved by file system.\n\n");
-        return usage;
-    }
+void MjolnFileSystem::setAllocationPolicy(FS_AllocationPolicy policy)
+{
+    _allocator.setPolicy(policy);
+}
 
-    uint32_t MjolnFileSystem::getBytesUsed()
-    {
-        if (!isFileSystemInitialized())
-            return 0;
+uint16_t MjolnFileSystem::checkFileExistence(const char *filename)
+{
+    return findFileFromCache(filename);
+}
 
-        printLogs("\nSTORAGE USAGE\n-------------\n");
-        printLogs(String(_bootSector.bytesInUse) + " bytes used from available space.\n");
-        printLogs("Total: " + String((uint32_t)pow(2, (uint8_t)_eepromType)) + " bytes, " + String(getReservedSize()) + " bytes reserved by file system.\n\n");
-        return _bootSector.bytesInUse;
-    }
+void MjolnFileSystem::listFiles()
+{
+    if (!isFileSystemInitialized())
+        return;
 
-    void MjolnFileSystem::printFileInfo(const char *filename)
+    printLogf("FILES LIST\nroot\\\n");
+    for (uint16_t i = 1; i <= _fatEntryCount; i++)
     {
-        if (!isFileSystemInitialized())
-            return;
+        tempFatEntry = readFATEntry(i);
+        if (tempFatEntry.status != MJOLN_FILE_SYSTEM_FAT_AVAILABLE)
+            continue;
+        printLogf("     %s%s", tempFatEntry.filename, i % 8 == 0 ? "\n" : "");
+    }
+    printLogf("\n");
+}
 
-        bool logState = logEnabled;
-        showLogs(true);
+void MjolnFileSystem::showLogs(bool show)
+{
+    _logEnabled = show;
+}
 
-        if (checkFileExistence(filename))
-        {
-            uint32_t length = tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16);
-            uint32_t startAddr = tempFatEntry.startAddr[0] | (tempFatEntry.startAddr[1] << 8) | (tempFatEntry.startAddr[2] << 16);
-            printLogs("\nFILE INFORMATION\n");
-            printLogs("----------------\n");
-            printLogs("File name: " + String(tempFatEntry.filename) + "\n");
-            printLogs("File size: " + String(length) + "\n");
-            printLogs("File start address: " + String(startAddr) + "\n");
-            printLogs("\n\n");
-        }
-        else
-            printLogs("File not found!\n");
+uint32_t MjolnFileSystem::getUsableSize()
+{
+    return dataEnd() - dataStart();
+}
 
-        showLogs(logState);
-    }
+uint32_t MjolnFileSystem::getReservedSize()
+{
+    // The boot sector and the superblock ring sit in front of the data area, the FAT behind it.
+    return _eepromSize - getUsableSize();
+}
+
+float MjolnFileSystem::getStorageUsage()
+{
+    if (!isFileSystemInitialized())
+        return -1;
 
-    void MjolnFileSystem::printFileSystemInfo()
+    float usage = (_bootSector.bytesInUse * 100.0f) / _eepromSize;
+    if (MJOLN_LOGGING(MJOLN_LOG_LEVEL_INFO))
     {
-        if (!isFileSystemInitialized())
-            return;
+        uint32_t hundredths = (uint32_t)(usage * 100 + 0.5f);
+        printLogf("\nSTORAGE USAGE\n-------------\n");
+        printLogf("%lu.%02lu%% used from available space.\n", (unsigned long)(hundredths / 100), (unsigned long)(hundredths % 100));
+        printLogf("Total: %lu bytes, %lu bytes reserved by file system.\n\n", (unsigned long)_eepromSize, (unsigned long)getReservedSize());
+    }
+    return usage;
+}
 
-        bool logState = logEnabled;
-        showLogs(true);
+FS_Stats MjolnFileSystem::getStats()
+{
+#if MJOLN_ENABLE_STATS
+    return mjolnStats;
+#else
+    FS_Stats stats = {0};
+    return stats;
+#endif
+}
+
+void MjolnFileSystem::resetStats()
+{
+#if MJOLN_ENABLE_STATS
+    memset(&mjolnStats, 0, sizeof(mjolnStats));
+#endif
+}
 
-        printLogs("\nMjoln File System\n-----------------\n");
-        printLogs("EEPROM type: " + String(_eepromType) + "\n");
-        printLogs("File system version: " + String(_bootSector.version) + "\n");
-        printLogs("File system signature: " + String(_bootSector.signature) + "\n");
-        printLogs("File count: " + String((_bootSector.fileCount[0] | _bootSector.fileCount[1] << 8) - (uint16_t)_bootSector.deleted) + "\n");
-        printLogs("Total size: " + String((uint32_t)pow(2, (uint8_t)_eepromType)) + " Bytes\n");
-        printLogs("Available size: " + String((uint32_t)pow(2, (uint8_t)_eepromType) - _bootSector.bytesInUse - getReservedSize()) + " Bytes\n");
-        printLogs("Reserved size: " + String(getReservedSize()) + " Bytes\n");
-        printLogs("Address size: " + String(getAddressSize() ? "16 bit\n" : "8 bit\n"));
-        printLogs("Page size: " + String(getPageSize()) + " Bytes\n");
-        printLogs("Storage use: " + String((_bootSector.bytesInUse * 100) / (pow(2, (uint8_t)_eepromType))) + "%\n\n");
+uint32_t MjolnFileSystem::getBytesUsed()
+{
+    if (!isFileSystemInitialized())
+        return 0;
 
-        showLogs(logState);
+    if (MJOLN_LOGGING(MJOLN_LOG_LEVEL_INFO))
+    {
+        printLogf("\nSTORAGE USAGE\n-------------\n");
+        printLogf("%lu bytes used from available space.\n", (unsigned long)_bootSector.bytesInUse);
+        printLogf("Total: %lu bytes, %lu bytes reserved by file system.\n\n", (unsigned long)_eepromSize, (unsigned long)getReservedSize());
     }
+    return _bootSector.bytesInUse;
+}
+
+void MjolnFileSystem::printFileInfo(const char *filename)
+{
+    if (!isFileSystemInitialized())
+        return;
 
-    void MjolnFileSystem::terminal()
+    if (checkFileExistence(filename))
     {
-        if (!isFileSystemInitialized())
-            return;
+        uint32_t length = tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16);
+        uint32_t startAddr = tempFatEntry.startAddr[0] | (tempFatEntry.startAddr[1] << 8) | (tempFatEntry.startAddr[2] << 16);
+        printLogf("\nFILE INFORMATION\n");
+        printLogf("----------------\n");
+        printLogf("File name: %s\n", tempFatEntry.filename);
+        printLogf("File size: %lu\n", (unsigned long)length);
+        printLogf("File start address: %lu\n", (unsigned long)startAddr);
+        if (tempFatEntry.recordSize != 0)
+            printLogf("Records: %lu x %u bytes\n", (unsigned long)(length / tempFatEntry.recordSize), tempFatEntry.recordSize);
+        if (tempFatEntry.flags & MJOLN_FILE_FLAG_COMPRESSED)
+            printLogf("Compressed, %lu bytes uncompressed\n", (unsigned long)open(filename).size());
+        printLogf("\n\n");
+    }
+    else
+        printLogf("File not found!\n");
+}
 
-        String inputString = "";
-        Serial.println("MJOLN FILE SYSTEM TERMINAL");
-        Serial.print("\nmjolnFS@v1> ");
-        showLogs(false);
+void MjolnFileSystem::printFileSystemInfo()
+{
+    if (!isFileSystemInitialized())
+        return;
+
+    uint32_t hundredths = (uint32_t)((_bootSector.bytesInUse * 10000ULL + _eepromSize / 2) / _eepromSize);
+    printLogf("\nMjoln File System\n-----------------\n");
+    printLogf("EEPROM type: %u\n", _eepromType);
+    printLogf("File system version: %u\n", _bootSector.version);
+    printLogf("File system signature: %.*s\n", (int)MJOLN_FILE_SYSTEM_SIGNATURE_SIZE, _bootSector.signature);
+    printLogf("File count: %u\n", _liveFileCount);
+    printLogf("Total size: %lu Bytes\n", (unsigned long)_eepromSize);
+    printLogf("Available size: %lu Bytes\n", (unsigned long)(_eepromSize - _bootSector.bytesInUse - getReservedSize()));
+    printLogf("Reserved size: %lu Bytes\n", (unsigned long)getReservedSize());
+    printLogf("FAT: %u of %u entries, %u in place\n", _fatEntryCount, _bootSector.fatLimit, fatCapacity());
+    printLogf("Chips: %u\n", _chipCount);
+    printLogf("Address size: %s\n", getAddressSize() ? "16 bit" : "8 bit");
+    printLogf("Page size: %u Bytes\n", getPageSize());
+    if (isWearLeveling())
+        printLogf("Wear leveling: on, %u superblock slots\n", _bootSector.superblockSlots);
+    else
+        printLogf("Wear leveling: off\n");
+    printLogf("Storage use: %lu.%02lu%%\n\n", (unsigned long)(hundredths / 100), (unsigned long)(hundredths % 100));
+}
+
+void MjolnFileSystem::terminal()
+{
+    if (!isFileSystemInitialized())
+        return;
+
+    String inputString = "";
+    Serial.println("MJOLN FILE SYSTEM TERMINAL");
+    Serial.print("\nmjolnFS@v1> ");
+    bool logState = _logEnabled;
+    _logEnabled = false;
 
-        while (true)
+    while (true)
+    {
+        if (Serial.available() > 0)
         {
-            if (Serial.available() > 0)
-            {
-                char inputChar = Serial.read();
-                yield();
+            char inputChar = Serial.read();
+            yield();
 
-                if (inputChar == '\n')
-                {
-                    inputString.trim();
+            if (inputChar == '\n')
+            {
+                inputString.trim();
 
-                    if (inputString.equals("exit"))
-                    {
-                        Serial.println("Exiting...");
-                        break;
-                    }
-                    Serial.println(inputString);
-                    processCommand(inputString);
-                    inputString = "";
-                    Serial.print("\nmjolnFS@v1> ");
-                }
-                else
+                if (inputString.equals("exit"))
                 {
-                    inputString += inputChar;
+                    Serial.println("Exiting...");
+                    break;
                 }
+                Serial.println(inputString);
+                processCommand(inputString);
+                inputString = "";
+                Serial.print("\nmjolnFS@v1> ");
+            }
+            else
+            {
+                inputString += inputChar;
             }
         }
-        showLogs(true);
     }
+    _logEnabled = logState;
+}
 
-    bool MjolnFileSystem::isFileSystemInitialized()
-    {
-        if (!isInit)
-            printLogs("File system is not initialized. Possible reasons could be:\n-> Incompatible EEPROM\n-> Skipped mount method\n-> Connection failure to EEPROM\n\n");
-        return isInit;
-    }
+bool MjolnFileSystem::isFileSystemInitialized()
+{
+    if (!isInit)
+        MJOLN_LOG_ERROR("File system is not initialized. Possible reasons could be:\n-> Incompatible EEPROM\n-> Skipped mount method\n-> Connection failure to EEPROM\n\n");
+    return isInit;
+}
 
-    uint16_t MjolnFileSystem::findFileFromCache(const char *filename)
-    {
-        uint16_t pos = MJOLN_FILE_NOT_FOUND;
+uint16_t MjolnFileSystem::findFileFromCache(const char *filename)
+{
+    if (_fatEntryCount == 0)
+        return MJOLN_FILE_NOT_FOUND;
 
-        if (_fatEntryCount > 0)
+    uint16_t cursor = 0;
+    uint16_t index;
+    while ((index = _fileIndex.nextCandidate(filename, cursor)) != MJOLN_FILE_NOT_FOUND)
+    {
+        tempFatEntry = readFATEntry(index);
+        if (tempFatEntry.status == MJOLN_FILE_SYSTEM_FAT_AVAILABLE && strncmp(tempFatEntry.filename, filename, MJOLN_FILE_NAME_MAX_LENGTH - 1) == 0)
         {
-            char filesBuffer[fileLookupList.length() + 1];
-            strcpy(filesBuffer, fileLookupList.c_str());
-
-            char *token = strtok(filesBuffer, ",");
-            uint16_t index = loadBalancingState ? _fatEntryCount / 2 : 1;
-
-            while (token != NULL)
-            {
-                if (strcmp(token, filename) == 0)
-                {
-                    tempFatEntry = readFATEntry(index);
-                    if (tempFatEntry.status)
-                    {
-                        pos = index;
-                        break;
-                    }
-                }
-                token = strtok(NULL, ",");
-                index++;
-            }
+            MJOLN_STAT_ADD(lookupHits, 1);
+            return index;
         }
+    }
 
-        if (loadBalancingState && pos == MJOLN_FILE_NOT_FOUND)
-            for (uint16_t i = 1; i <= _fatEntryCount / 2; i++)
-            {
-                tempFatEntry = readFATEntry(i);
-                if (tempFatEntry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE)
-                    continue;
-                if (strcmp(tempFatEntry.filename, filename) == 0)
-                    pos = i;
-            }
+    MJOLN_STAT_ADD(lookupMisses, 1);
+    if (_fileIndex.isComplete())
+        return MJOLN_FILE_NOT_FOUND;
 
-        return pos;
+    // Some files did not fit in the index, so a miss has to be confirmed against the FAT itself.
+    for (uint16_t i = 1; i <= _fatEntryCount; i++)
+    {
+        tempFatEntry = readFATEntry(i);
+        if (tempFatEntry.status == MJOLN_FILE_SYSTEM_FAT_AVAILABLE && strncmp(tempFatEntry.filename, filename, MJOLN_FILE_NAME_MAX_LENGTH - 1) == 0)
+            return i;
     }
+    return MJOLN_FILE_NOT_FOUND;
+}
 
-    void MjolnFileSystem::runInitialIndexingAndStore()
+void MjolnFileSystem::runInitialIndexingAndStore()
+{
+    uint32_t lastDataAddr = _bootSector.lastDataAddr[0] | (_bootSector.lastDataAddr[1] << 8) | (_bootSector.lastDataAddr[2] << 16);
+    _allocator.begin(dataStart(), dataEnd(), lastDataAddr, getPageSize());
+    _allocator.setCursor(_superblock.allocCursor[0] | (_superblock.allocCursor[1] << 8) | (_superblock.allocCursor[2] << 16));
+    _fatCursor = _superblock.fatCursor[0] | (_superblock.fatCursor[1] << 8);
+    _fileIndex.clear();
+    memset(_appendTails, 0, sizeof(_appendTails));
+    _compaction.fatIndex = MJOLN_FILE_NOT_FOUND;
+    _liveFileCount = 0;
+    voidFATEntryCacheSize = 0;
+    voidFATEntriesDropped = false;
+
+    // One pass over the FAT builds the filename index, the free space and the list of reusable entries.
+    for (uint16_t i = _fatEntryCount; i >= 1; i--)
     {
-        if (_fatEntryCount == 0)
-            return;
-        loadBalancingState = _fatEntryCount >= MJOLN_FILE_SYSTEM_CACHING_LIMIT;
-        for (uint16_t i = (_fatEntryCount < MJOLN_FILE_SYSTEM_CACHING_LIMIT ? 1 : (_fatEntryCount / 2)); i <= _fatEntryCount; i++)
+        tempFatEntry = readFATEntry(i);
+        if (tempFatEntry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE)
+        {
+            releaseFATEntry(i);
+            continue;
+        }
+
+        _allocator.reserve(tempFatEntry.startAddr[0] | (tempFatEntry.startAddr[1] << 8) | (tempFatEntry.startAddr[2] << 16),
+                           tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16));
+        if (tempFatEntry.status == MJOLN_FILE_SYSTEM_FAT_AVAILABLE)
         {
-            tempFatEntry = readFATEntry(i);
-            fileLookupList += String(tempFatEntry.filename) + (i < _fatEntryCount ? "," : "");
+            _fileIndex.insert(tempFatEntry.filename, i);
+            _liveFileCount++;
         }
     }
+    syncDataTop();
+}
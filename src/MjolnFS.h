@@ -6,21 +6,94 @@
 #include "MjolnFS.h"
 #include "MjolnConst.h"
 #include "FS_BootSector.h"
+#include "FS_Superblock.h"
 #include "FileSystemManager.h"
 #include "FS_FATEntry.h"
+#include "FS_PageCache.h"
+#include "FS_WriteQueue.h"
+#include "FS_Lz.h"
+#include "FS_FileIndex.h"
+#include "FS_ExtentAllocator.h"
+#include "FS_ChipGeometry.h"
+#include "MjolnFile.h"
 #include <Wire.h>
 #include <Arduino.h>
 
-enum AT24CXType
+/**
+ * @brief Remembers the last extent of a file's link chain so appends do not walk the chain.
+ */
+struct FS_AppendTail
+{
+    uint16_t headIndex; // FAT index of the file, or MJOLN_FILE_NOT_FOUND if the slot is unused
+    uint16_t tailIndex; // FAT index of the last extent of the file
+    uint32_t lastUse;   // Append counter value at the last use, for replacement
+};
+
+/**
+ * @brief Steps of a file system check, in the order they run.
+ */
+enum FS_FsckPhase
+{
+    FS_FSCK_IDLE,     // No check in progress
+    FS_FSCK_ENTRIES,  // Both copies of every FAT entry are checked against their CRC and repaired from each other
+    FS_FSCK_CHAINS,   // Every file's link chain is walked and cut where it leads astray
+    FS_FSCK_ORPHANS,  // Link extents no file reaches are freed
+    FS_FSCK_OVERLAPS, // Extents sharing bytes are counted
+    FS_FSCK_COUNTERS, // The bytes in use and the file count are compared with what was found
+};
+
+/**
+ * @brief Findings of the last file system check, see MjolnFileSystem::fsck().
+ */
+struct FS_FsckReport
+{
+    uint16_t entriesChecked; // FAT entries examined
+    uint16_t repaired;       // Entries whose damaged copy was rewritten from the intact one
+    uint16_t dropped;        // Entries damaged in both copies or holding impossible values, now free
+    uint16_t brokenChains;   // Link chains cut where they led to an entry that was not a link of their own
+    uint16_t orphanLinks;    // Link extents that belonged to no file, now free
+    uint16_t overlaps;       // Pairs of extents sharing bytes; only reported, the data cannot tell which is right
+    bool countersFixed;      // The bytes in use recorded in the superblock were corrected
+    bool complete;           // The check ran to the end
+};
+
+/**
+ * @brief A file system check in progress, carried across fsckStep() calls.
+ */
+struct FS_FsckJob
+{
+    FS_FsckPhase phase;                                 // Step being run
+    uint16_t index;                                     // Next FAT entry the step looks at
+    uint32_t sequence;                                  // Superblock the check is based on; any other commit restarts it
+    uint32_t bytesInUse;                                // Bytes of the files reached so far
+    uint16_t files;                                     // Files reached so far
+    uint8_t linked[MJOLN_FILE_SYSTEM_FAT_BITMAP_BYTES]; // Entries reached through a file's chain
+};
+
+/**
+ * @brief Gathers compressed bytes so that each page they land on is written once.
+ */
+struct FS_PackWriter
+{
+    MjolnFileSystem *fs;                          // File system the bytes are written to
+    uint32_t addr;                                // Volume address of the first staged byte
+    uint16_t fill;                                // Number of staged bytes
+    uint8_t stage[MJOLN_COMPRESS_STAGE_BYTES];    // Staged bytes, never crossing a page boundary
+};
+
+/**
+ * @brief A relocation in progress, carried across compactStep() calls.
+ */
+struct FS_CompactionJob
 {
-    AT24C04 = 0x09,
-    AT24C08 = 0x0A,
-    AT24C16 = 0x0B,
-    AT24C32 = 0x0C,
-    AT24C64 = 0x0D,
-    AT24C128 = 0x0E,
-    AT24C256 = 0x0F,
-    AT24C512 = 0x10,
+    uint16_t fatIndex;     // FAT entry being relocated, or MJOLN_FILE_NOT_FOUND when idle
+    bool merge;            // The whole link chain is collapsed into one extent
+    uint32_t destAddr;     // Start of the space the data is copied to
+    uint32_t length;       // Number of bytes to copy
+    uint32_t copied;       // Number of bytes copied so far
+    uint16_t srcIndex;     // FAT entry of the extent being copied
+    uint32_t srcAddr;      // Next source byte to copy
+    uint32_t srcRemaining; // Bytes left in the current source extent
 };
 
 /**
@@ -35,8 +108,18 @@ public:
     /**
      * @brief Constructs the MjolnFileSystem object.
      * @param eepromModel Specifies the EEPROM type from AT24CXType enum.
+     * @param chipCount Number of identical EEPROMs the volume spans, at consecutive addresses from 0x50.
+     * @note Pages are striped across the chips, so a page write on one chip overlaps the write cycle of the
+     * others and capacity adds up. AT24C04/08/16 occupy 2, 4 and 8 addresses each, which limits them to 4, 2
+     * and 1 chips; larger parts allow MJOLN_MAX_CHIPS.
+     * @note A chipCount outside that range is logged and mount(), format() and cleanFormat() then fail.
+     */
+    MjolnFileSystem(AT24CXType eepromModel, uint8_t chipCount = 1);
+
+    /**
+     * @brief Releases the RAM held by the file system. Pending cached writes are not flushed.
      */
-    MjolnFileSystem(AT24CXType eepromModel);
+    virtual ~MjolnFileSystem();
 
     /**
      * @brief Initializes and mounts the file system.
@@ -50,9 +133,67 @@ public:
      * @brief Writes data to a file.
      * @param filename Name of the file to write to.
      * @param data Data to be written.
+     * @param compress Set to true to store the file compressed.
      * @return True if write operation is successful, false otherwise.
+     * @note Compressed files are packed in blocks of MJOLN_COMPRESS_BLOCK_BYTES with a small-window LZ scheme,
+     * which typically shrinks configuration and log text 2 to 4 times and cuts the page programs and bus
+     * bytes of every later read and write by as much. Blocks that do not shrink are stored as they are.
+     * @note Compressing takes about 300 bytes of stack; reading takes a 256-byte window allocated the first time.
+     */
+    bool writeFile(const char *filename, const char *data, bool compress = false);
+
+    /**
+     * @brief Appends data to the end of a file, creating the file if it does not exist.
+     * @param filename Name of the file to append to.
+     * @param data Data to be appended.
+     * @param compress Used if the file is created: set to true to store it compressed. An existing file stays
+     * the way it was written.
+     * @return True if append operation is successful, false otherwise.
+     * @note The file's last extent grows in place if it ends where free space starts, and then only the new
+     * bytes and its metadata are written. Otherwise a last extent of up to MJOLN_FILE_SYSTEM_APPEND_MERGE_PAGES
+     * pages is copied, with the new data behind it, to where both fit, and a longer one gets a new extent
+     * chained to it through a FAT link.
+     * @note Appended data is packed on its own, so appending to a compressed file in larger pieces compresses better.
+     */
+    bool appendFile(const char *filename, const char *data, bool compress = false);
+
+    /**
+     * @brief Creates a file of fixed-size records.
+     * @param filename Name of the file to create.
+     * @param recordSize Size of a record in bytes.
+     * @param recordCount Number of records the file holds.
+     * @return True if the file was created, false otherwise.
+     * @note The records are stored back to back in one extent and start out as 0xFF bytes. The record size
+     * is kept in the FAT entry, so @fn readRecord() and @fn writeRecord() find a record from the file's
+     * start address without reading anything else.
+     * @note Record files keep their size: @fn appendFile() and @fn updateFile() refuse them.
+     */
+    bool createRecordFile(const char *filename, uint16_t recordSize, uint16_t recordCount);
+
+    /**
+     * @brief Reads one record of a record file.
+     * @param filename Name of the record file.
+     * @param index Number of the record, from 0.
+     * @param record Buffer of at least the record size.
+     * @return True if the record was read, false otherwise.
+     */
+    bool readRecord(const char *filename, uint16_t index, void *record);
+
+    /**
+     * @brief Overwrites one record of a record file.
+     * @param filename Name of the record file.
+     * @param index Number of the record, from 0.
+     * @param record Bytes of the record, as many as the record size.
+     * @return True if the record was written, false otherwise.
+     * @note Only the pages under the record are touched, and of those only the ones whose contents change
+     * are programmed. No metadata is written, so a reset during the write can leave the record half updated.
+     */
+    bool writeRecord(const char *filename, uint16_t index, const void *record);
+
+    /**
+     * @brief Returns the number of records in a record file, or 0 if the file is not a record file.
      */
-    bool writeFile(const char *filename, const char *data);
+    uint16_t getRecordCount(const char *filename);
 
     /**
      * @brief Reads data from a file.
@@ -63,22 +204,37 @@ public:
      */
     uint32_t readFile(const char *filename, char *buffer);
 
+    /**
+     * @brief Opens a file for streaming reads and writes.
+     * @param filename Name of the file to open.
+     * @return A handle to the file; it evaluates to false if the file was not found.
+     * @note The FAT entry and link chain are resolved once here, so data can be read in chunks of any size
+     * without a buffer holding the whole file.
+     */
+    MjolnFile open(const char *filename);
+
     /**
      * @brief Updates data in a file.
      * @param filename Name of the file to write to.
      * @param data Data to be written.
+     * @param secureErase Set to true to overwrite the old data that is no longer part of the file with 0xFF.
      * @return True if update operation is successful, false otherwise.
-     * @note Overwrites existing content if the file already exists.
+     * @note The new contents are written to free space and a single metadata commit switches the file over to
+     * them, so a reset leaves either the old or the new file. The old space is released afterwards.
+     * @note With @fn enableInPlaceUpdates(), contents that fit in an uncompressed file's single extent are
+     * written over the old bytes instead, programming only the pages that change.
      */
-    bool updateFile(const char *filename, const char *data);
+    bool updateFile(const char *filename, const char *data, bool secureErase = false);
 
     /**
      * @brief Deletes a specified file.
      * @param filename Name of the file to delete.
+     * @param secureErase Set to true to overwrite the file's data with 0xFF after it is deleted.
      * @return True if deletion succeeds, false otherwise.
-     * @note Deleted files cannot be recovered.
+     * @note Deleted files cannot be recovered through the file system. By default only the metadata is
+     * updated and the old bytes stay on the EEPROM until the space is reused.
      */
-    bool deleteFile(const char *filename);
+    bool deleteFile(const char *filename, bool secureErase = false);
 
     /**
      * @brief Lists all available files in the system.
@@ -100,23 +256,29 @@ public:
     void printFileInfo(const char *filename);
 
     /**
-     * @brief Formats the file system, erasing all data and reset the bootsector.
+     * @brief Formats the file system by writing a fresh boot sector and superblock.
      * @return True if formatting succeeds, false otherwise.
      * @note **WARNING:** This action deletes all stored files permanently.
+     * @note This is a quick format: it takes a few write cycles, and the old FAT and file data stay on the chip,
+     * unreferenced, until they are overwritten. Call @fn cleanFormat() first to wipe them.
      */
     bool format();
 
     /**
-     * @brief Formats the file system, erasing all data. This doesn't reflash the bootsector.
-     * @return True if formatting succeeds, false otherwise.
-     * @note **WARNING:** This action deletes all stored files permanently. Bootsector will be cleared.
+     * @brief Erases the whole EEPROM page by page. This doesn't reflash the bootsector.
+     * @param progress Called after every page with the bytes erased so far, may be NULL.
+     * @return True if erasing succeeds, false otherwise.
+     * @note **WARNING:** This action deletes all stored files permanently. Bootsector will be cleared, so
+     * @fn format() has to follow before the EEPROM can be mounted again.
+     * @note Takes one write cycle per page that is not blank yet, several seconds on the larger parts.
      */
-    bool cleanFormat();
+    bool cleanFormat(FS_ProgressCallback progress = NULL);
 
     /**
-     * @brief Enables or disables system logs.
+     * @brief Enables or disables system logs for this instance.
      * @param show Set to true to enable logs, false to disable.
-     * @note Logs display system activity for debugging purposes.
+     * @note Logs display system activity for debugging purposes. Messages above MJOLN_LOG_LEVEL
+     *       are not compiled in at all; disabled ones cost a flag test and format nothing.
      */
     void showLogs(bool show);
 
@@ -133,48 +295,510 @@ public:
      */
     uint32_t getBytesUsed();
 
+    /**
+     * @brief Returns the performance counters gathered since start or since @fn resetStats().
+     * @note The counters are kept when MJOLN_ENABLE_STATS is 1, its default. Defining it as 0 compiles every
+     * count out and getStats() then returns zeros.
+     */
+    FS_Stats getStats();
+
+    /**
+     * @brief Clears the performance counters.
+     */
+    void resetStats();
+
+    /**
+     * @brief Enables the write-back page cache.
+     * @param pages Number of EEPROM pages to hold in RAM.
+     * @return True if the cache was allocated, false otherwise.
+     * @note Writes landing on the same page are merged and each dirty page is programmed once when flushed.
+     * Dirty pages reach the EEPROM only when they are evicted, on @fn flush() or on @fn format().
+     */
+    bool enableWriteCache(uint8_t pages = MJOLN_FILE_SYSTEM_CACHE_PAGES);
+
+    /**
+     * @brief Flushes and releases the write-back page cache.
+     */
+    void disableWriteCache();
+
+    /**
+     * @brief Programs every dirty page held by the write-back cache.
+     * @return True if all pages were written, false otherwise.
+     * @note Call before power may be lost when the write cache is enabled.
+     * @note Also drains the asynchronous write queue and waits for the write cycles still running on any
+     * chip of the volume, so it is the barrier after which every earlier operation is on the EEPROM.
+     */
+    bool flush();
+
+    /**
+     * @brief Switches to asynchronous writes.
+     * @param pages Number of page programs the queue holds in RAM.
+     * @return True if the queue was allocated, false otherwise.
+     * @note File operations then queue their page programs and return without waiting for a write cycle;
+     * @fn poll() sends them to the EEPROM one at a time. Reads see queued data, and an operation only blocks
+     * when the queue is full or when it reads from a chip that is still busy.
+     * @note Page programs leave the queue in the order they were made, so a reset leaves the same states
+     * behind as with blocking writes.
+     */
+    bool enableAsyncWrites(uint8_t pages = MJOLN_WRITE_QUEUE_PAGES);
+
+    /**
+     * @brief Drains the write queue and returns to blocking writes.
+     */
+    void disableAsyncWrites();
+
+    /**
+     * @brief Advances the asynchronous write queue by at most one I2C transaction. Never sleeps.
+     * @return True while writes are queued, running or waiting to be reported.
+     * @note Call from loop(). Completion callbacks are run from here and from @fn flush().
+     */
+    bool poll();
+
+    /**
+     * @brief Sets the function called when a queued operation has reached the EEPROM.
+     * @param callback Called with the ticket of the operation, may be NULL.
+     */
+    void onWriteComplete(FS_CompletionCallback callback);
+
+    /**
+     * @brief Returns the ticket of the most recently queued operation.
+     * @note Operations that leave more than MJOLN_WRITE_QUEUE_TICKETS reports outstanding share the ticket
+     * of the operation before them.
+     */
+    uint32_t lastTicket();
+
+    /**
+     * @brief Keeps a copy of the FAT in RAM.
+     * @return True if the mirror is in use, false if it could not be loaded.
+     * @note The mirror is filled with a few sequential reads at mount and updated on every FAT write,
+     * so lookups, listings and link walks cost no I2C traffic. Uses one FAT entry of RAM per file.
+     */
+    bool enableFATMirror();
+
+    /**
+     * @brief Releases the RAM copy of the FAT. FAT entries are read from the EEPROM again.
+     */
+    void disableFATMirror();
+
+    /**
+     * @brief Selects where new file data is placed.
+     * @param policy FS_ALLOCATE_BEST_FIT fills the smallest hole left by deleted data that fits;
+     * FS_ALLOCATE_PAGE_ALIGNED additionally starts data on a page boundary when that saves a page program;
+     * FS_ALLOCATE_NEXT_FIT takes the first space after the previous allocation, wrapping around the chip.
+     * @note Free space is rebuilt from the FAT at mount, so space freed by deletes is reused without formatting.
+     */
+    void setAllocationPolicy(FS_AllocationPolicy policy);
+
+    /**
+     * @brief Selects whether the next format() sets the EEPROM up for wear leveling.
+     * @param enable true to spread metadata and data writes over the chip.
+     * @note The superblock then rotates over MJOLN_FILE_SYSTEM_SUPERBLOCK_SLOTS page-sized slots instead of
+     * rewriting one, file data is allocated with FS_ALLOCATE_NEXT_FIT and every FAT entry is used once
+     * before deleted ones are reused.
+     * @note The choice is stored in the boot sector; mount() adopts whatever the EEPROM was formatted with.
+     */
+    void enableWearLeveling(bool enable = true);
+
+    /**
+     * @brief Lets updateFile() rewrite a file's bytes where they are.
+     * @param enable true to overwrite uncompressed single-extent files in place when the new contents fit.
+     * @note Only the pages whose contents change are programmed and no free space is needed, but the update
+     * is not crash atomic: a reset during it can leave the file with its old length and partly new bytes.
+     * Off by default.
+     */
+    void enableInPlaceUpdates(bool enable = true);
+
+    /**
+     * @brief Sets how many FAT entries the next format() lets the FAT grow to.
+     * @param entries Entries per FAT copy, at most MJOLN_FILE_SYSTEM_MAX_FILES, which is also the default.
+     * @note Every file takes one entry, and each extent an append adds to it another one.
+     * @note The FAT starts empty and takes MJOLN_FILE_SYSTEM_FAT_CHUNK_PAGES pages per copy at a time, a page's worth
+     * of entries for every 8 bytes of page size, from the end of the data area when it fills. That space has to be free; compact() moves data away from it.
+     * Writes that need an entry fail once the limit is reached.
+     * @note The limit is stored in the boot sector; mount() adopts whatever the EEPROM was formatted with.
+     */
+    void setFATLimit(uint16_t entries);
+
+    /**
+     * @brief Moves at most MJOLN_COMPACT_STEP_BYTES of file data towards a compact layout.
+     * @return True if there is more compaction work, false when the layout is compact or on error.
+     * @note Files with link chains are first collapsed into a single extent, then extents are slid down
+     * into the holes below them. Data is copied into free space and the FAT entry is switched to the copy
+     * only once it is complete, so an interrupted move leaves the file intact.
+     * @note Any file operation cancels the move in progress; it is restarted by the next call.
+     * Close open MjolnFile handles before compacting.
+     */
+    bool compactStep();
+
+    /**
+     * @brief Runs compactStep() until the layout is compact or the time budget is used up.
+     * @param budgetMs Maximum time to spend, in milliseconds.
+     * @return True if there is more compaction work, false when the layout is compact.
+     * @note Meant to be called from loop() while the device is idle.
+     */
+    bool compact(uint32_t budgetMs);
+
+    /**
+     * @brief Runs one step of a file system check: one FAT entry of the current phase.
+     * @return True if there is more checking to do, false when the check is complete.
+     * @note The check verifies both copies of each FAT entry against their CRC and rewrites a damaged copy
+     * from the intact one, frees entries that are lost or hold impossible values, cuts link chains that loop
+     * or lead to entries of another file, frees link extents no file reaches, counts overlapping extents and
+     * corrects the bytes in use. Repairs are committed through the superblock like any other change.
+     * @note A file operation between steps restarts the check. Close open MjolnFile handles before checking.
+     */
+    bool fsckStep();
+
+    /**
+     * @brief Runs fsckStep() until the check is complete or the time budget is used up.
+     * @param budgetMs Maximum time to spend, in milliseconds.
+     * @return True if there is more checking to do, false when the check is complete.
+     * @note Meant to be called from loop() while the device is idle, for example while @fn needsFsck() is true.
+     */
+    bool fsck(uint32_t budgetMs);
+
+    /**
+     * @brief Checks whether a damaged FAT entry was met since the last complete check.
+     * @note Mount verifies the CRC of every entry it reads. A damaged entry is read from the other FAT copy
+     * when that copy is in sync, and treated as free otherwise, until a check repairs the FAT.
+     */
+    bool needsFsck();
+
+    /**
+     * @brief Returns the findings of the check in progress, or of the last one.
+     */
+    FS_FsckReport getFsckReport();
+
     /**
      * @brief Handles user commands via a serial terminal.
      * @note Supports file manipulation, system queries, and formatting operations.
      */
     void terminal();
 
+protected:
+    /**
+     * @brief Constructs the file system from a chip geometry that is already known.
+     * @note Used by MjolnFS<Model>, which passes compile-time constants.
+     */
+    MjolnFileSystem(AT24CXType eepromModel, uint8_t chipCount, uint32_t chipBytes, uint8_t pageSize,
+                    AT24CX_ADDR_SIZE addressSize, uint8_t addressesPerChip);
+
+    /**
+     * @brief The device layer every transfer to the chips goes through.
+     * @note These run readChips(), programChips() and sendQueuedToChips() with the geometry read from members;
+     * MjolnFS<Model> overrides them with the instantiations for its compile-time geometry.
+     */
+    virtual bool deviceRead(uint32_t addr, uint8_t *buffer, uint16_t length);
+    virtual bool deviceWrite(uint32_t addr, const uint8_t *data, uint16_t length);
+    virtual bool deviceErase(uint32_t addr, uint32_t length);
+    virtual bool sendQueuedWrite(bool wait);
+
+    /**
+     * @brief Reads a range of the volume from the chips it is striped over.
+     * @param geometry FS_Geometry, or FS_FixedGeometry for a geometry known at compile time.
+     */
+    template <class Geometry>
+    bool readChips(const Geometry &geometry, uint32_t addr, uint8_t *buffer, uint16_t length);
+
+    /**
+     * @brief Programs a range of the volume, or queues it with asynchronous writes.
+     * @param data Bytes to program, or NULL to program 0xFF.
+     */
+    template <class Geometry>
+    bool programChips(const Geometry &geometry, uint32_t addr, const uint8_t *data, uint32_t length);
+
+    /**
+     * @brief Sends the oldest queued write, or the next transmission of it when not waiting.
+     */
+    template <class Geometry>
+    bool sendQueuedToChips(const Geometry &geometry, bool wait);
+
 private:
-    uint8_t _deviceAddress; // I2C address of the EEPROM
-    uint32_t _eepromSize;   // Size of the EEPROM in bytes
+    friend class MjolnFile;
+
+    uint8_t _deviceAddress; // I2C address of the first EEPROM
+    uint8_t _chipCount;     // EEPROMs the volume is striped over
+    uint8_t _chipCountRequested; // Chip count passed to the constructor, kept to reject one out of range
+    uint8_t _chipBusy = 0;  // Chips whose last write cycle may still be running, one bit each
+    uint32_t _chipSequence[MJOLN_MAX_CHIPS] = {0}; // Queued write each chip was last sent
+    uint32_t _sentSequence = 0;                    // Last queued write sent to a chip
+    uint32_t _eepromSize;   // Size of the volume in bytes
     uint16_t _pageSize;     // Size of a page in EEPROM
+    uint8_t _addressesPerChip;    // I2C addresses one chip answers on
+    AT24CX_ADDR_SIZE _addressSize; // How the chips take the memory address
     const char *signature;  // File system signature
     AT24CXType _eepromType; // Type of the EEPROM
     bool isInit = false;
-    bool loadBalancingState = false;
 
     FS_BootSector _bootSector;
+    FS_Superblock _superblock = {0};
+    uint8_t _superblockSlot = 0;
+    uint8_t _activeFAT = 0;
+    uint8_t _fatStale[MJOLN_FILE_SYSTEM_FAT_BITMAP_BYTES] = {0};   // Entries the inactive FAT copy is behind on
+    uint8_t _fatPending[MJOLN_FILE_SYSTEM_FAT_BITMAP_BYTES] = {0}; // Entries written to the inactive copy by the update in progress
+    bool _fatPendingAny = false;
+    bool _wearLevelingRequested = false;
+    bool _inPlaceUpdates = false; // updateFile() may overwrite a file's extent directly
+    uint16_t _fatLimitRequested = MJOLN_FILE_SYSTEM_MAX_FILES;
+    uint8_t _fatChunks = 0; // FAT chunks below the end of the volume
+    bool _logEnabled = true; // Read by the MJOLN_LOG_* macros
     FS_FATEntry tempFatEntry;
     uint16_t _fatEntryCount;
-    String fileLookupList;
-    uint16_t *voidFATEntryCache;
-    uint16_t voidFATEntryCacheSize = 0;
+    uint16_t _liveFileCount = 0;
+    FS_FileIndex _fileIndex;
+    FS_AppendTail _appendTails[MJOLN_FILE_SYSTEM_APPEND_TAILS];
+    uint32_t _appendCounter = 0;
+    FS_CompactionJob _compaction = {MJOLN_FILE_NOT_FOUND};
+    FS_FsckJob _fsck = {FS_FSCK_IDLE};
+    FS_FsckReport _fsckReport = {0};
+    bool _fatDamaged = false;
+    uint16_t voidFATEntryCache[MJOLN_FILE_SYSTEM_VOID_FAT_CACHE];
+    uint8_t voidFATEntryCacheSize = 0;
+    bool voidFATEntriesDropped = false;
+    uint16_t _fatCursor = 1;
+    FS_ExtentAllocator _allocator;
+    FS_PageCache _writeCache;
+    FS_WriteQueue _writeQueue;
+    FS_CompletionCallback _onWriteComplete = NULL;
+    FS_LzDecoder _decoder;
+    uint16_t _decoderOwner = 0;    // Handle the decoder state belongs to, 0 for none
+    uint32_t _decoderBlock = 0;    // Stored offset of the block being decoded
+    uint32_t _decoderPosition = 0; // File offset of the next byte the decoder produces
+    uint32_t _decoderInput = 0;    // Stored offset of the next compressed byte to fetch
+    uint16_t _handleCounter = 0;
+    FS_FATEntry *_fatMirror = NULL;
+    uint16_t _fatMirrorSize = 0;
+    uint16_t _fatMirrorCapacity = 0;
+    bool _fatMirrorEnabled = false;
 
     FS_BootSector readBootSector();
     bool writeBootSector(const FS_BootSector &bootSector);
+    uint32_t superblockAddress(uint8_t slot);
+    uint8_t superblockSlotsFor(bool wearLeveling);
+    bool loadSuperblock();
+    bool writeSuperblock();
+    bool isWearLeveling();
+    uint16_t fatChunkCopySize();
+    uint16_t fatChunkEntries();
+    uint32_t dataStart();
+    uint32_t dataEnd();
+    uint16_t fatCapacity();
+    bool growFAT();
+    uint32_t fatEntryAddress(uint16_t index, uint8_t copy);
+    bool storeFATEntry(uint16_t index, const FS_FATEntry &entry);
+    bool syncInactiveFAT();
+    void discardFATChanges();
+    bool reloadMetadata();
+    bool checkChipCount();
     FS_FATEntry readFATEntry(uint16_t index);
+    FS_FATEntry decodeFATEntry(uint16_t index, uint8_t copy, uint8_t *buffer);
+    bool validFATEntry(uint16_t index, const FS_FATEntry &entry);
     bool writeFATEntry(uint16_t index, const FS_FATEntry &entry);
     bool updateFATEntry(uint16_t index, const FS_FATEntry &entry);
+    bool loadFATMirror();
+    bool reserveFATMirror(uint16_t entries);
+    void mirrorFATEntry(uint16_t index, const FS_FATEntry &entry);
+    bool storageRead(uint32_t addr, uint8_t *buffer, uint16_t length);
+    bool storageWrite(uint32_t addr, const uint8_t *data, uint16_t length);
+    bool storageUpdate(uint32_t addr, const uint8_t *data, uint16_t length);
+    bool storageErase(uint32_t addr, uint32_t length);
+    bool copyData(uint32_t from, uint32_t to, uint32_t length);
+    uint32_t packedLength(const uint8_t *data, uint32_t length);
+    bool writePacked(uint32_t addr, const uint8_t *data, uint32_t length);
+    bool writeData(uint32_t addr, const uint8_t *data, uint32_t length, bool packed);
+    static bool packSink(void *context, const uint8_t *data, uint16_t length);
+    uint8_t chipAddress(uint8_t chip);
+    FS_Geometry geometry() const;
+    template <class Geometry>
+    static uint32_t chipOffset(const Geometry &geometry, uint32_t addr, uint8_t &chip);
+    template <class Geometry>
+    static uint16_t stripeChunk(const Geometry &geometry, uint32_t addr, uint32_t length);
+    bool waitForChip(uint8_t chip, uint32_t timeoutUs = MJOLN_WRITE_CYCLE_TIMEOUT_US);
+    bool waitForChips();
+    bool queueWrite(uint32_t addr, const uint8_t *data, uint32_t length);
+    void reportCompletions();
+    bool completeOperation();
+    bool flushCachedPage(FS_CachedPage *page);
+    bool flushWriteCache();
     uint16_t checkFileExistence(const char *filename);
     bool isFileSystemInitialized();
-    uint8_t getPageSize();
-    uint16_t getUsableSize();
-    uint16_t getReservedSize();
+    uint8_t getPageSize() { return _pageSize; }
+    uint32_t getUsableSize();
+    uint32_t getReservedSize();
     void processCommand(String command);
     void extractArgs(String command, String &filename, String &data);
     uint16_t findFileFromCache(const char *filename);
     void runInitialIndexingAndStore();
     void findAllVoidFATEntries();
-    void deleteLinks(uint32_t link);
-    uint16_t newLinkEntry(uint16_t length);
+    bool deleteLinks(uint32_t link, uint32_t &bytes);
+    bool releaseExtents(uint32_t startAddr, uint32_t length, uint16_t link, bool erase);
+    uint16_t findTailEntry(uint16_t headIndex, FS_FATEntry &tail);
+    void rememberTail(uint16_t headIndex, uint16_t tailIndex);
+    void forgetTail(uint16_t headIndex);
+    void setFATEntryCount(uint16_t count);
+    uint16_t newLinkEntry();
+    void claimFATEntry(uint16_t index);
+    void releaseFATEntry(uint16_t index);
+    void syncDataTop();
+    uint32_t recordAddress(const char *filename, uint16_t index, uint16_t &recordSize);
+    bool startCompactionJob();
+    bool commitCompactionJob();
+    void abortCompaction();
+    void startFsck();
+    bool checkFATCopies(uint16_t index);
+    bool checkChain(uint16_t index);
+    bool checkOrphan(uint16_t index);
+    void checkOverlaps(uint16_t index);
+    bool checkCounters();
+    bool commitFsckRepair();
 
-    AT24CX_ADDR_SIZE getAddressSize();
+    AT24CX_ADDR_SIZE getAddressSize() { return _addressSize; }
 };
 
+/**
+ * @brief MjolnFileSystem for an EEPROM model fixed at compile time.
+ * @tparam Model The EEPROM type from AT24CXType enum.
+ * @tparam Chips Number of identical EEPROMs the volume spans.
+ * @note The geometry comes from FS_ChipTraits, so an unsupported model or a chip count that does not fit
+ *       on the bus fails to compile instead of at mount().
+ * @note The device layer is overridden with its FS_FixedGeometry instantiation, so the transfers to the chips
+ *       use the page size, address size and chip count as constants.
+ */
+template <class Geometry>
+uint32_t MjolnFileSystem::chipOffset(const Geometry &geometry, uint32_t addr, uint8_t &chip)
+{
+    // Consecutive pages of the volume go to consecutive chips.
+    uint32_t page = addr / geometry.pageSize();
+    chip = page % geometry.chips();
+    return (page / geometry.chips()) * geometry.pageSize() + addr % geometry.pageSize();
+}
+
+template <class Geometry>
+uint16_t MjolnFileSystem::stripeChunk(const Geometry &geometry, uint32_t addr, uint32_t length)
+{
+    // A single chip maps the volume one to one, so a range is never split on its account.
+    uint32_t limit = geometry.chips() == 1 ? length : geometry.pageSize() - addr % geometry.pageSize();
+    return min(min(length, limit), (uint32_t)0xFFFF);
+}
+
+template <class Geometry>
+bool MjolnFileSystem::readChips(const Geometry &geometry, uint32_t addr, uint8_t *buffer, uint16_t length)
+{
+    for (uint16_t done = 0; done < length;)
+    {
+        uint8_t chip;
+        uint32_t offset = chipOffset(geometry, addr + done, chip);
+        uint16_t chunk = stripeChunk(geometry, addr + done, length - done);
+        if (!waitForChip(chip) || !eepromReadRange(geometry, chipAddress(chip), offset, buffer + done, chunk))
+            return false;
+        done += chunk;
+    }
+
+    // Queued writes are newer than what the chips hold.
+    if (_writeQueue.isEnabled())
+        _writeQueue.overlay(addr, buffer, length);
+    return true;
+}
+
+template <class Geometry>
+bool MjolnFileSystem::programChips(const Geometry &geometry, uint32_t addr, const uint8_t *data, uint32_t length)
+{
+    if (_writeQueue.isEnabled())
+        return queueWrite(addr, data, length);
+
+    // A chip is only waited for when it is addressed again, so the write cycles of the other chips
+    // overlap with the transfers in between.
+    while (length > 0)
+    {
+        uint8_t chip;
+        uint32_t offset = chipOffset(geometry, addr, chip);
+        uint16_t chunk = stripeChunk(geometry, addr, length);
+        if (!waitForChip(chip))
+            return false;
+        _chipBusy |= 1 << chip;
+        if (!eepromProgramRange(geometry, chipAddress(chip), offset, data, chunk, false))
+            return false;
+        if (data)
+            data += chunk;
+        addr += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+template <class Geometry>
+bool MjolnFileSystem::sendQueuedToChips(const Geometry &geometry, bool wait)
+{
+    FS_QueuedWrite *write = _writeQueue.front();
+    if (!write)
+        return true;
+
+    // Without waiting, a chip still in its write cycle costs this call's one address probe, and the write is
+    // sent by the next call; a page larger than the Wire buffer is sent one transmission per call.
+    uint8_t chip;
+    uint32_t offset = chipOffset(geometry, write->addr, chip);
+    if (!wait && (_chipBusy & (1 << chip)))
+    {
+        waitForChip(chip, 0);
+        return true;
+    }
+    if (!waitForChip(chip))
+        return false;
+
+    uint16_t length = wait ? write->length : eepromWriteChunk(geometry, offset, write->length);
+    bool sent = eepromProgramRange(geometry, chipAddress(chip), offset, write->data + write->addr % geometry.pageSize(), length, false);
+    _chipBusy |= 1 << chip;
+    _chipSequence[chip] = write->sequence;
+    if (sent && length < write->length)
+    {
+        _writeQueue.advance(length);
+        return true;
+    }
+    _sentSequence = write->sequence;
+    _writeQueue.pop(sent);
+    return sent;
+}
+
+template <AT24CXType Model, uint8_t Chips = 1>
+class MjolnFS : public MjolnFileSystem
+{
+public:
+    typedef FS_ChipTraits<Model> Geometry;
+
+    static_assert(Chips >= 1 && Chips * Geometry::addressCount <= MJOLN_MAX_CHIPS,
+                  "Chip count does not fit on the I2C bus for this model");
+
+    static constexpr uint32_t volumeSize = Geometry::size * Chips;
+
+    MjolnFS()
+        : MjolnFileSystem(Model, Chips, Geometry::size, Geometry::pageSize, Geometry::addressSize, Geometry::addressCount)
+    {
+    }
+
+protected:
+    bool deviceRead(uint32_t addr, uint8_t *buffer, uint16_t length) override
+    {
+        return readChips(FS_FixedGeometry<Model, Chips>(), addr, buffer, length);
+    }
+
+    bool deviceWrite(uint32_t addr, const uint8_t *data, uint16_t length) override
+    {
+        return programChips(FS_FixedGeometry<Model, Chips>(), addr, data, length);
+    }
+
+    bool deviceErase(uint32_t addr, uint32_t length) override
+    {
+        return programChips(FS_FixedGeometry<Model, Chips>(), addr, (const uint8_t *)NULL, length);
+    }
+
+    bool sendQueuedWrite(bool wait) override
+    {
+        return sendQueuedToChips(FS_FixedGeometry<Model, Chips>(), wait);
+    }
+};
+
+template <AT24CXType Model, uint8_t Chips>
+constexpr uint32_t MjolnFS<Model, Chips>::volumeSize;
+
 #endif // __cplusplus
 #endif // MJOLNFS_C
@@ -0,0 +1,246 @@
+#include "MjolnFS.h"
+
+MjolnFile::MjolnFile()
+    : _fs(NULL), _headIndex(MJOLN_FILE_NOT_FOUND), _size(0), _storedSize(0), _packed(false), _position(0), _extentCount(0), _windowOffset(0),
+      _windowNext(MJOLN_FILE_NOT_FOUND), _blockStored(0), _blockOffset(0), _blockRaw(0), _blockPacked(0), _decodeId(0)
+{
+    _name[0] = '\0';
+}
+
+uint16_t MjolnFile::read(void *buffer, uint16_t length)
+{
+    if (!isOpen())
+        return 0;
+    if (_packed)
+        return readPacked((uint8_t *)buffer, length);
+
+    uint16_t bytesRead = readStored(_position, (uint8_t *)buffer, length);
+    _position += bytesRead;
+    return bytesRead;
+}
+
+uint16_t MjolnFile::write(const void *data, uint16_t length)
+{
+    if (!isOpen() || _packed)
+        return 0;
+    _fs->abortCompaction();
+
+    uint16_t bytesWritten = 0;
+    while (bytesWritten < length && _position < _size)
+    {
+        uint32_t addr, contiguous;
+        if (!locate(_position, addr, contiguous))
+            break;
+
+        uint16_t chunk = min((uint32_t)(length - bytesWritten), min(contiguous, _size - _position));
+        if (!_fs->storageWrite(addr, (const uint8_t *)data + bytesWritten, chunk))
+            break;
+        bytesWritten += chunk;
+        _position += chunk;
+    }
+    if (!_fs->completeOperation())
+        return 0;
+    return bytesWritten;
+}
+
+bool MjolnFile::seek(uint32_t position)
+{
+    if (!isOpen() || position > _size)
+        return false;
+    _position = position;
+    return true;
+}
+
+void MjolnFile::close()
+{
+    _fs = NULL;
+    _size = 0;
+    _storedSize = 0;
+    _packed = false;
+    _blockRaw = 0;
+    _position = 0;
+    _extentCount = 0;
+}
+
+bool MjolnFile::resolve(uint16_t fatIndex, uint32_t offset)
+{
+    _extentCount = 0;
+    _windowOffset = offset;
+
+    uint16_t next = fatIndex;
+    while (next != MJOLN_FILE_NOT_FOUND && _extentCount < MJOLN_FILE_MAX_EXTENTS)
+    {
+        FS_FATEntry entry = _fs->readFATEntry(next);
+        if (entry.status == MJOLN_FILE_SYSTEM_FAT_UNAVAILABLE)
+            return false;
+
+        FS_Extent &extent = _extents[_extentCount++];
+        extent.startAddr = entry.startAddr[0] | (entry.startAddr[1] << 8) | (entry.startAddr[2] << 16);
+        extent.length = entry.size[0] | (entry.size[1] << 8) | (entry.size[2] << 16);
+        extent.fatIndex = next;
+        next = entry.link;
+    }
+    _windowNext = next;
+    return true;
+}
+
+bool MjolnFile::locate(uint32_t position, uint32_t &addr, uint32_t &contiguous)
+{
+    // Chains longer than the window are walked forward on demand and from the head when seeking back.
+    if (position < _windowOffset && !resolve(_headIndex, 0))
+        return false;
+
+    while (true)
+    {
+        uint32_t offset = _windowOffset;
+        for (uint8_t i = 0; i < _extentCount; i++)
+        {
+            if (position < offset + _extents[i].length)
+            {
+                addr = _extents[i].startAddr + (position - offset);
+                contiguous = _extents[i].length - (position - offset);
+                return true;
+            }
+            offset += _extents[i].length;
+        }
+
+        if (_windowNext == MJOLN_FILE_NOT_FOUND || !resolve(_windowNext, offset))
+            return false;
+    }
+}
+
+uint16_t MjolnFile::readStored(uint32_t offset, uint8_t *buffer, uint16_t length)
+{
+    uint16_t bytesRead = 0;
+    while (bytesRead < length && offset < _storedSize)
+    {
+        uint32_t addr, contiguous;
+        if (!locate(offset, addr, contiguous))
+            break;
+
+        uint16_t chunk = min((uint32_t)(length - bytesRead), min(contiguous, _storedSize - offset));
+        if (!_fs->storageRead(addr, buffer + bytesRead, chunk))
+            break;
+        bytesRead += chunk;
+        offset += chunk;
+    }
+    return bytesRead;
+}
+
+uint16_t MjolnFile::readPacked(uint8_t *buffer, uint16_t length)
+{
+    uint16_t bytesRead = 0;
+    while (bytesRead < length && _position < _size)
+    {
+        if (!findBlock(_position))
+            break;
+
+        uint16_t inBlock = _position - _blockOffset;
+        uint16_t chunk = min((uint16_t)(length - bytesRead), (uint16_t)(_blockRaw - inBlock));
+        uint16_t produced;
+        if (_blockPacked == _blockRaw)
+            produced = readStored(_blockStored + MJOLN_COMPRESS_BLOCK_HEADER + inBlock, buffer + bytesRead, chunk);
+        else
+        {
+            if (!syncDecoder())
+                break;
+            produced = _fs->_decoder.decode(buffer + bytesRead, chunk, packedSource, this);
+            _fs->_decoderPosition += produced;
+        }
+
+        bytesRead += produced;
+        _position += produced;
+        if (produced != chunk)
+            break;
+    }
+    return bytesRead;
+}
+
+bool MjolnFile::measurePacked()
+{
+    // Only the block headers are read; the data is decoded when it is read.
+    _size = 0;
+    _blockStored = 0;
+    _blockOffset = 0;
+    _blockRaw = 0;
+    while (_blockStored < _storedSize)
+    {
+        if (!readBlockHeader())
+            return false;
+        _size += _blockRaw;
+        _blockStored += MJOLN_COMPRESS_BLOCK_HEADER + _blockPacked;
+    }
+    _blockStored = 0;
+    _blockRaw = 0;
+    return true;
+}
+
+bool MjolnFile::readBlockHeader()
+{
+    uint8_t header[MJOLN_COMPRESS_BLOCK_HEADER];
+    if (readStored(_blockStored, header, sizeof(header)) != sizeof(header))
+        return false;
+
+    _blockRaw = header[0] | (header[1] << 8);
+    _blockPacked = header[2] | (header[3] << 8);
+    return _blockRaw > 0 && _blockPacked <= _blockRaw && _blockStored + sizeof(header) + _blockPacked <= _storedSize;
+}
+
+bool MjolnFile::findBlock(uint32_t position)
+{
+    // Blocks are walked forward through their headers, and from the first one when seeking back.
+    if (_blockRaw == 0 || position < _blockOffset)
+    {
+        _blockStored = 0;
+        _blockOffset = 0;
+        if (!readBlockHeader())
+            return false;
+    }
+    while (position >= _blockOffset + _blockRaw)
+    {
+        _blockOffset += _blockRaw;
+        _blockStored += MJOLN_COMPRESS_BLOCK_HEADER + _blockPacked;
+        if (!readBlockHeader())
+            return false;
+    }
+    return true;
+}
+
+bool MjolnFile::syncDecoder()
+{
+    if (_fs->_decoderOwner == _decodeId && _fs->_decoderBlock == _blockStored && _fs->_decoderPosition == _position)
+        return true;
+
+    // Another handle or a seek moved the decoder away; the block is decoded again up to the position.
+    if (!_fs->_decoder.begin())
+        return false;
+    _fs->_decoder.reset();
+    _fs->_decoderOwner = _decodeId;
+    _fs->_decoderBlock = _blockStored;
+    _fs->_decoderPosition = _blockOffset;
+    _fs->_decoderInput = _blockStored + MJOLN_COMPRESS_BLOCK_HEADER;
+    while (_fs->_decoderPosition < _position)
+    {
+        uint16_t skipped = _fs->_decoder.decode(NULL, _position - _fs->_decoderPosition, packedSource, this);
+        if (skipped == 0)
+        {
+            _fs->_decoderOwner = 0;
+            return false;
+        }
+        _fs->_decoderPosition += skipped;
+    }
+    return true;
+}
+
+uint16_t MjolnFile::packedSource(void *context, uint8_t *buffer, uint16_t length)
+{
+    MjolnFile *file = (MjolnFile *)context;
+    MjolnFileSystem *fs = file->_fs;
+    uint32_t end = file->_blockStored + MJOLN_COMPRESS_BLOCK_HEADER + file->_blockPacked;
+    if (fs->_decoderInput >= end)
+        return 0;
+
+    uint16_t bytesRead = file->readStored(fs->_decoderInput, buffer, min((uint32_t)length, end - fs->_decoderInput));
+    fs->_decoderInput += bytesRead;
+    return bytesRead;
+}
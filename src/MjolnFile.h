@@ -0,0 +1,124 @@
+#ifndef MJOLNFILE_H
+#define MJOLNFILE_H
+
+#include <Arduino.h>
+#include "MjolnConst.h"
+
+#ifdef __cplusplus
+
+class MjolnFileSystem;
+
+/**
+ * @brief A contiguous run of file data in EEPROM, described by one FAT entry.
+ */
+struct FS_Extent
+{
+    uint32_t startAddr; // Start address of the run in EEPROM
+    uint32_t length;    // Number of file bytes in the run
+    uint16_t fatIndex;  // FAT entry describing the run
+};
+
+/**
+ * @brief Handle to an open file of the Mjoln EEPROM File System.
+ *
+ * The FAT entry and link chain are resolved when the file is opened, after which data is read
+ * and written in caller-sized chunks at any offset. RAM use does not depend on the file size.
+ * @note Obtained from MjolnFileSystem::open(). Do not modify or delete the file through
+ * MjolnFileSystem, or compact the file system, while a handle to it is open.
+ * @note Compressed files are decoded as they are read and are read-only through a handle. Seeking costs
+ * decoding at most one block of MJOLN_COMPRESS_BLOCK_BYTES; handles share the file system's decoder, so
+ * interleaving reads of two compressed handles decodes their blocks again from the start.
+ */
+class MjolnFile
+{
+public:
+    MjolnFile();
+
+    /**
+     * @brief Checks if the handle refers to an open file.
+     */
+    bool isOpen() const { return _fs != NULL; }
+    operator bool() const { return isOpen(); }
+
+    /**
+     * @brief Reads up to length bytes from the current position.
+     * @param buffer Destination buffer, at least length bytes long.
+     * @param length Maximum number of bytes to read.
+     * @return Number of bytes read; 0 at the end of the file or on error.
+     */
+    uint16_t read(void *buffer, uint16_t length);
+
+    /**
+     * @brief Overwrites file data starting at the current position.
+     * @param data Bytes to write.
+     * @param length Number of bytes to write.
+     * @return Number of bytes written. Writes stop at the end of the file; compressed files take none.
+     */
+    uint16_t write(const void *data, uint16_t length);
+
+    /**
+     * @brief Moves the read/write position.
+     * @param position Offset from the start of the file.
+     * @return True if the position is within the file (the end included), false otherwise.
+     */
+    bool seek(uint32_t position);
+
+    /**
+     * @brief Returns the current read/write position.
+     */
+    uint32_t position() const { return _position; }
+
+    /**
+     * @brief Returns the size of the file in bytes, uncompressed.
+     */
+    uint32_t size() const { return _size; }
+
+    /**
+     * @brief Returns the number of bytes between the position and the end of the file.
+     */
+    uint32_t available() const { return _size - _position; }
+
+    /**
+     * @brief Returns the name of the file.
+     */
+    const char *name() const { return _name; }
+
+    /**
+     * @brief Closes the handle.
+     */
+    void close();
+
+private:
+    friend class MjolnFileSystem;
+
+    bool resolve(uint16_t fatIndex, uint32_t offset);
+    bool locate(uint32_t position, uint32_t &addr, uint32_t &contiguous);
+    uint16_t readStored(uint32_t offset, uint8_t *buffer, uint16_t length);
+    uint16_t readPacked(uint8_t *buffer, uint16_t length);
+    bool measurePacked();
+    bool readBlockHeader();
+    bool findBlock(uint32_t position);
+    bool syncDecoder();
+    static uint16_t packedSource(void *context, uint8_t *buffer, uint16_t length);
+
+    MjolnFileSystem *_fs;
+    char _name[MJOLN_FILE_NAME_MAX_LENGTH];
+    uint16_t _headIndex;                         // FAT index of the first extent
+    uint32_t _size;                              // Total size of the file
+    uint32_t _storedSize;                        // Bytes the file takes in EEPROM, less than _size if compressed
+    bool _packed;                                // The data is stored as compressed blocks
+    uint32_t _position;                          // Current read/write offset
+    FS_Extent _extents[MJOLN_FILE_MAX_EXTENTS];  // Resolved window of the link chain
+    uint8_t _extentCount;                        // Number of extents in the window
+    uint32_t _windowOffset;                      // File offset of the first extent in the window
+    uint16_t _windowNext;                        // FAT index following the window, or MJOLN_FILE_NOT_FOUND
+    uint32_t _blockStored;                       // Stored offset of the header of the current compressed block
+    uint32_t _blockOffset;                       // File offset of the first byte of the current compressed block
+    uint16_t _blockRaw;                          // Uncompressed length of the current block, 0 before the first
+    uint16_t _blockPacked;                       // Stored length of the current block; equal to _blockRaw if kept raw
+    uint16_t _decodeId;                          // Tells the file system's decoder which handle it is decoding for
+};
+
+#endif // __cplusplus
+#endif // MJOLNFILE_H
+       // This file defines the streaming file handle of the Mjoln EEPROM File System.
@@ -0,0 +1,131 @@
+#include "MjolnFS.h"
+
+bool MjolnFileSystem::createRecordFile(const char *filename, uint16_t recordSize, uint16_t recordCount)
+{
+    if (!isFileSystemInitialized())
+        return false;
+    abortCompaction();
+    discardFATChanges();
+
+    if (recordSize == 0 || recordCount == 0)
+    {
+        MJOLN_LOG_ERROR("A record file needs at least one record of at least one byte.\n");
+        return false;
+    }
+    if (checkFileExistence(filename) != MJOLN_FILE_NOT_FOUND)
+    {
+        MJOLN_LOG_ERROR("Couldn't create this file. File already exists!\n");
+        return false;
+    }
+
+    uint32_t length = (uint32_t)recordSize * recordCount;
+    FS_FATEntry fatEntry;
+    fatEntry.status = MJOLN_FILE_SYSTEM_FAT_AVAILABLE;
+    fatEntry.link = MJOLN_FILE_NOT_FOUND;
+    fatEntry.recordSize = recordSize;
+    fatEntry.flags = 0;
+    strncpy(fatEntry.filename, filename, MJOLN_FILE_NAME_MAX_LENGTH - 1);
+    fatEntry.filename[MJOLN_FILE_NAME_MAX_LENGTH - 1] = '\0';
+    fatEntry.size[0] = length & 0xFF;
+    fatEntry.size[1] = (length >> 8) & 0xFF;
+    fatEntry.size[2] = (length >> 16) & 0xFF;
+
+    uint16_t fatIndex = newLinkEntry();
+    if (fatIndex == MJOLN_FILE_NOT_FOUND)
+    {
+        MJOLN_LOG_ERROR("No free FAT entry for the file.\n");
+        return false;
+    }
+    // The records must be contiguous for their address to follow from the index alone.
+    uint32_t startAddr = _allocator.allocate(length);
+    if (startAddr == MJOLN_ALLOCATION_FAILED)
+    {
+        MJOLN_LOG_ERROR("Not enough space to write the file.\n");
+        discardFATChanges();
+        return false;
+    }
+    fatEntry.startAddr[0] = startAddr & 0xFF;
+    fatEntry.startAddr[1] = (startAddr >> 8) & 0xFF;
+    fatEntry.startAddr[2] = (startAddr >> 16) & 0xFF;
+
+    // Space from deleted files still holds their bytes, so the records are blanked before they become visible.
+    if (!storageErase(startAddr, length) || !writeFATEntry(fatIndex, fatEntry))
+    {
+        MJOLN_LOG_ERROR("Failed to create the record file.\n");
+        reloadMetadata();
+        return false;
+    }
+
+    _bootSector.bytesInUse += length;
+    claimFATEntry(fatIndex);
+    syncDataTop();
+    _liveFileCount++;
+    _fileIndex.insert(fatEntry.filename, fatIndex);
+    if (!writeSuperblock())
+    {
+        MJOLN_LOG_ERROR("Failed to write superblock.\n");
+        reloadMetadata();
+        return false;
+    }
+    return true;
+}
+
+uint32_t MjolnFileSystem::recordAddress(const char *filename, uint16_t index, uint16_t &recordSize)
+{
+    if (!isFileSystemInitialized() || checkFileExistence(filename) == MJOLN_FILE_NOT_FOUND)
+    {
+        MJOLN_LOG_ERROR("File not found!\n");
+        return MJOLN_ALLOCATION_FAILED;
+    }
+
+    recordSize = tempFatEntry.recordSize;
+    uint32_t length = tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16);
+    if (recordSize == 0 || tempFatEntry.link != MJOLN_FILE_NOT_FOUND)
+    {
+        MJOLN_LOG_ERROR("Not a record file.\n");
+        return MJOLN_ALLOCATION_FAILED;
+    }
+    if ((uint32_t)index >= length / recordSize)
+    {
+        MJOLN_LOG_ERROR("Record index out of range.\n");
+        return MJOLN_ALLOCATION_FAILED;
+    }
+
+    uint32_t startAddr = tempFatEntry.startAddr[0] | (tempFatEntry.startAddr[1] << 8) | (tempFatEntry.startAddr[2] << 16);
+    return startAddr + (uint32_t)index * recordSize;
+}
+
+bool MjolnFileSystem::readRecord(const char *filename, uint16_t index, void *record)
+{
+    uint16_t recordSize;
+    uint32_t addr = recordAddress(filename, index, recordSize);
+    return addr != MJOLN_ALLOCATION_FAILED && storageRead(addr, (uint8_t *)record, recordSize);
+}
+
+bool MjolnFileSystem::writeRecord(const char *filename, uint16_t index, const void *record)
+{
+    // A move in progress would copy the record as it was before this write.
+    abortCompaction();
+    discardFATChanges();
+
+    uint16_t recordSize;
+    uint32_t addr = recordAddress(filename, index, recordSize);
+    if (addr == MJOLN_ALLOCATION_FAILED)
+        return false;
+
+    if (!storageUpdate(addr, (const uint8_t *)record, recordSize) || !completeOperation())
+    {
+        MJOLN_LOG_ERROR("Failed to write the record.\n");
+        return false;
+    }
+    return true;
+}
+
+uint16_t MjolnFileSystem::getRecordCount(const char *filename)
+{
+    if (!isFileSystemInitialized() || checkFileExistence(filename) == MJOLN_FILE_NOT_FOUND || tempFatEntry.recordSize == 0)
+        return 0;
+
+    uint32_t length = tempFatEntry.size[0] | (tempFatEntry.size[1] << 8) | (tempFatEntry.size[2] << 16);
+    return length / tempFatEntry.recordSize;
+}
@@ -0,0 +1,330 @@
+#include "MjolnFS.h"
+
+bool MjolnFileSystem::storageRead(uint32_t addr, uint8_t *buffer, uint16_t length)
+{
+    if (!deviceRead(addr, buffer, length))
+        return false;
+
+    if (!_writeCache.isEnabled())
+        return true;
+
+    // Dirty cached bytes are newer than the EEPROM contents, so they are laid over what was read.
+    for (uint8_t i = 0; i < _writeCache.pageCount(); i++)
+    {
+        FS_CachedPage *page = _writeCache.page(i);
+        if (!FS_PageCache::isDirty(page))
+            continue;
+
+        uint32_t dirtyStart = page->pageAddr + page->dirtyStart;
+        uint32_t dirtyEnd = page->pageAddr + page->dirtyEnd;
+        uint32_t from = max(dirtyStart, addr);
+        uint32_t to = min(dirtyEnd, addr + length);
+        if (from < to)
+            memcpy(buffer + (from - addr), page->data + (from - page->pageAddr), to - from);
+    }
+    return true;
+}
+
+bool MjolnFileSystem::storageWrite(uint32_t addr, const uint8_t *data, uint16_t length)
+{
+    if (!_writeCache.isEnabled())
+        return deviceWrite(addr, data, length);
+
+    uint16_t pageSize = _writeCache.pageSize();
+    while (length > 0)
+    {
+        uint32_t pageAddr = addr - (addr % pageSize);
+        uint16_t offset = addr - pageAddr;
+        uint16_t chunk = min(length, (uint16_t)(pageSize - offset));
+
+        FS_CachedPage *page = _writeCache.lookup(pageAddr);
+        if (!page)
+        {
+            page = _writeCache.victim();
+            if (FS_PageCache::isDirty(page) && !flushCachedPage(page))
+                return false;
+            _writeCache.assign(page, pageAddr);
+        }
+
+        // A page is programmed from its first to its last dirty byte, so a write that would leave
+        // unknown bytes in between pulls the rest of the page in from the EEPROM first.
+        if (!page->filled && FS_PageCache::isDirty(page) && (offset > page->dirtyEnd || offset + chunk < page->dirtyStart))
+        {
+            if (!deviceRead(pageAddr, page->data, page->dirtyStart) ||
+                !deviceRead(pageAddr + page->dirtyEnd, page->data + page->dirtyEnd, pageSize - page->dirtyEnd))
+                return false;
+            page->filled = true;
+        }
+
+        memcpy(page->data + offset, data, chunk);
+        _writeCache.markDirty(page, offset, chunk);
+
+        data += chunk;
+        addr += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool MjolnFileSystem::storageUpdate(uint32_t addr, const uint8_t *data, uint16_t length)
+{
+    // Reading a page costs microseconds and programming it milliseconds and a write cycle, so each page
+    // is compared first and only the span from its first to its last changed byte is written.
+    uint16_t pageSize = getPageSize();
+    uint8_t current[MJOLN_COMPARE_CHUNK_BYTES];
+    while (length > 0)
+    {
+        uint16_t pageChunk = min(length, (uint16_t)(pageSize - (addr % pageSize)));
+        int32_t first = -1;
+        int32_t last = -1;
+        for (uint16_t offset = 0; offset < pageChunk; offset += sizeof(current))
+        {
+            uint16_t chunk = min((uint16_t)(pageChunk - offset), (uint16_t)sizeof(current));
+            if (!storageRead(addr + offset, current, chunk))
+                return false;
+            for (uint16_t i = 0; i < chunk; i++)
+            {
+                if (current[i] == data[offset + i])
+                    continue;
+                if (first < 0)
+                    first = offset + i;
+                last = offset + i;
+            }
+        }
+
+        if (first >= 0 && !storageWrite(addr + first, data + first, last - first + 1))
+            return false;
+
+        data += pageChunk;
+        addr += pageChunk;
+        length -= pageChunk;
+    }
+    return true;
+}
+
+bool MjolnFileSystem::storageErase(uint32_t addr, uint32_t length)
+{
+    if (!_writeCache.isEnabled())
+        return deviceErase(addr, length);
+
+    uint8_t blank[16];
+    memset(blank, 0xFF, sizeof(blank));
+    while (length > 0)
+    {
+        uint16_t chunk = min(length, (uint32_t)sizeof(blank));
+        if (!storageWrite(addr, blank, chunk))
+            return false;
+        addr += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool MjolnFileSystem::copyData(uint32_t from, uint32_t to, uint32_t length)
+{
+    uint8_t buffer[MJOLN_COMPACT_STEP_BYTES];
+    while (length > 0)
+    {
+        uint16_t chunk = min(length, (uint32_t)sizeof(buffer));
+        if (!storageRead(from, buffer, chunk) || !storageWrite(to, buffer, chunk))
+            return false;
+        from += chunk;
+        to += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+uint8_t MjolnFileSystem::chipAddress(uint8_t chip)
+{
+    // An 8-bit part takes one address per 256-byte block, so the next chip starts after its last block.
+    return _deviceAddress + chip * _addressesPerChip;
+}
+
+FS_Geometry MjolnFileSystem::geometry() const
+{
+    FS_Geometry geometry = {(uint8_t)_pageSize, _addressSize, _chipCount, _addressesPerChip};
+    return geometry;
+}
+
+bool MjolnFileSystem::waitForChip(uint8_t chip, uint32_t timeoutUs)
+{
+    if (!(_chipBusy & (1 << chip)))
+        return true;
+    if (!eepromWaitForWriteCycle(chipAddress(chip), timeoutUs))
+        return false;
+    _chipBusy &= ~(1 << chip);
+    return true;
+}
+
+bool MjolnFileSystem::waitForChips()
+{
+    for (uint8_t chip = 0; chip < _chipCount; chip++)
+        if (!waitForChip(chip))
+            return false;
+    return true;
+}
+
+bool MjolnFileSystem::deviceRead(uint32_t addr, uint8_t *buffer, uint16_t length)
+{
+    return readChips(geometry(), addr, buffer, length);
+}
+
+bool MjolnFileSystem::deviceWrite(uint32_t addr, const uint8_t *data, uint16_t length)
+{
+    return programChips(geometry(), addr, data, length);
+}
+
+bool MjolnFileSystem::deviceErase(uint32_t addr, uint32_t length)
+{
+    return programChips(geometry(), addr, (const uint8_t *)NULL, length);
+}
+
+bool MjolnFileSystem::queueWrite(uint32_t addr, const uint8_t *data, uint32_t length)
+{
+    uint16_t pageSize = getPageSize();
+    while (length > 0)
+    {
+        uint16_t chunk = min(length, (uint32_t)(pageSize - addr % pageSize));
+
+        // A full queue is the one place an asynchronous write waits: the oldest entry is sent to make room.
+        while (!_writeQueue.push(addr, data, chunk))
+            if (!sendQueuedWrite(true))
+                return false;
+
+        if (data)
+            data += chunk;
+        addr += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool MjolnFileSystem::sendQueuedWrite(bool wait)
+{
+    return sendQueuedToChips(geometry(), wait);
+}
+
+void MjolnFileSystem::reportCompletions()
+{
+    // A write is on the EEPROM once its chip has been seen idle again or has accepted a later write.
+    uint32_t durable = _sentSequence;
+    for (uint8_t chip = 0; chip < _chipCount; chip++)
+        if ((_chipBusy & (1 << chip)) && (int32_t)(_chipSequence[chip] - 1 - durable) < 0)
+            durable = _chipSequence[chip] - 1;
+
+    uint32_t ticket;
+    bool success;
+    while (_writeQueue.takeCompletedTicket(durable, ticket, success))
+        if (_onWriteComplete)
+            _onWriteComplete(ticket, success);
+}
+
+bool MjolnFileSystem::completeOperation()
+{
+    if (!_writeQueue.isEnabled())
+        return waitForChips();
+    _writeQueue.addTicket();
+    return true;
+}
+
+bool MjolnFileSystem::enableAsyncWrites(uint8_t pages)
+{
+    if (!flush())
+        return false;
+    return _writeQueue.begin(pages, getPageSize());
+}
+
+void MjolnFileSystem::disableAsyncWrites()
+{
+    flush();
+    _writeQueue.end();
+}
+
+bool MjolnFileSystem::poll()
+{
+    if (!_writeQueue.isEnabled())
+        return false;
+
+    if (!_writeQueue.isEmpty())
+        sendQueuedWrite(false);
+    else
+    {
+        // Nothing left to send; a busy chip is probed so the writes it holds can be reported.
+        for (uint8_t chip = 0; chip < _chipCount; chip++)
+        {
+            if (_chipBusy & (1 << chip))
+            {
+                waitForChip(chip, 0);
+                break;
+            }
+        }
+    }
+    reportCompletions();
+    return !_writeQueue.isEmpty() || _chipBusy || _writeQueue.hasTickets();
+}
+
+void MjolnFileSystem::onWriteComplete(FS_CompletionCallback callback)
+{
+    _onWriteComplete = callback;
+}
+
+uint32_t MjolnFileSystem::lastTicket()
+{
+    return _writeQueue.lastTicket();
+}
+
+bool MjolnFileSystem::flushCachedPage(FS_CachedPage *page)
+{
+    uint16_t length = page->dirtyEnd - page->dirtyStart;
+    if (!deviceWrite(page->pageAddr + page->dirtyStart, page->data + page->dirtyStart, length))
+        return false;
+    _writeCache.markClean(page);
+    return true;
+}
+
+bool MjolnFileSystem::enableWriteCache(uint8_t pages)
+{
+    if (!flush())
+        return false;
+    return _writeCache.begin(pages, getPageSize());
+}
+
+void MjolnFileSystem::disableWriteCache()
+{
+    flush();
+    _writeCache.end();
+}
+
+bool MjolnFileSystem::flushWriteCache()
+{
+    FS_CachedPage *page;
+    while (_writeCache.isEnabled() && (page = _writeCache.nextDirty()) != NULL)
+    {
+        if (!flushCachedPage(page))
+        {
+            MJOLN_LOG_ERROR("Failed to flush the write cache.\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MjolnFileSystem::flush()
+{
+    if (!flushWriteCache())
+        return false;
+
+    while (!_writeQueue.isEmpty())
+    {
+        if (!sendQueuedWrite(true))
+        {
+            MJOLN_LOG_ERROR("Failed to drain the write queue.\n");
+            return false;
+        }
+    }
+    if (!waitForChips())
+        return false;
+    reportCompletions();
+    return true;
+}
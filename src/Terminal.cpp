@@ -4,17 +4,20 @@ void MjolnFileSystem::processCommand(String command)
 {
     if (command.startsWith("mk "))
     {
+        bool compress = command.startsWith("mk -z ");
+        if (compress)
+            command = "mk " + command.substring(6);
         String filename, data;
         extractArgs(command, filename, data);
         if (!filename.isEmpty() && !data.isEmpty())
         {
-            if (writeFile(filename.c_str(), data.c_str()))
+            if (writeFile(filename.c_str(), data.c_str(), compress))
                 Serial.println("File created.");
             else
                 Serial.println("ERR: File already exists!");
         }
         else
-            Serial.println("Usage: mk <filename> <data>");
+            Serial.println("Usage: mk [-z] <filename> <data>");
     }
     else if (command.startsWith("update "))
     {
@@ -30,17 +33,39 @@ void MjolnFileSystem::processCommand(String command)
         else
             Serial.println("Usage: mk <filename> <data>");
     }
+    else if (command.startsWith("append "))
+    {
+        String filename, data;
+        extractArgs(command, filename, data);
+        if (!filename.isEmpty() && !data.isEmpty())
+        {
+            if (appendFile(filename.c_str(), data.c_str()))
+                Serial.println("File appended.");
+            else
+                Serial.println("ERR: Append failed!");
+        }
+        else
+            Serial.println("Usage: append <filename> <data>");
+    }
     else if (command.startsWith("rm "))
     {
         String filename = command.substring(3);
         filename.trim();
+        bool secure = filename.startsWith("-s ");
+        if (secure)
+        {
+            filename = filename.substring(3);
+            filename.trim();
+        }
         if (!filename.isEmpty())
         {
-            deleteFile(filename.c_str());
-            Serial.println("File deleted.");
+            if (deleteFile(filename.c_str(), secure))
+                Serial.println(secure ? "File deleted and erased." : "File deleted.");
+            else
+                Serial.println("ERR: File not found!");
         }
         else
-            Serial.println("Usage: rm <filename>");
+            Serial.println("Usage: rm [-s] <filename>");
     }
     else if (command.equals("ls"))
         listFiles();
@@ -51,22 +76,18 @@ void MjolnFileSystem::processCommand(String command)
 
         if (!filename.isEmpty())
         {
-            char *buffer = new char[256];
-            if (buffer)
+            MjolnFile file = open(filename.c_str());
+            if (file)
             {
-                if (readFile(filename.c_str(), buffer))
-                {
-                    Serial.println(buffer);
-                }
-                else
-                    Serial.println("ERR: File not found.");
-
-                delete[] buffer;
+                uint8_t buffer[32];
+                uint16_t length;
+                while ((length = file.read(buffer, sizeof(buffer))) > 0)
+                    Serial.write(buffer, length);
+                Serial.println();
+                file.close();
             }
             else
-            {
-                Serial.println("ERR: Memory allocation failed.");
-            }
+                Serial.println("ERR: File not found.");
         }
         else
             Serial.println("Usage: read <filename>");
@@ -75,8 +96,27 @@ void MjolnFileSystem::processCommand(String command)
         printFileSystemInfo();
     else if (command.equals("delpart"))
     {
-        format();
-        Serial.println("Partition deleted.");
+        if (cleanFormat() && format())
+            Serial.println("Partition deleted.");
+        else
+            Serial.println("Failed to delete partition.");
+    }
+    else if (command.equals("compact"))
+    {
+        while (compact(1000))
+            Serial.print(".");
+        Serial.println("Compacted.");
+    }
+    else if (command.equals("fsck"))
+    {
+        while (fsck(1000))
+            Serial.print(".");
+        FS_FsckReport report = getFsckReport();
+        Serial.println(report.complete ? "Check complete." : "Check stopped.");
+        Serial.println("Entries checked: " + String(report.entriesChecked));
+        Serial.println("Repaired: " + String(report.repaired) + ", dropped: " + String(report.dropped));
+        Serial.println("Broken chains: " + String(report.brokenChains) + ", orphaned links: " + String(report.orphanLinks));
+        Serial.println("Overlaps: " + String(report.overlaps) + (report.countersFixed ? ", bytes in use corrected" : ""));
     }
     else if (command.equals("storeuse"))
     {
@@ -89,6 +129,18 @@ void MjolnFileSystem::processCommand(String command)
         Serial.print("Bytes Used: ");
         Serial.println(getBytesUsed());
     }
+    else if (command.equals("stats") || command.equals("stats -r"))
+    {
+        FS_Stats stats = getStats();
+        Serial.println("I2C transactions: " + String(stats.i2cTransactions));
+        Serial.println("Bytes read: " + String(stats.bytesRead) + ", written: " + String(stats.bytesWritten));
+        Serial.println("Page programs: " + String(stats.pagePrograms));
+        Serial.println("Write cycle wait: " + String(stats.writeWaitMicros) + " us");
+        Serial.println("FAT reads: " + String(stats.fatReads));
+        Serial.println("Lookups: " + String(stats.lookupHits) + " hits, " + String(stats.lookupMisses) + " misses");
+        if (command.equals("stats -r"))
+            resetStats();
+    }
     else
         Serial.println("Unknown command.");
 }